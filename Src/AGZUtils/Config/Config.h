@@ -3,11 +3,13 @@
 #include <map>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "../Alloc/ObjArena.h"
 #include "../Misc/Exception.h"
 #include "../String/StdStr.h"
+#include "../String/String/Intern.h"
 
 namespace AGZ {
 
@@ -103,9 +105,12 @@ public:
 class ConfigGroup : public ConfigNode
 {
     std::map<std::string, ConfigNode*> children_;
+    std::unordered_map<InternedStr8, ConfigNode*> internedChildren_; // 以驻留后的名字为键的children_
 
     const ConfigNode *FindSection(std::string_view k) const;
 
+    void BuildInternedIndex();
+
 public:
 
     explicit ConfigGroup(std::map<std::string, ConfigNode*> &&children);
@@ -129,6 +134,14 @@ public:
      */
     const ConfigNode *Find(std::string_view k) const;
 
+    /**
+     * 查找名字为name的直接子节点，不存在时返回nullptr
+     *
+     * 与 Find 不同，name中的“.”不被视为路径分隔符。子节点名在构造和 Expand 时就已被驻留，
+     * 因此查找只需比较句柄，适合反复以同一组名字查找的场合
+     */
+    const ConfigNode *FindChild(const InternedStr8 &name) const;
+
     /**
      * 查找具有指定路径的array，路径不存在或类型不正确时返回nullptr
      */
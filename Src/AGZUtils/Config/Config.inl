@@ -11,7 +11,15 @@ namespace AGZ {
 inline ConfigGroup::ConfigGroup(std::map<std::string, ConfigNode*> &&children)
     : children_(std::move(children))
 {
+    BuildInternedIndex();
+}
 
+inline void ConfigGroup::BuildInternedIndex()
+{
+    internedChildren_.clear();
+    internedChildren_.reserve(children_.size());
+    for(auto &it : children_)
+        internedChildren_[InternedStr8(it.first.data(), it.first.size())] = it.second;
 }
 
 inline void ConfigGroup::Expand(const std::map<std::string, ConfigNode*> &more)
@@ -24,6 +32,7 @@ inline void ConfigGroup::Expand(const std::map<std::string, ConfigNode*> &more)
         else
             dynamic_cast<ConfigGroup*>(it->second)->Expand(moreIt.second->AsGroup().GetChildren());
     }
+    BuildInternedIndex();
 }
 
 inline const ConfigNode *ConfigGroup::FindSection(std::string_view k) const
@@ -32,22 +41,28 @@ inline const ConfigNode *ConfigGroup::FindSection(std::string_view k) const
     return it != children_.end() ? it->second : nullptr;
 }
 
+inline const ConfigNode *ConfigGroup::FindChild(const InternedStr8 &name) const
+{
+    auto it = internedChildren_.find(name);
+    return it != internedChildren_.end() ? it->second : nullptr;
+}
+
 inline const ConfigNode *ConfigGroup::Find(std::string_view k) const
 {
-    std::vector<std::string_view> sections;
-    Split(k, ".", std::back_inserter(sections), false);
-    //auto sections = k.Split(".");
+    // 逐段向下查找，不必先把整个路径拆分到容器中
     const ConfigGroup *grp = this;
+    const ConfigNode *node = nullptr;
 
-    for(size_t i = 0, end = sections.size() - 1; i < end; ++i)
+    for(std::string_view section : LazySplit(k, ".", false))
     {
-        auto node = grp->FindSection(sections[i]);
+        if(node)
+            grp = &node->AsGroup();
+        node = grp->FindSection(section);
         if(!node)
             return nullptr;
-        grp = &node->AsGroup();
     }
 
-    return grp->FindSection(sections.back());
+    return node;
 }
 
 inline const ConfigArray *ConfigGroup::FindArray(std::string_view k) const
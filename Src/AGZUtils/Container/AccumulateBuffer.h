@@ -2,6 +2,8 @@
 
 #include <iterator>
 
+#include "../Misc/Common.h"
+
 namespace AGZ
 {
     
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+#include "../Misc/Common.h"
+
+namespace AGZ
+{
+
+namespace ContainerImpl
+{
+    inline size_t RoundUpToPowerOf2(size_t v) noexcept
+    {
+        size_t ret = 1;
+        while(ret < v)
+            ret <<= 1;
+        return ret;
+    }
+
+    /**
+     * @brief 自旋等待时使用的退避策略：先忙等若干次，之后让出时间片
+     */
+    class SpinBackoff
+    {
+        int count_ = 0;
+
+    public:
+
+        void Pause() noexcept
+        {
+            if(++count_ > 64)
+                std::this_thread::yield();
+        }
+    };
+
+} // namespace ContainerImpl
+
+/**
+ * @brief 有界无锁多生产者多消费者队列
+ *
+ * 基于环形缓冲区，每个槽位带有一个序号，生产者和消费者分别通过CAS推进写入和读取位置（Dmitry Vyukov的算法）。
+ * 读写位置各自独占一个缓存行，以避免生产者与消费者之间的伪共享。
+ *
+ * Try系列操作在队列满/空时立即返回false，Push/Pop则自旋等待直到成功。
+ *
+ * 压入时构造元素抛出的异常会传递给调用者，此时已领取的槽位被标记为无效，消费者会跳过它。
+ * 弹出时元素的移动赋值和析构不能抛出异常。
+ */
+template<typename T>
+class MPMCQueue : public Uncopiable
+{
+    static_assert(std::is_nothrow_move_assignable_v<T> && std::is_nothrow_destructible_v<T>,
+                  "Element type of MPMCQueue must be nothrow move assignable and destructible");
+
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        bool dead = false; // 构造元素时抛出了异常，槽位中没有元素。在seq的release/acquire保护下读写
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T *Value() noexcept { return std::launder(reinterpret_cast<T*>(&storage)); }
+    };
+
+    size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) std::atomic<size_t> dequeuePos_;
+
+    // 为写入pos处的元素领取槽位，队列满时返回nullptr
+    Cell *ClaimPush(size_t &pos) noexcept
+    {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Cell *cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if(!diff)
+            {
+                if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return cell;
+            }
+            else if(diff < 0)
+                return nullptr;
+            else
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // 为读取pos处的元素领取槽位，队列空时返回nullptr
+    Cell *ClaimPop(size_t &pos) noexcept
+    {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Cell *cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if(!diff)
+            {
+                if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return cell;
+            }
+            else if(diff < 0)
+                return nullptr;
+            else
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+public:
+
+    using ValueType = T;
+
+    /**
+     * @param capacity 队列容量，会被向上取整为2的整数次幂
+     */
+    explicit MPMCQueue(size_t capacity)
+    {
+        capacity = ContainerImpl::RoundUpToPowerOf2((std::max)(capacity, size_t(2)));
+        mask_ = capacity - 1;
+        cells_ = std::make_unique<Cell[]>(capacity);
+        for(size_t i = 0; i < capacity; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
+    }
+
+    ~MPMCQueue()
+    {
+        if constexpr(!std::is_trivially_destructible_v<T>)
+        {
+            size_t pos;
+            while(Cell *cell = ClaimPop(pos))
+            {
+                if(!cell->dead)
+                    cell->Value()->~T();
+                cell->dead = false;
+                cell->seq.store(pos + mask_ + 1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief 队列容量
+     */
+    size_t GetCapacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+
+    /**
+     * @brief 尝试压入一个元素，队列已满时返回false
+     *
+     * 构造元素抛出异常时，已领取的槽位会被标记为无效后发布，以免其他线程在该槽位上永远等待
+     */
+    template<typename...Args>
+    bool TryEmplace(Args&&...args)
+    {
+        size_t pos;
+        Cell *cell = ClaimPush(pos);
+        if(!cell)
+            return false;
+        if constexpr(std::is_nothrow_constructible_v<T, Args&&...>)
+            new(&cell->storage) T(std::forward<Args>(args)...);
+        else
+        {
+            try
+            {
+                new(&cell->storage) T(std::forward<Args>(args)...);
+            }
+            catch(...)
+            {
+                cell->dead = true;
+                cell->seq.store(pos + 1, std::memory_order_release);
+                throw;
+            }
+        }
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPush(const T &value) { return TryEmplace(value); }
+    bool TryPush(T &&value)      { return TryEmplace(std::move(value)); }
+
+    /**
+     * @brief 尝试弹出一个元素，队列为空时返回false
+     */
+    bool TryPop(T &value)
+    {
+        size_t pos;
+        Cell *cell = ClaimPop(pos);
+        if(!cell)
+            return false;
+        while(cell->dead)
+        {
+            cell->dead = false;
+            cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+            if(!(cell = ClaimPop(pos)))
+                return false;
+        }
+        T *v = cell->Value();
+        value = std::move(*v);
+        v->~T();
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 压入一个元素，队列已满时自旋等待
+     */
+    template<typename U>
+    void Push(U &&value)
+    {
+        ContainerImpl::SpinBackoff backoff;
+        while(!TryEmplace(std::forward<U>(value)))
+            backoff.Pause();
+    }
+
+    /**
+     * @brief 弹出一个元素，队列为空时自旋等待
+     *
+     * 要求T可默认构造
+     */
+    T Pop()
+    {
+        T ret;
+        ContainerImpl::SpinBackoff backoff;
+        while(!TryPop(ret))
+            backoff.Pause();
+        return ret;
+    }
+
+    /**
+     * @brief 尝试依次压入[first, first + count)中的元素，直到队列满为止
+     *
+     * @return 成功压入的元素数量
+     */
+    template<typename InputIt>
+    size_t TryPushN(InputIt first, size_t count)
+    {
+        size_t ret = 0;
+        for(; ret < count && TryEmplace(*first); ++ret)
+            ++first;
+        return ret;
+    }
+
+    /**
+     * @brief 尝试弹出至多maxCount个元素并依次写入out，直到队列空为止。要求T可默认构造
+     *
+     * @return 成功弹出的元素数量
+     */
+    template<typename OutputIt>
+    size_t TryPopN(OutputIt out, size_t maxCount)
+    {
+        size_t ret = 0;
+        T value;
+        for(; ret < maxCount && TryPop(value); ++ret)
+            *out++ = std::move(value);
+        return ret;
+    }
+
+    /**
+     * @brief 队列中的元素数量。并发访问时结果仅供参考
+     */
+    size_t ApproxSize() const noexcept
+    {
+        size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+        size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+};
+
+} // namespace AGZ
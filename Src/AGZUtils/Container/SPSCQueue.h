@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "MPMCQueue.h"
+
+namespace AGZ
+{
+
+/**
+ * @brief 有界无锁单生产者单消费者环形队列
+ *
+ * 只允许一个线程压入、一个线程弹出。读写位置各自独占一个缓存行，且双方各自缓存对方的位置，
+ * 只在缓存值表明队列满/空时才重新读取，以减少缓存行在两个线程间的往返。
+ *
+ * 批量操作只发布一次位置，适合流水线的各个阶段之间传递数据。
+ *
+ * 压入时构造元素抛出的异常会传递给调用者，此前已构造的元素仍被发布。弹出时元素的移动赋值和析构不能抛出异常。
+ */
+template<typename T>
+class SPSCQueue : public Uncopiable
+{
+    static_assert(std::is_nothrow_move_assignable_v<T> && std::is_nothrow_destructible_v<T>,
+                  "Element type of SPSCQueue must be nothrow move assignable and destructible");
+
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    size_t mask_;
+    std::unique_ptr<Storage[]> buf_;
+
+    alignas(64) std::atomic<size_t> head_; // 下一个被弹出的位置，由消费者写入
+    size_t cachedTail_;
+
+    alignas(64) std::atomic<size_t> tail_; // 下一个被压入的位置，由生产者写入
+    size_t cachedHead_;
+
+    T *At(size_t pos) noexcept
+    {
+        return std::launder(reinterpret_cast<T*>(&buf_[pos & mask_]));
+    }
+
+    // 生产者：取得至多want个可写入的槽位数
+    size_t WritableCount(size_t tail, size_t want) noexcept
+    {
+        size_t cap = mask_ + 1;
+        if(tail - cachedHead_ + want > cap)
+            cachedHead_ = head_.load(std::memory_order_acquire);
+        return (std::min)(want, cap - (tail - cachedHead_));
+    }
+
+    // 消费者：取得至多want个可读取的元素数
+    size_t ReadableCount(size_t head, size_t want) noexcept
+    {
+        if(cachedTail_ - head < want)
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+        return (std::min)(want, cachedTail_ - head);
+    }
+
+public:
+
+    using ValueType = T;
+
+    /**
+     * @param capacity 队列容量，会被向上取整为2的整数次幂
+     */
+    explicit SPSCQueue(size_t capacity)
+    {
+        capacity = ContainerImpl::RoundUpToPowerOf2((std::max)(capacity, size_t(2)));
+        mask_ = capacity - 1;
+        buf_ = std::make_unique<Storage[]>(capacity);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cachedHead_ = cachedTail_ = 0;
+    }
+
+    ~SPSCQueue()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for(; head != tail; ++head)
+            At(head)->~T();
+    }
+
+    size_t GetCapacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+
+    /**
+     * @brief 尝试压入一个元素，队列已满时返回false。只能由生产者线程调用
+     */
+    template<typename...Args>
+    bool TryEmplace(Args&&...args)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(!WritableCount(tail, 1))
+            return false;
+        new(At(tail)) T(std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPush(const T &value) { return TryEmplace(value); }
+    bool TryPush(T &&value)      { return TryEmplace(std::move(value)); }
+
+    /**
+     * @brief 尝试弹出一个元素，队列为空时返回false。只能由消费者线程调用
+     */
+    bool TryPop(T &value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(!ReadableCount(head, 1))
+            return false;
+        T *v = At(head);
+        value = std::move(*v);
+        v->~T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 压入一个元素，队列已满时自旋等待
+     */
+    template<typename U>
+    void Push(U &&value)
+    {
+        ContainerImpl::SpinBackoff backoff;
+        while(!TryEmplace(std::forward<U>(value)))
+            backoff.Pause();
+    }
+
+    /**
+     * @brief 弹出一个元素，队列为空时自旋等待
+     *
+     * 要求T可默认构造
+     */
+    T Pop()
+    {
+        T ret;
+        ContainerImpl::SpinBackoff backoff;
+        while(!TryPop(ret))
+            backoff.Pause();
+        return ret;
+    }
+
+    /**
+     * @brief 尝试压入[first, first + count)中尽可能多的元素
+     *
+     * @return 成功压入的元素数量
+     */
+    template<typename InputIt>
+    size_t TryPushN(InputIt first, size_t count)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t n = WritableCount(tail, count), i = 0;
+        try
+        {
+            for(; i < n; ++i, ++first)
+                new(At(tail + i)) T(*first);
+        }
+        catch(...)
+        {
+            tail_.store(tail + i, std::memory_order_release);
+            throw;
+        }
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief 尝试弹出至多maxCount个元素并依次写入out
+     *
+     * @return 成功弹出的元素数量
+     */
+    template<typename OutputIt>
+    size_t TryPopN(OutputIt out, size_t maxCount)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t n = ReadableCount(head, maxCount), i = 0;
+        try
+        {
+            for(; i < n; ++i)
+            {
+                T *v = At(head + i);
+                *out++ = std::move(*v);
+                v->~T();
+            }
+        }
+        catch(...)
+        {
+            // 写入out失败的元素仍留在队列中
+            head_.store(head + i, std::memory_order_release);
+            throw;
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief 队列中的元素数量。并发访问时结果仅供参考
+     */
+    size_t ApproxSize() const noexcept
+    {
+        return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+    }
+};
+
+} // namespace AGZ
@@ -160,21 +160,34 @@ bool WavefrontObj<T>::LoadFromMemory(std::string_view content, bool ignoreUnknow
 
     try
     {
-        // 按\n拆分并剔除空行、注释行
-
-        std::vector<std::string> lines;
+        // 以空白字符拆分一行，将前MAX_TOKEN_COUNT个子串存入ps，返回子串总数
+        constexpr size_t MAX_TOKEN_COUNT = 5;
+        std::string_view ps[MAX_TOKEN_COUNT];
+        auto splitLine = [&ps](std::string_view line)
         {
-            std::vector<std::string> prelines;
-            Split(content, "\n", std::back_inserter(prelines), true);
-            for(auto &line : prelines)
+            size_t n = 0;
+            for(auto tok : LazySplit(line))
             {
-                if(!line.empty() && !StartsWith(line, "#"))
-                    lines.push_back(Trim(line));
+                if(n < MAX_TOKEN_COUNT)
+                    ps[n] = tok;
+                ++n;
             }
-        }
-        
-        for(const auto &line : lines)
+            return n;
+        };
+
+        // 按\n逐行处理，跳过空行、注释行
+
+        for(std::string_view line : LazySplit(content, "\n"))
         {
+            if(StartsWith(line, "#"))
+                continue;
+
+            // 去掉首尾的空白字符，与Trim(line)相同但不复制
+            while(!line.empty() && IsWhitespace(line.front()))
+                line.remove_prefix(1);
+            while(!line.empty() && IsWhitespace(line.back()))
+                line.remove_suffix(1);
+
             if(StartsWith(line, "o "))
             {
                 std::string name = Trim(line.substr(2));
@@ -200,9 +213,7 @@ bool WavefrontObj<T>::LoadFromMemory(std::string_view content, bool ignoreUnknow
             //}
             if(StartsWith(line, "v "))
             {
-                std::vector<std::string_view> ps;
-                Split(line, std::back_inserter(ps));
-                if(ps.size() != 4)
+                if(splitLine(line) != 4)
                     throw std::runtime_error("");
                 vtxPos.push_back(Math::Vec3<T>(Parse<T>(ps[1]), Parse<T>(ps[2]), Parse<T>(ps[3])));
                 continue;
@@ -223,11 +234,10 @@ bool WavefrontObj<T>::LoadFromMemory(std::string_view content, bool ignoreUnknow
             //}
             if(StartsWith(line, "vt "))
             {
-                std::vector<std::string_view> ps;
-                Split(line, std::back_inserter(ps));
-                if(ps.size() == 3)
+                size_t n = splitLine(line);
+                if(n == 3)
                     vtxTex.push_back(Math::Vec3<T>(Parse<T>(ps[1]), Parse<T>(ps[2]), 0));
-                else if(ps.size() == 4)
+                else if(n == 4)
                     vtxTex.push_back(Math::Vec3<T>(Parse<T>(ps[1]), Parse<T>(ps[2]), Parse<T>(ps[3])));
                 else
                     throw std::runtime_error("");
@@ -242,9 +252,7 @@ bool WavefrontObj<T>::LoadFromMemory(std::string_view content, bool ignoreUnknow
             //}
             if(StartsWith(line, "vn "))
             {
-                std::vector<std::string_view> ps;
-                Split(line, std::back_inserter(ps));
-                if(ps.size() != 4)
+                if(splitLine(line) != 4)
                     throw std::runtime_error("");
                 vtxNor.push_back(Math::Vec3<T>(Parse<T>(ps[1]), Parse<T>(ps[2]), Parse<T>(ps[3])));
                 continue;
@@ -252,18 +260,15 @@ bool WavefrontObj<T>::LoadFromMemory(std::string_view content, bool ignoreUnknow
 
             if(StartsWith(line, "f "))
             {
-                std::vector<std::string> indices;
-                Split(line.substr(2), std::back_inserter(indices));
-                for(auto &idx : indices)
-                    idx = Trim(idx);
-
-                if(indices.size() < 3 || indices.size() > 4)
+                // ps[0]为"f"，其后是各顶点的下标
+                size_t indexCount = splitLine(line) - 1;
+                if(indexCount < 3 || indexCount > 4)
                     throw std::runtime_error("");
 
                 typename Object::Group::Face face;
-                for(size_t i = 0; i < indices.size(); ++i)
+                for(size_t i = 0; i < indexCount; ++i)
                 {
-                    auto v = ParseVertexIndex(indices[i]);
+                    auto v = ParseVertexIndex(ps[i + 1]);
                     if(v.pos < 0) v.pos = Index(vtxPos.size()) + v.pos;
                     else if(v.pos != INDEX_NONE) --v.pos;
                     if(v.tex < 0) v.tex = Index(vtxTex.size()) + v.tex;
@@ -273,10 +278,10 @@ bool WavefrontObj<T>::LoadFromMemory(std::string_view content, bool ignoreUnknow
                     face.v[i] = v;
                 }
 
-                if(indices.size() == 3)
+                if(indexCount == 3)
                     face.v[3].pos = face.v[3].tex = face.v[3].nor = INDEX_NONE;
 
-                face.isTriangle = indices.size() != 4;
+                face.isTriangle = indexCount != 4;
 
                 grp().faces.push_back(face);
                 continue;
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "Common.h"
+
+#if defined(AGZ_CC_MSVC) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace AGZ {
+
+namespace HashImpl
+{
+    // 64位乘法的128位结果，低位写入a，高位写入b
+    inline void Mum(uint64_t *a, uint64_t *b) noexcept
+    {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = *a;
+        r *= *b;
+        *a = static_cast<uint64_t>(r);
+        *b = static_cast<uint64_t>(r >> 64);
+#elif defined(AGZ_CC_MSVC) && defined(_M_X64)
+        *a = _umul128(*a, *b, b);
+#else
+        uint64_t ha = *a >> 32, hb = *b >> 32;
+        uint64_t la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32), c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        *a = lo;
+        *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+    }
+
+    inline uint64_t Mix(uint64_t a, uint64_t b) noexcept
+    {
+        Mum(&a, &b);
+        return a ^ b;
+    }
+
+    inline uint64_t Read8(const uint8_t *p) noexcept
+    {
+        uint64_t ret;
+        std::memcpy(&ret, p, 8);
+        return ret;
+    }
+
+    inline uint64_t Read4(const uint8_t *p) noexcept
+    {
+        uint32_t ret;
+        std::memcpy(&ret, p, 4);
+        return ret;
+    }
+
+    // 1 <= len <= 3
+    inline uint64_t Read3(const uint8_t *p, size_t len) noexcept
+    {
+        return (uint64_t(p[0]) << 16) | (uint64_t(p[len >> 1]) << 8) | p[len - 1];
+    }
+
+    constexpr uint64_t SECRET[4] =
+    {
+        0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+        0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+    };
+
+} // namespace HashImpl
+
+/**
+ * @brief 计算一段字节序列的64位哈希值
+ *
+ * 采用wyhash（Wang Yi，公有领域）的算法，每次处理8/16/48字节，长串的速度接近内存带宽，且分布质量足以用作散列表的键。
+ * 结果与平台字节序有关，不应被持久化。
+ */
+inline uint64_t HashBytes(const void *data, size_t len, uint64_t seed = 0) noexcept
+{
+    using namespace HashImpl;
+
+    auto p = static_cast<const uint8_t*>(data);
+    seed ^= Mix(seed ^ SECRET[0], SECRET[1]);
+
+    uint64_t a, b;
+    if(len <= 16)
+    {
+        if(len >= 4)
+        {
+            a = (Read4(p) << 32) | Read4(p + ((len >> 3) << 2));
+            b = (Read4(p + len - 4) << 32) | Read4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if(len > 0)
+        {
+            a = Read3(p, len);
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else
+    {
+        size_t i = len;
+        if(i > 48)
+        {
+            uint64_t see1 = seed, see2 = seed;
+            do
+            {
+                seed = Mix(Read8(p)      ^ SECRET[1], Read8(p + 8)  ^ seed);
+                see1 = Mix(Read8(p + 16) ^ SECRET[2], Read8(p + 24) ^ see1);
+                see2 = Mix(Read8(p + 32) ^ SECRET[3], Read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16)
+        {
+            seed = Mix(Read8(p) ^ SECRET[1], Read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = Read8(p + i - 16);
+        b = Read8(p + i - 8);
+    }
+
+    a ^= SECRET[1];
+    b ^= seed;
+    Mum(&a, &b);
+    return Mix(a ^ SECRET[0] ^ len, b ^ SECRET[1]);
+}
+
+} // namespace AGZ
@@ -21,12 +21,14 @@ namespace RangeAux
 
         using Iterator = GetIteratorType<R>;
 
+        // end_在初始化列表中求得，使迭代器不必可以缺省构造（如 Filter、Map 的迭代器）
         TakeImpl(R range, size_t n)
-            : range_(std::move(range))
+            : range_(std::move(range)),
+              end_(AdvanceTo(std::begin(range_), std::end(range_),
+                    static_cast<typename std::iterator_traits<Iterator>
+                                                    ::difference_type>(n)))
         {
-            end_ = AdvanceTo(std::begin(range_), std::end(range_),
-                static_cast<typename std::iterator_traits<Iterator>
-                                                ::difference_type>(n));
+
         }
 
         Iterator begin() const
@@ -1,11 +1,30 @@
 #pragma once
 
 #include "../../Misc/Common.h"
+#include "SIMD.h"
 
 namespace AGZ {
 
+template<typename T> class ASCIICore;
+template<typename T> class UTF8Core;
+template<typename T> class UTF16Core;
+template<typename T> class UTF32Core;
+
 namespace CharsetAux
 {
+    /**
+     * @brief 值小于0x80的码元是否总是单独构成与之等值的码点
+     *
+     * 对这样的编码方案，编码转换等操作可以用向量指令批量处理连续的ASCII字符
+     */
+    template<typename Core>
+    struct IsASCIICompatible : std::false_type { };
+
+    template<typename T> struct IsASCIICompatible<ASCIICore<T>> : std::true_type { };
+    template<typename T> struct IsASCIICompatible<UTF8Core<T>>  : std::true_type { };
+    template<typename T> struct IsASCIICompatible<UTF16Core<T>> : std::true_type { };
+    template<typename T> struct IsASCIICompatible<UTF32Core<T>> : std::true_type { };
+
     template<typename It>
     struct CodeUnitsBeginFromCodePointIteratorImpl
     {
@@ -52,6 +71,8 @@ public:
     using CodePoint = typename Core::CodePoint;
     using CodeUnit  = typename Core::CodeUnit;
 
+    static constexpr bool ASCIICompatible = CharsetAux::IsASCIICompatible<Core>::value;
+
     static size_t Length(const CodeUnit *cu)
     {
         size_t ret = 0;
@@ -60,15 +81,42 @@ public:
         return ret;
     }
 
+    /**
+     * @brief 和CU2CP相同，但不会访问end及其之后的码元，码元序列被截断时返回0
+     */
+    static size_t CheckedCU2CP(const CodeUnit *cu, const CodeUnit *end, CodePoint *cp)
+    {
+        size_t n = static_cast<size_t>(end - cu);
+        if(n >= Core::MaxCUInCP)
+            return Core::CU2CP(cu, cp);
+
+        // 剩余码元不足一个完整码点时，补0后再解码。0不会被当作多码元序列的后续码元
+        CodeUnit buf[Core::MaxCUInCP] = { };
+        for(size_t i = 0; i < n; ++i)
+            buf[i] = cu[i];
+        size_t ret = Core::CU2CP(buf, cp);
+        return ret <= n ? ret : 0;
+    }
+
     static bool Check(const CodeUnit *beg, size_t n)
     {
+        const CodeUnit *end = beg + n;
         CodePoint cp;
-        while(n)
+        while(beg < end)
         {
-            size_t s = Core::CU2CP(beg, &cp, n);
+            if constexpr(ASCIICompatible)
+            {
+                if(static_cast<CharsetAux::UnsignedCU<CodeUnit>>(*beg) < 0x80)
+                {
+                    beg += CharsetAux::ASCIIPrefixLength(beg, static_cast<size_t>(end - beg));
+                    if(beg == end)
+                        break;
+                }
+            }
+
+            size_t s = CheckedCU2CP(beg, end, &cp);
             if(!s)
                 return false;
-            n -= s;
             beg += s;
         }
         return true;
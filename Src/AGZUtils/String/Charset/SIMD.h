@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "../../Misc/Common.h"
+
+#if defined(AGZ_USE_SSE2)
+#include <emmintrin.h>
+#endif
+
+// 256位的整数运算需要AVX2，仅定义AGZ_USE_AVX而编译器未启用AVX2时退回SSE2实现
+#if defined(AGZ_USE_AVX) && defined(__AVX2__)
+#include <immintrin.h>
+#define AGZ_CHARSET_USE_AVX2
+#endif
+
+namespace AGZ::CharsetAux {
+
+/**
+ * @brief 与码元类型大小相同的无符号整数类型
+ */
+template<typename CU>
+using UnsignedCU = std::conditional_t<sizeof(CU) == 1, uint8_t,
+                   std::conditional_t<sizeof(CU) == 2, uint16_t, uint32_t>>;
+
+namespace SIMDImpl
+{
+#if defined(AGZ_USE_SSE2)
+
+    // 各分量中除低7位外均为1，与码元按位与的结果为0当且仅当该码元是ASCII字符
+    template<size_t S>
+    __m128i NonASCIIMask() noexcept
+    {
+        if constexpr(S == 1)
+            return _mm_set1_epi8(static_cast<char>(0x80));
+        else if constexpr(S == 2)
+            return _mm_set1_epi16(static_cast<short>(0xff80));
+        else
+            return _mm_set1_epi32(static_cast<int>(0xffffff80));
+    }
+
+    inline bool IsZero(__m128i v) noexcept
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xffff;
+    }
+
+    // 将count个分量大小为S字节的向量中的分量扩展到2S字节，结果写入out[0, 2 * count)
+    template<size_t S>
+    void Widen(const __m128i *in, size_t count, __m128i *out) noexcept
+    {
+        const __m128i zero = _mm_setzero_si128();
+        for(size_t i = count; i-- > 0;)
+        {
+            __m128i v = in[i];
+            if constexpr(S == 1)
+            {
+                out[2 * i]     = _mm_unpacklo_epi8(v, zero);
+                out[2 * i + 1] = _mm_unpackhi_epi8(v, zero);
+            }
+            else
+            {
+                out[2 * i]     = _mm_unpacklo_epi16(v, zero);
+                out[2 * i + 1] = _mm_unpackhi_epi16(v, zero);
+            }
+        }
+    }
+
+    // 将count个分量大小为S字节的向量中的分量收窄到S/2字节，结果写入out[0, count / 2)。各分量的值必须小于0x80
+    template<size_t S>
+    void Narrow(const __m128i *in, size_t count, __m128i *out) noexcept
+    {
+        for(size_t i = 0; i < count / 2; ++i)
+        {
+            if constexpr(S == 2)
+                out[i] = _mm_packus_epi16(in[2 * i], in[2 * i + 1]);
+            else
+                out[i] = _mm_packs_epi32(in[2 * i], in[2 * i + 1]);
+        }
+    }
+
+#endif
+} // namespace SIMDImpl
+
+/**
+ * @brief 求[beg, beg + n)中由ASCII字符构成的最长前缀的长度
+ *
+ * 码元按无符号整数解释，值小于0x80即视为ASCII字符。定义了AGZ_USE_SSE2/AGZ_USE_AVX时每次检查16/32字节
+ */
+template<typename CU>
+size_t ASCIIPrefixLength(const CU *beg, size_t n) noexcept
+{
+    static_assert(sizeof(CU) == 1 || sizeof(CU) == 2 || sizeof(CU) == 4);
+
+    size_t i = 0;
+
+#if defined(AGZ_CHARSET_USE_AVX2)
+    {
+        constexpr size_t STEP = 32 / sizeof(CU);
+        __m256i mask;
+        if constexpr(sizeof(CU) == 1)
+            mask = _mm256_set1_epi8(static_cast<char>(0x80));
+        else if constexpr(sizeof(CU) == 2)
+            mask = _mm256_set1_epi16(static_cast<short>(0xff80));
+        else
+            mask = _mm256_set1_epi32(static_cast<int>(0xffffff80));
+
+        for(; i + STEP <= n; i += STEP)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(beg + i));
+            if(!_mm256_testz_si256(v, mask))
+                break;
+        }
+    }
+#endif
+
+#if defined(AGZ_USE_SSE2)
+    {
+        constexpr size_t STEP = 16 / sizeof(CU);
+        const __m128i mask = SIMDImpl::NonASCIIMask<sizeof(CU)>();
+        for(; i + STEP <= n; i += STEP)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(beg + i));
+            if constexpr(sizeof(CU) == 1)
+            {
+                if(int bits = _mm_movemask_epi8(v))
+                {
+                    // 直接定位第一个非ASCII字节
+                    while(!(bits & 1))
+                        bits >>= 1, ++i;
+                    return i;
+                }
+            }
+            else if(!SIMDImpl::IsZero(_mm_and_si128(v, mask)))
+                break;
+        }
+    }
+#endif
+
+    for(; i < n; ++i)
+    {
+        if(static_cast<UnsignedCU<CU>>(beg[i]) >= 0x80)
+            break;
+    }
+    return i;
+}
+
+/**
+ * @brief 将src开头的由ASCII字符构成的最长前缀（至多n个码元）逐个复制到dst中，码元类型可以不同
+ *
+ * 定义了AGZ_USE_SSE2时，每次以向量指令检查并转换16个码元
+ *
+ * @return 被复制的码元数量
+ */
+template<typename SCU, typename DCU>
+size_t CopyASCII(const SCU *src, size_t n, DCU *dst) noexcept
+{
+    static_assert(sizeof(SCU) == 1 || sizeof(SCU) == 2 || sizeof(SCU) == 4);
+    static_assert(sizeof(DCU) == 1 || sizeof(DCU) == 2 || sizeof(DCU) == 4);
+
+    size_t i = 0;
+
+#if defined(AGZ_USE_SSE2)
+    {
+        constexpr size_t S = sizeof(SCU), D = sizeof(DCU);
+        constexpr size_t SRC_VEC = S, DST_VEC = D; // 16个码元所占的向量数
+
+        const __m128i mask = SIMDImpl::NonASCIIMask<S>();
+
+        for(; i + 16 <= n; i += 16)
+        {
+            __m128i buf[4], tmp[4];
+            __m128i acc = _mm_setzero_si128();
+            for(size_t k = 0; k < SRC_VEC; ++k)
+            {
+                buf[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i) + k);
+                acc = _mm_or_si128(acc, buf[k]);
+            }
+            if(!SIMDImpl::IsZero(_mm_and_si128(acc, mask)))
+                break;
+
+            __m128i *out = buf;
+            if constexpr(S < D)
+            {
+                SIMDImpl::Widen<S>(buf, SRC_VEC, tmp);
+                out = tmp;
+                if constexpr(D / S == 4)
+                {
+                    SIMDImpl::Widen<2>(tmp, 2, buf);
+                    out = buf;
+                }
+            }
+            else if constexpr(S > D)
+            {
+                SIMDImpl::Narrow<S>(buf, SRC_VEC, tmp);
+                out = tmp;
+                if constexpr(S / D == 4)
+                {
+                    SIMDImpl::Narrow<2>(tmp, 2, buf);
+                    out = buf;
+                }
+            }
+
+            for(size_t k = 0; k < DST_VEC; ++k)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i) + k, out[k]);
+        }
+    }
+#endif
+
+    for(; i < n; ++i)
+    {
+        auto cu = static_cast<UnsignedCU<SCU>>(src[i]);
+        if(cu >= 0x80)
+            break;
+        dst[i] = static_cast<DCU>(cu);
+    }
+    return i;
+}
+
+} // namespace AGZ::CharsetAux
@@ -119,8 +119,11 @@ size_t UTF16Core<T>::CU2CP(const CodeUnit *cu, CodePoint *cp)
     if(0xd800 <= high && high <= 0xdbff)
     {
         char32_t low = static_cast<char32_t>(*++cu);
-        if(low <= 0xdfff)
-            return 0x10000 + (((high & 0x3ff) << 10) | (low & 0x3ff));
+        if(0xdc00 <= low && low <= 0xdfff)
+        {
+            *cp = 0x10000 + (((high & 0x3ff) << 10) | (low & 0x3ff));
+            return 2;
+        }
         return 0;
     }
 
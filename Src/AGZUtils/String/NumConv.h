@@ -0,0 +1,834 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+
+#include "../Misc/Common.h"
+
+namespace AGZ {
+
+/**
+ * @brief 数值与字符串相互转换时的错误类型
+ */
+enum class NumConvError
+{
+    OK,         ///< 转换成功
+    Invalid,    ///< 输入不是合法的数值
+    OutOfRange, ///< 数值超出了目标类型的表示范围
+};
+
+/**
+ * @brief FromChars 的结果
+ */
+template<typename CU>
+struct FromCharsResult
+{
+    const CU *ptr;      ///< 第一个未被使用的码元。error为Invalid时等于输入的起始位置
+    NumConvError error; ///< 错误类型
+};
+
+/**
+ * @brief 使用 AGZ::ToChars 格式化浮点数时所需的最大码元数量
+ */
+constexpr size_t MAX_FLOAT_CHARS = 32;
+
+/**
+ * @brief 将整数格式化为字符串时所需的最大码元数量（二进制，含负号）
+ */
+constexpr size_t MAX_INT_CHARS = 66;
+
+namespace NumConvImpl
+{
+    template<typename CU>
+    unsigned DigitValue(CU c) noexcept
+    {
+        auto u = static_cast<uint32_t>(static_cast<std::make_unsigned_t<CU>>(c));
+        if(u - '0' < 10)
+            return u - '0';
+        u |= 0x20;
+        if(u - 'a' < 26)
+            return u - 'a' + 10;
+        return 255;
+    }
+
+    // 不区分大小写地比较[p, end)的前缀和小写ASCII串word
+    template<typename CU>
+    bool MatchWord(const CU *p, const CU *end, const char *word) noexcept
+    {
+        for(; *word; ++word, ++p)
+        {
+            if(p == end || (static_cast<uint32_t>(static_cast<std::make_unsigned_t<CU>>(*p)) | 0x20) != uint32_t(*word))
+                return false;
+        }
+        return true;
+    }
+
+    template<typename CU>
+    unsigned DecDigit(CU c) noexcept
+    {
+        return static_cast<uint32_t>(static_cast<std::make_unsigned_t<CU>>(c)) - uint32_t('0');
+    }
+
+    // 00, 01, ..., 99
+    inline const char *TwoDigits(unsigned n) noexcept
+    {
+        static const char TABLE[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        return TABLE + 2 * n;
+    }
+
+    //============================= 浮点数解析 =============================
+
+    template<typename T>
+    struct FloatTraits;
+
+    template<>
+    struct FloatTraits<double>
+    {
+        using Bits = uint64_t;
+        static constexpr int PRECISION  = 53; // 含隐含位
+        static constexpr int EXP_BIAS   = 1075;
+        static constexpr int FAST_EXP10 = 22; // 10^22是double能精确表示的最大的10的幂
+
+        static double Pow10(int e) noexcept
+        {
+            static const double TABLE[] =
+            {
+                1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            return TABLE[e];
+        }
+    };
+
+    template<>
+    struct FloatTraits<float>
+    {
+        using Bits = uint32_t;
+        static constexpr int PRECISION  = 24;
+        static constexpr int EXP_BIAS   = 150;
+        static constexpr int FAST_EXP10 = 10;
+
+        static float Pow10(int e) noexcept
+        {
+            static const float TABLE[] =
+            {
+                1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+            };
+            return TABLE[e];
+        }
+    };
+
+    // 慢速路径：将[beg, end)中已经确认格式合法的数值交给标准库做正确舍入的转换
+    template<typename T, typename CU>
+    NumConvError SlowParseFloat(const CU *beg, const CU *end, bool neg, T &value)
+    {
+        std::string str;
+        str.reserve(static_cast<size_t>(end - beg) + 1);
+        if(neg)
+            str.push_back('-');
+        for(; beg != end; ++beg)
+            str.push_back(static_cast<char>(*beg));
+
+        T ret;
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        auto [ptr, err] = std::from_chars(str.data(), str.data() + str.size(), ret);
+        if(err == std::errc::result_out_of_range)
+            return NumConvError::OutOfRange;
+        if(err != std::errc() || ptr != str.data() + str.size())
+            return NumConvError::Invalid;
+#else
+        std::istringstream sst(str);
+        sst.imbue(std::locale::classic());
+        sst >> ret;
+        if(!sst || sst.peek() != std::char_traits<char>::eof())
+            return NumConvError::OutOfRange;
+#endif
+
+        value = ret;
+        return NumConvError::OK;
+    }
+
+    //============================= 浮点数格式化 =============================
+
+    // Grisu2算法，参见Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010
+    // 生成的十进制串总能被还原为原浮点数，且在绝大多数情况下是最短的
+
+    struct DiyFp
+    {
+        uint64_t f;
+        int e;
+    };
+
+    inline DiyFp Sub(const DiyFp &x, const DiyFp &y) noexcept
+    {
+        AGZ_ASSERT(x.e == y.e && x.f >= y.f);
+        return { x.f - y.f, x.e };
+    }
+
+    // 两个64位数之积的高64位（舍入到最近）
+    inline DiyFp Mul(const DiyFp &x, const DiyFp &y) noexcept
+    {
+        uint64_t xLo = x.f & 0xffffffffu, xHi = x.f >> 32;
+        uint64_t yLo = y.f & 0xffffffffu, yHi = y.f >> 32;
+
+        uint64_t p0 = xLo * yLo, p1 = xLo * yHi, p2 = xHi * yLo, p3 = xHi * yHi;
+        uint64_t q = (p0 >> 32) + (p1 & 0xffffffffu) + (p2 & 0xffffffffu) + (uint64_t(1) << 31);
+        uint64_t h = p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32);
+
+        return { h, x.e + y.e + 64 };
+    }
+
+    inline DiyFp Normalize(DiyFp x) noexcept
+    {
+        AGZ_ASSERT(x.f != 0);
+        while(!(x.f >> 63))
+        {
+            x.f <<= 1;
+            --x.e;
+        }
+        return x;
+    }
+
+    inline DiyFp NormalizeTo(const DiyFp &x, int e) noexcept
+    {
+        int delta = x.e - e;
+        AGZ_ASSERT(delta >= 0 && ((x.f << delta) >> delta) == x.f);
+        return { x.f << delta, e };
+    }
+
+    struct Boundaries
+    {
+        DiyFp w, minus, plus;
+    };
+
+    // 求正有限浮点数v及其与相邻浮点数的中点m-、m+，三者具有相同的指数
+    template<typename T>
+    Boundaries ComputeBoundaries(T value) noexcept
+    {
+        using Traits = FloatTraits<T>;
+        using Bits   = typename Traits::Bits;
+
+        constexpr int PRECISION     = Traits::PRECISION;
+        constexpr int MIN_EXP       = 1 - Traits::EXP_BIAS;
+        constexpr uint64_t HIDDEN   = uint64_t(1) << (PRECISION - 1);
+
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        uint64_t E = bits >> (PRECISION - 1);
+        uint64_t F = bits & (HIDDEN - 1);
+
+        DiyFp v = E ? DiyFp{ F + HIDDEN, static_cast<int>(E) - Traits::EXP_BIAS } : DiyFp{ F, MIN_EXP };
+
+        // 当F为0且E > 1时，下方相邻浮点数的间距只有上方的一半
+        bool lowerIsCloser = F == 0 && E > 1;
+        DiyFp mPlus = { 2 * v.f + 1, v.e - 1 };
+        DiyFp mMinus = lowerIsCloser ? DiyFp{ 4 * v.f - 1, v.e - 2 } : DiyFp{ 2 * v.f - 1, v.e - 1 };
+
+        DiyFp wPlus = Normalize(mPlus);
+        return { Normalize(v), NormalizeTo(mMinus, wPlus.e), wPlus };
+    }
+
+    struct CachedPower
+    {
+        uint64_t f;
+        int e;
+        int k;
+    };
+
+    // 选取c = 10^-k，使得ALPHA <= c.e + e + 64 <= GAMMA
+    constexpr int ALPHA = -60;
+    constexpr int GAMMA = -32;
+
+    inline CachedPower GetCachedPower(int e) noexcept
+    {
+        // 10^k（k = -300, -292, ..., 324）规范化为64位尾数后的值
+        static const CachedPower POWERS[] =
+        {
+        { 0xAB70FE17C79AC6CAull, -1060, -300 },
+        { 0xFF77B1FCBEBCDC4Full, -1034, -292 },
+        { 0xBE5691EF416BD60Cull, -1007, -284 },
+        { 0x8DD01FAD907FFC3Cull,  -980, -276 },
+        { 0xD3515C2831559A83ull,  -954, -268 },
+        { 0x9D71AC8FADA6C9B5ull,  -927, -260 },
+        { 0xEA9C227723EE8BCBull,  -901, -252 },
+        { 0xAECC49914078536Dull,  -874, -244 },
+        { 0x823C12795DB6CE57ull,  -847, -236 },
+        { 0xC21094364DFB5637ull,  -821, -228 },
+        { 0x9096EA6F3848984Full,  -794, -220 },
+        { 0xD77485CB25823AC7ull,  -768, -212 },
+        { 0xA086CFCD97BF97F4ull,  -741, -204 },
+        { 0xEF340A98172AACE5ull,  -715, -196 },
+        { 0xB23867FB2A35B28Eull,  -688, -188 },
+        { 0x84C8D4DFD2C63F3Bull,  -661, -180 },
+        { 0xC5DD44271AD3CDBAull,  -635, -172 },
+        { 0x936B9FCEBB25C996ull,  -608, -164 },
+        { 0xDBAC6C247D62A584ull,  -582, -156 },
+        { 0xA3AB66580D5FDAF6ull,  -555, -148 },
+        { 0xF3E2F893DEC3F126ull,  -529, -140 },
+        { 0xB5B5ADA8AAFF80B8ull,  -502, -132 },
+        { 0x87625F056C7C4A8Bull,  -475, -124 },
+        { 0xC9BCFF6034C13053ull,  -449, -116 },
+        { 0x964E858C91BA2655ull,  -422, -108 },
+        { 0xDFF9772470297EBDull,  -396, -100 },
+        { 0xA6DFBD9FB8E5B88Full,  -369,  -92 },
+        { 0xF8A95FCF88747D94ull,  -343,  -84 },
+        { 0xB94470938FA89BCFull,  -316,  -76 },
+        { 0x8A08F0F8BF0F156Bull,  -289,  -68 },
+        { 0xCDB02555653131B6ull,  -263,  -60 },
+        { 0x993FE2C6D07B7FACull,  -236,  -52 },
+        { 0xE45C10C42A2B3B06ull,  -210,  -44 },
+        { 0xAA242499697392D3ull,  -183,  -36 },
+        { 0xFD87B5F28300CA0Eull,  -157,  -28 },
+        { 0xBCE5086492111AEBull,  -130,  -20 },
+        { 0x8CBCCC096F5088CCull,  -103,  -12 },
+        { 0xD1B71758E219652Cull,   -77,   -4 },
+        { 0x9C40000000000000ull,   -50,    4 },
+        { 0xE8D4A51000000000ull,   -24,   12 },
+        { 0xAD78EBC5AC620000ull,     3,   20 },
+        { 0x813F3978F8940984ull,    30,   28 },
+        { 0xC097CE7BC90715B3ull,    56,   36 },
+        { 0x8F7E32CE7BEA5C70ull,    83,   44 },
+        { 0xD5D238A4ABE98068ull,   109,   52 },
+        { 0x9F4F2726179A2245ull,   136,   60 },
+        { 0xED63A231D4C4FB27ull,   162,   68 },
+        { 0xB0DE65388CC8ADA8ull,   189,   76 },
+        { 0x83C7088E1AAB65DBull,   216,   84 },
+        { 0xC45D1DF942711D9Aull,   242,   92 },
+        { 0x924D692CA61BE758ull,   269,  100 },
+        { 0xDA01EE641A708DEAull,   295,  108 },
+        { 0xA26DA3999AEF774Aull,   322,  116 },
+        { 0xF209787BB47D6B85ull,   348,  124 },
+        { 0xB454E4A179DD1877ull,   375,  132 },
+        { 0x865B86925B9BC5C2ull,   402,  140 },
+        { 0xC83553C5C8965D3Dull,   428,  148 },
+        { 0x952AB45CFA97A0B3ull,   455,  156 },
+        { 0xDE469FBD99A05FE3ull,   481,  164 },
+        { 0xA59BC234DB398C25ull,   508,  172 },
+        { 0xF6C69A72A3989F5Cull,   534,  180 },
+        { 0xB7DCBF5354E9BECEull,   561,  188 },
+        { 0x88FCF317F22241E2ull,   588,  196 },
+        { 0xCC20CE9BD35C78A5ull,   614,  204 },
+        { 0x98165AF37B2153DFull,   641,  212 },
+        { 0xE2A0B5DC971F303Aull,   667,  220 },
+        { 0xA8D9D1535CE3B396ull,   694,  228 },
+        { 0xFB9B7CD9A4A7443Cull,   720,  236 },
+        { 0xBB764C4CA7A44410ull,   747,  244 },
+        { 0x8BAB8EEFB6409C1Aull,   774,  252 },
+        { 0xD01FEF10A657842Cull,   800,  260 },
+        { 0x9B10A4E5E9913129ull,   827,  268 },
+        { 0xE7109BFBA19C0C9Dull,   853,  276 },
+        { 0xAC2820D9623BF429ull,   880,  284 },
+        { 0x80444B5E7AA7CF85ull,   907,  292 },
+        { 0xBF21E44003ACDD2Dull,   933,  300 },
+        { 0x8E679C2F5E44FF8Full,   960,  308 },
+        { 0xD433179D9C8CB841ull,   986,  316 },
+        { 0x9E19DB92B4E31BA9ull,  1013,  324 },
+        };
+
+        constexpr int MIN_DEC_EXP  = -300;
+        constexpr int DEC_EXP_STEP = 8;
+
+        int f = ALPHA - e - 1;
+        int k = (f * 78913) / (1 << 18) + (f > 0); // ceil(f * log10(2))
+
+        int index = (-MIN_DEC_EXP + k + (DEC_EXP_STEP - 1)) / DEC_EXP_STEP;
+        AGZ_ASSERT(0 <= index && index < static_cast<int>(sizeof(POWERS) / sizeof(POWERS[0])));
+
+        CachedPower ret = POWERS[index];
+        AGZ_ASSERT(ALPHA <= ret.e + e + 64 && ret.e + e + 64 <= GAMMA);
+        return ret;
+    }
+
+    // 求满足pow10 <= n < 10 * pow10的10的幂pow10，返回其位数
+    inline int FindLargestPow10(uint32_t n, uint32_t &pow10) noexcept
+    {
+        static const uint32_t POW10[] =
+        {
+            1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+        };
+        int ret = 10;
+        while(ret > 1 && n < POW10[ret - 1])
+            --ret;
+        pow10 = POW10[ret - 1];
+        return ret;
+    }
+
+    inline void Round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenK) noexcept
+    {
+        // 在不离开区间(M-, M+)的前提下，使结果尽可能接近w
+        while(rest < dist && delta - rest >= tenK && (rest + tenK < dist || dist - rest > rest + tenK - dist))
+        {
+            --buf[len - 1];
+            rest += tenK;
+        }
+    }
+
+    // 生成M-和M+之间的最短十进制数，写入buf[0, len)，其值为buf * 10^decExp
+    inline void GenerateDigits(char *buf, int &len, int &decExp, DiyFp mMinus, DiyFp w, DiyFp mPlus) noexcept
+    {
+        uint64_t delta = Sub(mPlus, mMinus).f;
+        uint64_t dist  = Sub(mPlus, w).f;
+
+        const DiyFp one = { uint64_t(1) << -mPlus.e, mPlus.e };
+
+        auto p1 = static_cast<uint32_t>(mPlus.f >> -one.e);
+        uint64_t p2 = mPlus.f & (one.f - 1);
+
+        // 整数部分
+        uint32_t pow10;
+        int n = FindLargestPow10(p1, pow10);
+        while(n > 0)
+        {
+            uint32_t d = p1 / pow10, r = p1 % pow10;
+            buf[len++] = static_cast<char>('0' + d);
+            p1 = r;
+            --n;
+
+            uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+            if(rest <= delta)
+            {
+                decExp += n;
+                Round(buf, len, dist, delta, rest, uint64_t(pow10) << -one.e);
+                return;
+            }
+            pow10 /= 10;
+        }
+
+        // 小数部分
+        int m = 0;
+        for(;;)
+        {
+            p2 *= 10;
+            auto d = static_cast<char>(p2 >> -one.e);
+            buf[len++] = static_cast<char>('0' + d);
+            p2 &= one.f - 1;
+            ++m;
+
+            delta *= 10;
+            dist  *= 10;
+            if(p2 <= delta)
+                break;
+        }
+        decExp -= m;
+        Round(buf, len, dist, delta, p2, one.f);
+    }
+
+    // 将正有限浮点数value转换为能还原出value的十进制数字串buf[0, len)，其值为buf * 10^decExp
+    template<typename T>
+    void Grisu2(char *buf, int &len, int &decExp, T value) noexcept
+    {
+        Boundaries b = ComputeBoundaries(value);
+        CachedPower cached = GetCachedPower(b.plus.e);
+        DiyFp c = { cached.f, cached.e };
+
+        DiyFp w      = Mul(b.w, c);
+        DiyFp wMinus = Mul(b.minus, c);
+        DiyFp wPlus  = Mul(b.plus, c);
+
+        // 乘法的误差至多为1ulp，收窄区间以保证结果仍在原区间内
+        DiyFp mMinus = { wMinus.f + 1, wMinus.e };
+        DiyFp mPlus  = { wPlus.f - 1, wPlus.e };
+
+        len = 0;
+        decExp = -cached.k;
+        GenerateDigits(buf, len, decExp, mMinus, w, mPlus);
+    }
+
+    // 将数字串digits[0, len) * 10^decExp写为十进制或科学计数法形式，规则与ECMAScript的Number.prototype.toString相同
+    template<typename CU>
+    CU *FormatDigits(const char *digits, int len, int decExp, CU *out) noexcept
+    {
+        int pointPos = len + decExp;
+
+        if(decExp >= 0 && pointPos <= 21)
+        {
+            for(int i = 0; i < len; ++i)
+                *out++ = CU(digits[i]);
+            for(int i = 0; i < decExp; ++i)
+                *out++ = CU('0');
+            return out;
+        }
+
+        if(0 < pointPos && pointPos <= 21)
+        {
+            for(int i = 0; i < pointPos; ++i)
+                *out++ = CU(digits[i]);
+            *out++ = CU('.');
+            for(int i = pointPos; i < len; ++i)
+                *out++ = CU(digits[i]);
+            return out;
+        }
+
+        if(-6 < pointPos && pointPos <= 0)
+        {
+            *out++ = CU('0');
+            *out++ = CU('.');
+            for(int i = pointPos; i < 0; ++i)
+                *out++ = CU('0');
+            for(int i = 0; i < len; ++i)
+                *out++ = CU(digits[i]);
+            return out;
+        }
+
+        *out++ = CU(digits[0]);
+        if(len > 1)
+        {
+            *out++ = CU('.');
+            for(int i = 1; i < len; ++i)
+                *out++ = CU(digits[i]);
+        }
+
+        int e = pointPos - 1;
+        *out++ = CU('e');
+        *out++ = CU(e < 0 ? '-' : '+');
+        e = e < 0 ? -e : e;
+        if(e >= 100)
+            *out++ = CU('0' + e / 100);
+        if(e >= 10)
+            *out++ = CU('0' + e / 10 % 10);
+        *out++ = CU('0' + e % 10);
+        return out;
+    }
+
+} // namespace NumConvImpl
+
+/**
+ * @brief 从[beg, end)的开头解析一个整数
+ *
+ * 接受可选的正负号（无符号类型不接受负号）和至少一个base进制的数字，不跳过空白字符，不接受“0x”等前缀。
+ * 与std::from_chars类似，不依赖locale，也不分配内存。
+ *
+ * @param base 进制，取值范围为[2, 36]
+ *
+ * @return 成功时ptr指向第一个未被使用的码元；溢出时value不会被修改，ptr仍指向数字之后
+ */
+template<typename T, typename CU,
+         std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+FromCharsResult<CU> FromChars(const CU *beg, const CU *end, T &value, int base = 10) noexcept
+{
+    AGZ_ASSERT(2 <= base && base <= 36);
+    using U = std::make_unsigned_t<T>;
+
+    const CU *p = beg;
+    bool neg = false;
+    if(p != end && (*p == CU('+') || *p == CU('-')))
+    {
+        neg = *p == CU('-');
+        if constexpr(std::is_unsigned_v<T>)
+        {
+            if(neg)
+                return { beg, NumConvError::Invalid };
+        }
+        ++p;
+    }
+
+    const U limit = neg ? static_cast<U>(static_cast<U>((std::numeric_limits<T>::max)()) + 1)
+                        : static_cast<U>((std::numeric_limits<T>::max)());
+    const U ubase = static_cast<U>(base);
+
+    const CU *digits = p;
+    U acc = 0;
+    bool overflow = false;
+    for(; p != end; ++p)
+    {
+        unsigned d = NumConvImpl::DigitValue(*p);
+        if(d >= static_cast<unsigned>(base))
+            break;
+        if(acc > (limit - d) / ubase)
+            overflow = true;
+        else
+            acc = static_cast<U>(acc * ubase + d);
+    }
+
+    if(p == digits)
+        return { beg, NumConvError::Invalid };
+    if(overflow)
+        return { p, NumConvError::OutOfRange };
+
+    value = neg ? static_cast<T>(static_cast<U>(U(0) - acc)) : static_cast<T>(acc);
+    return { p, NumConvError::OK };
+}
+
+/**
+ * @brief 从[beg, end)的开头解析一个浮点数
+ *
+ * 接受的格式为：可选的正负号，十进制数字（可含小数点，小数点两侧至少有一个数字），可选的指数部分（e/E、可选的正负号和数字）；
+ * 以及不区分大小写的“inf”、“infinity”、“nan”。不跳过空白字符，不依赖locale。
+ *
+ * 有效数字不超过19位、且指数较小时（绝大多数手写或由程序输出的数值）直接以一次精确的浮点运算得到正确舍入的结果，
+ * 其余情况交给标准库完成正确舍入。
+ *
+ * @return 成功时ptr指向第一个未被使用的码元；上溢或下溢时value不会被修改，ptr仍指向数值之后
+ */
+template<typename T, typename CU, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+FromCharsResult<CU> FromChars(const CU *beg, const CU *end, T &value)
+{
+    using namespace NumConvImpl;
+    using Traits = FloatTraits<T>;
+
+    const CU *p = beg;
+    bool neg = false;
+    if(p != end && (*p == CU('+') || *p == CU('-')))
+    {
+        neg = *p == CU('-');
+        ++p;
+    }
+
+    if(MatchWord(p, end, "inf"))
+    {
+        p += MatchWord(p + 3, end, "inity") ? 8 : 3;
+        value = neg ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+        return { p, NumConvError::OK };
+    }
+    if(MatchWord(p, end, "nan"))
+    {
+        value = neg ? -std::numeric_limits<T>::quiet_NaN() : std::numeric_limits<T>::quiet_NaN();
+        return { p + 3, NumConvError::OK };
+    }
+
+    // 至多保留19位有效数字，value = mant * 10^exp10
+    constexpr int MAX_DIGITS = 19;
+
+    const CU *numBeg = p;
+    uint64_t mant = 0;
+    int digitCount = 0, exp10 = 0;
+    bool anyDigit = false, truncated = false;
+
+    for(; p != end && *p == CU('0'); ++p)
+        anyDigit = true;
+    for(unsigned d; p != end && (d = DecDigit(*p)) < 10; ++p)
+    {
+        anyDigit = true;
+        if(digitCount < MAX_DIGITS)
+        {
+            mant = mant * 10 + d;
+            ++digitCount;
+        }
+        else
+        {
+            ++exp10;
+            truncated |= d != 0;
+        }
+    }
+
+    if(p != end && *p == CU('.'))
+    {
+        ++p;
+        if(!digitCount)
+        {
+            for(; p != end && *p == CU('0'); ++p)
+            {
+                anyDigit = true;
+                --exp10;
+            }
+        }
+        for(unsigned d; p != end && (d = DecDigit(*p)) < 10; ++p)
+        {
+            anyDigit = true;
+            if(digitCount < MAX_DIGITS)
+            {
+                mant = mant * 10 + d;
+                ++digitCount;
+                --exp10;
+            }
+            else
+                truncated |= d != 0;
+        }
+    }
+
+    if(!anyDigit)
+        return { beg, NumConvError::Invalid };
+
+    // 指数部分仅在其后确实有数字时才被使用，“1e”会被解析为1，并停在“e”处
+    if(p != end && (*p == CU('e') || *p == CU('E')))
+    {
+        const CU *q = p + 1;
+        bool expNeg = false;
+        if(q != end && (*q == CU('+') || *q == CU('-')))
+        {
+            expNeg = *q == CU('-');
+            ++q;
+        }
+        if(q != end && DecDigit(*q) < 10)
+        {
+            int e = 0;
+            for(unsigned d; q != end && (d = DecDigit(*q)) < 10; ++q)
+            {
+                if(e < 100000)
+                    e = e * 10 + static_cast<int>(d);
+            }
+            exp10 += expNeg ? -e : e;
+            p = q;
+        }
+    }
+
+    if(!truncated)
+    {
+        if(!mant)
+        {
+            value = neg ? -T(0) : T(0);
+            return { p, NumConvError::OK };
+        }
+
+        // mant与10^|exp10|都能被精确表示时，一次乘除法即可得到正确舍入的结果
+        constexpr uint64_t MAX_EXACT = uint64_t(1) << Traits::PRECISION;
+        if(mant <= MAX_EXACT)
+        {
+            if(exp10 > Traits::FAST_EXP10)
+            {
+                // 如1.5e25，多出的10的幂可以先乘到mant上
+                for(; exp10 > Traits::FAST_EXP10 && mant <= MAX_EXACT / 10; --exp10)
+                    mant *= 10;
+            }
+
+            if(0 <= exp10 && exp10 <= Traits::FAST_EXP10)
+            {
+                T ret = static_cast<T>(mant) * Traits::Pow10(exp10);
+                value = neg ? -ret : ret;
+                return { p, NumConvError::OK };
+            }
+            if(-Traits::FAST_EXP10 <= exp10 && exp10 < 0)
+            {
+                T ret = static_cast<T>(mant) / Traits::Pow10(-exp10);
+                value = neg ? -ret : ret;
+                return { p, NumConvError::OK };
+            }
+        }
+    }
+
+    NumConvError err = SlowParseFloat(numBeg, p, neg, value);
+    return { err == NumConvError::Invalid ? beg : p, err };
+}
+
+/**
+ * @brief 将整数value以base进制写入out，不写入结尾的'\0'
+ *
+ * out中至少应有 MAX_INT_CHARS 个码元的空间
+ *
+ * @return 写入的最后一个码元之后的位置
+ */
+template<typename T, typename CU,
+         std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+CU *ToChars(T value, CU *out, int base = 10) noexcept
+{
+    AGZ_ASSERT(2 <= base && base <= 36);
+    using U = std::make_unsigned_t<T>;
+
+    auto u = static_cast<U>(value);
+    if constexpr(std::is_signed_v<T>)
+    {
+        if(value < 0)
+        {
+            *out++ = CU('-');
+            u = static_cast<U>(U(0) - u);
+        }
+    }
+
+    // 先倒序写入临时缓冲区。十进制时每次处理两位
+    char tmp[MAX_INT_CHARS];
+    char *t = tmp + MAX_INT_CHARS;
+    if(base == 10)
+    {
+        while(u >= 100)
+        {
+            const char *two = NumConvImpl::TwoDigits(static_cast<unsigned>(u % 100));
+            u /= 100;
+            *--t = two[1];
+            *--t = two[0];
+        }
+        if(u >= 10)
+        {
+            const char *two = NumConvImpl::TwoDigits(static_cast<unsigned>(u));
+            *--t = two[1];
+            *--t = two[0];
+        }
+        else
+            *--t = static_cast<char>('0' + u);
+    }
+    else
+    {
+        const auto ubase = static_cast<U>(base);
+        do
+        {
+            *--t = "0123456789abcdefghijklmnopqrstuvwxyz"[u % ubase];
+            u /= ubase;
+        } while(u);
+    }
+
+    for(; t != tmp + MAX_INT_CHARS; ++t)
+        *out++ = CU(*t);
+    return out;
+}
+
+/**
+ * @brief 将能还原出浮点数value的十进制表示写入out，不写入结尾的'\0'
+ *
+ * 结果总能被 FromChars 还原为value本身（Grisu2算法，绝大多数情况下也是最短的）。
+ * 格式与ECMAScript的Number.prototype.toString相同：如“0.1”、“-1.5”、“100”、“1e+21”、“1.5e-7”，
+ * 非有限值写为“inf”、“-inf”、“nan”。
+ *
+ * out中至少应有 MAX_FLOAT_CHARS 个码元的空间
+ *
+ * @return 写入的最后一个码元之后的位置
+ */
+template<typename T, typename CU, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+CU *ToChars(T value, CU *out) noexcept
+{
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>);
+
+    auto write = [&](const char *s)
+    {
+        for(; *s; ++s)
+            *out++ = CU(*s);
+        return out;
+    };
+
+    if(std::isnan(value))
+        return write("nan");
+    if(std::signbit(value))
+    {
+        *out++ = CU('-');
+        value = -value;
+    }
+    if(std::isinf(value))
+        return write("inf");
+    if(value == 0)
+        return write("0");
+
+    char digits[20];
+    int len, decExp;
+    NumConvImpl::Grisu2(digits, len, decExp, value);
+    return NumConvImpl::FormatDigits(digits, len, decExp, out);
+}
+
+/**
+ * @brief 将[beg, end)完整地解析为一个数值，任何多余的码元都视为Invalid
+ */
+template<typename T, typename CU, typename...Args>
+NumConvError FromCharsExact(const CU *beg, const CU *end, T &value, Args...args)
+{
+    T ret;
+    auto [ptr, err] = FromChars(beg, end, ret, args...);
+    if(err != NumConvError::OK)
+        return err;
+    if(ptr != end)
+        return NumConvError::Invalid;
+    value = ret;
+    return NumConvError::OK;
+}
+
+} // namespace AGZ
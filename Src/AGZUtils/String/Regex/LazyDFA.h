@@ -0,0 +1,7 @@
+#pragma once
+
+#include "LazyDFA/CharClass.h"
+#include "LazyDFA/Closure.h"
+#include "LazyDFA/StateCache.h"
+#include "LazyDFA/Machine.h"
+#include "LazyDFA/SetMachine.h"
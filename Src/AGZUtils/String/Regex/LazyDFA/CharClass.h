@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+#include "../../String/StrAlgo.h"
+#include "../../String/String.h"
+#include "../PikeVM/Backend.h"
+#include "../PikeVM/Inst.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::LazyDFA {
+
+using PikeVM::Inst;
+using PikeVM::InstType;
+using PikeVM::Program;
+
+// Does the instruction test (and consume) a code point?
+// A char expression (CharExpr... CharExprEnd) is treated as a single
+// consuming instruction located at its first instruction.
+inline bool IsConsumingInst(InstType type)
+{
+    switch(type)
+    {
+    case InstType::Begin:
+    case InstType::End:
+    case InstType::Save:
+    case InstType::Alter:
+    case InstType::Jump:
+    case InstType::Branch:
+    case InstType::Match:
+    case InstType::CharExprEnd:
+        return false;
+    default:
+        return true;
+    }
+}
+
+inline bool IsCharExprInst(InstType type)
+{
+    switch(type)
+    {
+    case InstType::CharSingle:
+    case InstType::CharAny:
+    case InstType::CharRange:
+    case InstType::CharDecDigit:
+    case InstType::CharHexDigit:
+    case InstType::CharAlpha:
+    case InstType::CharWordChar:
+    case InstType::CharWhitespace:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Index of the instruction following the consuming instruction at pc
+template<typename CP>
+uint32_t NextOfConsumingInst(const Program<CP> &prog, uint32_t pc)
+{
+    AGZ_ASSERT(IsConsumingInst(prog.GetInst(pc).type));
+    if(!IsCharExprInst(prog.GetInst(pc).type))
+        return pc + 1;
+
+    // Char expressions can not be nested, and all the jumps in it
+    // are forward jumps ending at or before its CharExprEnd
+    while(prog.GetInst(pc).type != InstType::CharExprEnd)
+        ++pc;
+    return pc + 1;
+}
+
+// Whether the consuming instruction at pc accepts cp.
+// Char expressions are evaluated in the same way as PikeVM::Machine does
+template<typename CP>
+bool AcceptCodePoint(const Program<CP> &prog, uint32_t pc, CP cp)
+{
+    const Inst<CP> *inst = &prog.GetInst(pc);
+    switch(inst->type)
+    {
+    case InstType::CharSingle:
+        return inst->dataCharSingle.codePoint == cp;
+    case InstType::CharAny:
+        return true;
+    case InstType::CharRange:
+        return inst->dataCharRange.fst <= cp && cp <= inst->dataCharRange.lst;
+    case InstType::CharDecDigit:
+        return StrAlgo::IsUnicodeDigit(cp);
+    case InstType::CharHexDigit:
+        return StrAlgo::IsUnicodeHexDigit(cp);
+    case InstType::CharAlpha:
+        return StrAlgo::IsUnicodeAlpha(cp);
+    case InstType::CharWordChar:
+        return StrAlgo::IsUnicodeAlnum(cp) || cp == '_';
+    case InstType::CharWhitespace:
+        return StrAlgo::IsUnicodeWhitespace(cp);
+    default:
+        break;
+    }
+
+    bool reg = true;
+    for(;;)
+    {
+        switch(inst->type)
+        {
+        case InstType::CharExprSingle:
+            reg = cp == inst->dataCharExprSingle.codePoint;
+            ++inst;
+            break;
+        case InstType::CharExprAny:
+            reg = true;
+            ++inst;
+            break;
+        case InstType::CharExprRange:
+            reg = inst->dataCharExprRange.fst <= cp &&
+                  cp <= inst->dataCharExprRange.lst;
+            ++inst;
+            break;
+        case InstType::CharExprDecDigit:
+            reg = StrAlgo::IsUnicodeDigit(cp);
+            ++inst;
+            break;
+        case InstType::CharExprHexDigit:
+            reg = StrAlgo::IsUnicodeHexDigit(cp);
+            ++inst;
+            break;
+        case InstType::CharExprAlpha:
+            reg = StrAlgo::IsUnicodeAlpha(cp);
+            ++inst;
+            break;
+        case InstType::CharExprWordChar:
+            reg = StrAlgo::IsUnicodeAlnum(cp) || cp == '_';
+            ++inst;
+            break;
+        case InstType::CharExprWhitespace:
+            reg = StrAlgo::IsUnicodeWhitespace(cp);
+            ++inst;
+            break;
+        case InstType::CharExprITSTAJ:
+            inst += reg ? inst->dataITSTAJ.offset : 1;
+            break;
+        case InstType::CharExprIFSFAJ:
+            inst += !reg ? inst->dataIFSFAJ.offset : 1;
+            break;
+        case InstType::CharExprSetTrue:
+            reg = true;
+            ++inst;
+            break;
+        case InstType::CharExprSetFalse:
+            reg = false;
+            ++inst;
+            break;
+        case InstType::CharExprNot:
+            reg = !reg;
+            ++inst;
+            break;
+        case InstType::CharExprEnd:
+            return reg;
+        default:
+            Unreachable();
+        }
+    }
+}
+
+// Key identifying the condition tested by a consuming instruction.
+// Instructions with equal keys accept exactly the same code points
+template<typename CP>
+std::vector<uint32_t> ConditionKey(const Program<CP> &prog, uint32_t pc)
+{
+    std::vector<uint32_t> ret;
+    uint32_t end = NextOfConsumingInst(prog, pc);
+    for(uint32_t i = pc; i < end; ++i)
+    {
+        auto &inst = prog.GetInst(i);
+        ret.push_back(static_cast<uint32_t>(inst.type));
+        switch(inst.type)
+        {
+        case InstType::CharSingle:
+            ret.push_back(static_cast<uint32_t>(inst.dataCharSingle.codePoint));
+            break;
+        case InstType::CharExprSingle:
+            ret.push_back(static_cast<uint32_t>(inst.dataCharExprSingle.codePoint));
+            break;
+        case InstType::CharRange:
+            ret.push_back(static_cast<uint32_t>(inst.dataCharRange.fst));
+            ret.push_back(static_cast<uint32_t>(inst.dataCharRange.lst));
+            break;
+        case InstType::CharExprRange:
+            ret.push_back(static_cast<uint32_t>(inst.dataCharExprRange.fst));
+            ret.push_back(static_cast<uint32_t>(inst.dataCharExprRange.lst));
+            break;
+        case InstType::CharExprITSTAJ:
+            ret.push_back(static_cast<uint32_t>(inst.dataITSTAJ.offset));
+            break;
+        case InstType::CharExprIFSFAJ:
+            ret.push_back(static_cast<uint32_t>(inst.dataIFSFAJ.offset));
+            break;
+        default:
+            break;
+        }
+    }
+    return ret;
+}
+
+// Decode the code point beginning at cur and return its length.
+// Ill-formed code units are treated as one code point each
+template<typename CS>
+size_t DecodeForward(const typename CS::CodeUnit *cur, const typename CS::CodeUnit *end,
+                     typename CS::CodePoint *cp)
+{
+    using CU = typename CS::CodeUnit;
+    using CP = typename CS::CodePoint;
+
+    if constexpr(CS::ASCIICompatible)
+    {
+        if(static_cast<CharsetAux::UnsignedCU<CU>>(*cur) < 0x80)
+        {
+            *cp = static_cast<CP>(*cur);
+            return 1;
+        }
+    }
+
+    size_t ret = CS::CheckedCU2CP(cur, end, cp);
+    if(!ret)
+    {
+        *cp = static_cast<CP>(*cur);
+        return 1;
+    }
+    return ret;
+}
+
+// Decode the code point ending at cur and return its beginning, which is never before beg
+template<typename CS>
+const typename CS::CodeUnit *DecodeBackward(const typename CS::CodeUnit *beg, const typename CS::CodeUnit *cur,
+                                            typename CS::CodePoint *cp)
+{
+    using CU = typename CS::CodeUnit;
+    using CP = typename CS::CodePoint;
+
+    if constexpr(CS::ASCIICompatible)
+    {
+        if(static_cast<CharsetAux::UnsignedCU<CU>>(cur[-1]) < 0x80)
+        {
+            *cp = static_cast<CP>(cur[-1]);
+            return cur - 1;
+        }
+    }
+
+    const CU *ret = CS::LastCodePoint(cur);
+    if(ret < beg || CS::CheckedCU2CP(ret, cur, cp) != static_cast<size_t>(cur - ret))
+    {
+        *cp = static_cast<CP>(cur[-1]);
+        return cur - 1;
+    }
+    return ret;
+}
+
+/*
+    Partition of code points into classes. Code points in the same class
+    are accepted by exactly the same conditions, so the DFA only needs one
+    transition per class.
+
+    All the builtin char classes (\d, \w, ...) only contain code points
+    below 256, so each of them gets its own interval and larger code points
+    are split by the singles/ranges appearing in the program. Intervals
+    accepted by the same conditions are then merged into one class.
+*/
+template<typename CP>
+class CharClassTable
+{
+    using UCP = std::make_unsigned_t<CP>;
+
+    static constexpr uint32_t LOW_CP_COUNT = 256;
+
+    uint32_t lowClass_[LOW_CP_COUNT] = { };
+    std::vector<uint32_t> highBeg_;   // Sorted beginnings of intervals above 255
+    std::vector<uint32_t> highClass_;
+
+    size_t condCount_ = 0;
+    uint32_t classCount_ = 0;
+    std::vector<uint8_t> accept_;     // accept_[cls * condCount_ + cond]
+
+    static void AddBound(std::vector<uint32_t> &bounds, uint64_t cp)
+    {
+        if(LOW_CP_COUNT <= cp && cp <= (std::numeric_limits<UCP>::max)())
+            bounds.push_back(static_cast<uint32_t>(cp));
+    }
+
+public:
+
+    CharClassTable() = default;
+
+    // conds: one consuming instruction for each distinct condition
+    CharClassTable(const Program<CP> &prog, const std::vector<uint32_t> &conds)
+        : condCount_(conds.size())
+    {
+        std::map<std::vector<uint8_t>, uint32_t> sig2Class;
+        auto classify = [&](CP rep)
+        {
+            std::vector<uint8_t> sig(conds.size());
+            for(size_t i = 0; i < conds.size(); ++i)
+                sig[i] = AcceptCodePoint(prog, conds[i], rep);
+            auto [it, inserted] = sig2Class.try_emplace(sig, classCount_);
+            if(inserted)
+            {
+                ++classCount_;
+                accept_.insert(accept_.end(), sig.begin(), sig.end());
+            }
+            return it->second;
+        };
+
+        for(uint32_t i = 0; i < LOW_CP_COUNT && i <= (std::numeric_limits<UCP>::max)(); ++i)
+            lowClass_[i] = classify(static_cast<CP>(i));
+
+        if constexpr(sizeof(CP) > 1)
+        {
+            std::vector<uint32_t> bounds = { LOW_CP_COUNT };
+            for(uint32_t pc : conds)
+            {
+                for(uint32_t i = pc, end = NextOfConsumingInst(prog, pc); i < end; ++i)
+                {
+                    auto &inst = prog.GetInst(i);
+                    if(inst.type == InstType::CharSingle || inst.type == InstType::CharExprSingle)
+                    {
+                        auto cp = static_cast<UCP>(inst.type == InstType::CharSingle ?
+                            inst.dataCharSingle.codePoint : inst.dataCharExprSingle.codePoint);
+                        AddBound(bounds, cp);
+                        AddBound(bounds, uint64_t(cp) + 1);
+                    }
+                    else if(inst.type == InstType::CharRange || inst.type == InstType::CharExprRange)
+                    {
+                        bool expr = inst.type == InstType::CharExprRange;
+                        auto fst = static_cast<UCP>(expr ? inst.dataCharExprRange.fst : inst.dataCharRange.fst);
+                        auto lst = static_cast<UCP>(expr ? inst.dataCharExprRange.lst : inst.dataCharRange.lst);
+                        AddBound(bounds, fst);
+                        AddBound(bounds, uint64_t(lst) + 1);
+                    }
+                }
+            }
+
+            std::sort(bounds.begin(), bounds.end());
+            bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+            for(uint32_t beg : bounds)
+            {
+                highBeg_.push_back(beg);
+                highClass_.push_back(classify(static_cast<CP>(beg)));
+            }
+        }
+    }
+
+    uint32_t ClassCount() const noexcept
+    {
+        return classCount_;
+    }
+
+    uint32_t ClassOf(CP cp) const noexcept
+    {
+        auto ucp = static_cast<UCP>(cp);
+        if(ucp < LOW_CP_COUNT)
+            return lowClass_[ucp];
+        auto it = std::upper_bound(highBeg_.begin(), highBeg_.end(), static_cast<uint32_t>(ucp));
+        return highClass_[it - highBeg_.begin() - 1];
+    }
+
+    bool Accept(uint32_t cls, uint32_t cond) const noexcept
+    {
+        AGZ_ASSERT(cls < classCount_ && cond < condCount_);
+        return accept_[cls * condCount_ + cond] != 0;
+    }
+};
+
+} // namespace AGZ::StrImpl::LazyDFA
+
+/**
+ * @endcond
+ */
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+#include "../PikeVM/Inst.h"
+#include "CharClass.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::LazyDFA {
+
+enum class EndMode
+{
+    Pending, // Keep End instructions in the closure, resolved when the input ends
+    Pass,    // Here is the end
+    Fail     // Here is not the end
+};
+
+/*
+    Epsilon closures of instructions, along with the working memory
+    needed to compute them.
+
+    Visited instructions are marked by a generation number, so that all
+    marks can be cleared in O(1) by starting a new generation. The marks
+    can also be used by the caller to record any set of indices smaller
+    than the program size.
+*/
+template<typename CP>
+class ClosureBuilder
+{
+    const Program<CP> *prog_;
+    std::vector<uint32_t> marks_;
+    uint32_t markGen_;
+    std::vector<uint32_t> stack_;
+
+public:
+
+    explicit ClosureBuilder(const Program<CP> &prog)
+        : prog_(&prog), marks_(prog.Size(), 0), markGen_(0)
+    {
+
+    }
+
+    void NewMarks()
+    {
+        if(++markGen_ == 0)
+        {
+            std::fill(marks_.begin(), marks_.end(), 0);
+            markGen_ = 1;
+        }
+    }
+
+    void Mark(uint32_t idx) noexcept
+    {
+        marks_[idx] = markGen_;
+    }
+
+    bool IsMarked(uint32_t idx) const noexcept
+    {
+        return marks_[idx] == markGen_;
+    }
+
+    // Append the leaves reachable from pc through epsilon instructions to out,
+    // in priority order. Leaves are consuming instructions, Match, and
+    // End when endMode is Pending. Instructions marked by the current
+    // generation are skipped.
+    void Add(std::vector<uint32_t> &out, uint32_t pc, bool atBegin, EndMode endMode)
+    {
+        stack_.clear();
+        stack_.push_back(pc);
+
+        while(!stack_.empty())
+        {
+            pc = stack_.back();
+            stack_.pop_back();
+
+            if(IsMarked(pc))
+                continue;
+            Mark(pc);
+
+            auto &inst = prog_->GetInst(pc);
+            switch(inst.type)
+            {
+            case InstType::Begin:
+                if(atBegin)
+                    stack_.push_back(pc + 1);
+                break;
+            case InstType::End:
+                if(endMode == EndMode::Pending)
+                    out.push_back(pc);
+                else if(endMode == EndMode::Pass)
+                    stack_.push_back(pc + 1);
+                break;
+            case InstType::Save:
+                stack_.push_back(pc + 1);
+                break;
+            case InstType::Alter:
+            {
+                auto dests = prog_->GetRelativeOffsetArray(pc);
+                for(uint32_t i = inst.dataAlter.count; i-- > 0;)
+                    stack_.push_back(pc + dests[i]);
+                break;
+            }
+            case InstType::Jump:
+                stack_.push_back(pc + inst.dataJump.offset);
+                break;
+            case InstType::Branch:
+                stack_.push_back(pc + inst.dataBranch.dest[1]);
+                stack_.push_back(pc + inst.dataBranch.dest[0]);
+                break;
+            default:
+                out.push_back(pc);
+                break;
+            }
+        }
+    }
+
+    // Leaves reachable from pc only
+    std::vector<uint32_t> Closure(uint32_t pc, bool atBegin, EndMode endMode)
+    {
+        std::vector<uint32_t> ret;
+        NewMarks();
+        Add(ret, pc, atBegin, endMode);
+        return ret;
+    }
+};
+
+/*
+    Consuming instructions reachable from the start of a program, indexed
+    densely, and the partition of code points by the conditions they test.
+*/
+template<typename CP>
+struct ConsumingInsts
+{
+    static constexpr uint32_t NONE = (std::numeric_limits<uint32_t>::max)();
+
+    std::vector<uint32_t> idx;  // Instruction index -> dense index, or NONE
+    std::vector<uint32_t> pc;
+    std::vector<uint32_t> next; // Instruction following the consuming one
+    std::vector<uint32_t> cond; // Index of the distinct condition tested
+
+    CharClassTable<CP> classes;
+
+    explicit ConsumingInsts(const Program<CP> &prog)
+    {
+        ClosureBuilder<CP> builder(prog);
+
+        idx.assign(prog.Size(), NONE);
+        auto discover = [&](uint32_t from)
+        {
+            for(uint32_t leaf : builder.Closure(from, true, EndMode::Pass))
+            {
+                if(IsConsumingInst(prog.GetInst(leaf).type) && idx[leaf] == NONE)
+                {
+                    idx[leaf] = static_cast<uint32_t>(pc.size());
+                    pc.push_back(leaf);
+                }
+            }
+        };
+
+        discover(0);
+        for(size_t i = 0; i < pc.size(); ++i)
+        {
+            next.push_back(NextOfConsumingInst(prog, pc[i]));
+            discover(next[i]);
+        }
+
+        // Deduplicate conditions and partition code points
+
+        std::map<std::vector<uint32_t>, uint32_t> key2Cond;
+        std::vector<uint32_t> conds;
+        for(uint32_t p : pc)
+        {
+            auto [it, inserted] = key2Cond.try_emplace(
+                ConditionKey(prog, p), static_cast<uint32_t>(conds.size()));
+            if(inserted)
+                conds.push_back(p);
+            cond.push_back(it->second);
+        }
+
+        classes = CharClassTable<CP>(prog, conds);
+    }
+
+    size_t Count() const noexcept
+    {
+        return pc.size();
+    }
+
+    // Whether the consuming instruction at pc accepts code points in class cls
+    bool Accept(uint32_t instIdx, uint32_t cls) const noexcept
+    {
+        return classes.Accept(cls, cond[idx[instIdx]]);
+    }
+};
+
+} // namespace AGZ::StrImpl::LazyDFA
+
+/**
+ * @endcond
+ */
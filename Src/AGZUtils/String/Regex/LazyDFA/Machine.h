@@ -0,0 +1,554 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+#include "../../String/String.h"
+#include "../PikeVM/Machine.h"
+#include "../PikeVM/ScratchPool.h"
+#include "CharClass.h"
+#include "Closure.h"
+#include "StateCache.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::LazyDFA {
+
+/*
+    Regex engine based on a lazily built DFA.
+
+    The program is generated by the PikeVM backend, and DFA states are
+    built from it on demand during matching. A forward DFA finds the end
+    of the match. It keeps instructions in priority order and drops the
+    ones after Match, so the result is the same as the one of PikeVM.
+    A reverse DFA then scans backwards from the end to find the beginning.
+    Save points are extracted by running PikeVM on the matched range only.
+
+    States are kept in a bounded cache. When it is filled up too quickly
+    the DFA gives up and the whole job is left to PikeVM.
+
+    The machine is not modified after construction. Caches are borrowed
+    from a pool by each call, so one machine can be used by multiple
+    threads simultaneously.
+*/
+template<typename CS>
+class Machine
+{
+public:
+
+    using CU = typename CS::CodeUnit;
+    using CP = typename CS::CodePoint;
+
+    using Interval = std::pair<size_t, size_t>;
+
+    // Memory budget of each of the forward/reverse state cache
+    static constexpr size_t STATE_CACHE_BYTES = 1 << 20;
+
+    explicit Machine(const StringView<CS> &regex)
+        : vm_(regex), prog_(vm_.GetProgram()),
+          slotCount_(vm_.GetSaveSlotCount()), cons_(prog_)
+    {
+        Initialize();
+    }
+
+    std::optional<std::vector<size_t>>
+        Match(const StringView<CS> &dst) const
+    {
+        if(!Filter().template MayMatch<true, true>(dst.Data(), dst.Data() + dst.Length()))
+            return std::nullopt;
+
+        auto cache = BorrowCache();
+        size_t end;
+        if(!ScanForward(*cache, dst, 0, 0, &end))
+            return vm_.Match(dst);
+        if(end == NPOS)
+            return std::nullopt;
+        return SaveSlots(dst, 0, end);
+    }
+
+    std::optional<std::pair<std::pair<size_t, size_t>,
+                            std::vector<size_t>>>
+        Search(const StringView<CS> &dst) const
+    {
+        return SearchFrom(dst, 0);
+    }
+
+    std::optional<std::pair<std::pair<size_t, size_t>,
+                  std::vector<size_t>>>
+        SearchFrom(const StringView<CS> &dst, size_t fromIdx) const
+    {
+        AGZ_ASSERT(fromIdx <= dst.Length());
+
+        const CU *data = dst.Data(), *dataEnd = data + dst.Length();
+        if(!Filter().template MayMatch<false, false>(data + fromIdx, dataEnd))
+            return std::nullopt;
+
+        // No match begins before the first occurrence of the required prefix
+        const CU *first = Filter().NextStart(data + fromIdx, dataEnd);
+        if(first == dataEnd && Filter().HasPrefix())
+            return std::nullopt;
+
+        auto cache = BorrowCache();
+        size_t beg, end;
+        if(!ScanForward(*cache, dst, SEED | CUT, first - data, &end))
+            return vm_.SearchFrom(dst, fromIdx);
+        if(end == NPOS)
+            return std::nullopt;
+        if(!ScanBackward(*cache, dst, end, fromIdx, &beg))
+            return vm_.SearchFrom(dst, fromIdx);
+        AGZ_ASSERT(beg != NPOS);
+        return std::make_pair(Interval{ beg, end }, SaveSlots(dst, beg, end));
+    }
+
+    std::optional<std::pair<std::pair<size_t, size_t>,
+                  std::vector<size_t>>>
+        SearchPrefix(const StringView<CS> &dst) const
+    {
+        if(!Filter().template MayMatch<true, false>(dst.Data(), dst.Data() + dst.Length()))
+            return std::nullopt;
+
+        auto cache = BorrowCache();
+        size_t end;
+        if(!ScanForward(*cache, dst, CUT, 0, &end))
+            return vm_.SearchPrefix(dst);
+        if(end == NPOS)
+            return std::nullopt;
+        return std::make_pair(Interval{ 0, end }, SaveSlots(dst, 0, end));
+    }
+
+    std::optional<std::pair<std::pair<size_t, size_t>,
+                  std::vector<size_t>>>
+        SearchSuffix(const StringView<CS> &dst) const
+    {
+        if(!Filter().template MayMatch<false, true>(dst.Data(), dst.Data() + dst.Length()))
+            return std::nullopt;
+
+        auto cache = BorrowCache();
+        size_t beg;
+        if(!ScanBackward(*cache, dst, dst.Length(), 0, &beg))
+            return vm_.SearchSuffix(dst);
+        if(beg == NPOS)
+            return std::nullopt;
+        return std::make_pair(Interval{ beg, dst.Length() },
+                              SaveSlots(dst, beg, dst.Length()));
+    }
+
+private:
+
+    static constexpr size_t NPOS = (std::numeric_limits<size_t>::max)();
+    static constexpr uint32_t NONE = ConsumingInsts<CP>::NONE;
+
+    static constexpr uint32_t DEAD    = StateCache::DEAD;
+    static constexpr uint32_t UNKNOWN = StateCache::UNKNOWN;
+
+    // Give up when the cache is filled up with less than this many code units scanned per state
+    static constexpr size_t MIN_CODE_UNITS_PER_STATE = 10;
+
+    // Flags of forward states
+    static constexpr uint32_t SEED  = 1; // Start a new thread at every position
+    static constexpr uint32_t CUT   = 2; // Leftmost-first: a match cuts off threads with lower priorities
+    static constexpr uint32_t MATCH = 4; // Match is reached at this position
+
+    // Added to the mode to get the slot of the forward start state not at the beginning
+    static constexpr uint32_t NOT_AT_BEGIN_SLOT = 4;
+
+    // Flags of reverse states
+    static constexpr uint32_t START          = 1; // A match can begin here
+    static constexpr uint32_t START_AT_BEGIN = 2; // A match can begin here if here is the beginning
+
+    // Contents of the initial reverse states: the end of a match
+    static constexpr uint32_t MATCH_TOKEN        = NONE - 1;
+    static constexpr uint32_t MATCH_AT_END_TOKEN = NONE;
+
+    PikeVM::Machine<CS> vm_;
+    const Program<CP> &prog_;
+    size_t slotCount_;
+
+    // Consuming instructions reachable from the start, indexed densely
+    ConsumingInsts<CP> cons_;
+    std::vector<std::vector<uint32_t>> consSucc_; // Consuming instructions reachable after this one
+    std::vector<uint8_t> consReachMatch_;
+    std::vector<uint8_t> consReachMatchAtEnd_;
+
+    // Consuming instructions reachable from the start, not at / at the beginning
+    std::vector<uint32_t> seed_, seedAtBegin_;
+    // Whether Match is reachable from the start, indexed by [atBegin][atEnd]
+    bool seedMatch_[2][2] = { };
+
+    // Working memory of the DFA, including the lazily built states.
+    // Each call borrows one from the pool, so states built by previous
+    // calls are reused while concurrent calls never share one
+    struct Cache
+    {
+        Cache(uint32_t classCount, const Program<CP> &prog)
+            : fwd(classCount, STATE_CACHE_BYTES),
+              bwd(classCount, STATE_CACHE_BYTES),
+              closure(prog)
+        {
+
+        }
+
+        StateCache fwd;
+        StateCache bwd;
+
+        ClosureBuilder<CP> closure;
+        std::vector<uint32_t> insts;
+    };
+
+    mutable PikeVM::ScratchPool<Cache> caches_;
+
+    const PikeVM::Prefilter<CS> &Filter() const noexcept
+    {
+        return vm_.GetPrefilter();
+    }
+
+    typename PikeVM::ScratchPool<Cache>::Guard BorrowCache() const
+    {
+        return caches_.Acquire([&]
+        {
+            return new Cache(cons_.classes.ClassCount(), prog_);
+        });
+    }
+
+    void Initialize()
+    {
+        ClosureBuilder<CP> builder(prog_);
+
+        // Reverse edges: a consuming instruction consumes a code point at
+        // position p >= 0, so the closure after it is never at the beginning
+
+        auto toDense = [&](const std::vector<uint32_t> &pcs, bool *reachMatch)
+        {
+            std::vector<uint32_t> ret;
+            *reachMatch = false;
+            for(uint32_t pc : pcs)
+            {
+                if(prog_.GetInst(pc).type == InstType::Match)
+                    *reachMatch = true;
+                else
+                    ret.push_back(cons_.idx[pc]);
+            }
+            return ret;
+        };
+
+        for(size_t i = 0; i < cons_.pc.size(); ++i)
+        {
+            bool reach;
+            consSucc_.push_back(toDense(builder.Closure(cons_.next[i], false, EndMode::Fail), &reach));
+            consReachMatch_.push_back(reach);
+            toDense(builder.Closure(cons_.next[i], false, EndMode::Pass), &reach);
+            consReachMatchAtEnd_.push_back(reach);
+        }
+
+        seed_        = toDense(builder.Closure(0, false, EndMode::Fail), &seedMatch_[0][0]);
+        seedAtBegin_ = toDense(builder.Closure(0, true,  EndMode::Fail), &seedMatch_[1][0]);
+        toDense(builder.Closure(0, false, EndMode::Pass), &seedMatch_[0][1]);
+        toDense(builder.Closure(0, true,  EndMode::Pass), &seedMatch_[1][1]);
+    }
+
+    std::vector<size_t> SaveSlots(const StringView<CS> &dst, size_t beg, size_t end) const
+    {
+        if(!slotCount_)
+            return { };
+        auto ret = vm_.MatchRange(dst, beg, end);
+        AGZ_ASSERT(ret.has_value());
+        return std::move(ret.value());
+    }
+
+    // ========================= Forward DFA =========================
+
+    // insts is ordered by priority
+    uint32_t MakeForwardState(Cache &cache, std::vector<uint32_t> &insts, uint32_t flags) const
+    {
+        auto match = std::find_if(insts.begin(), insts.end(), [&](uint32_t pc)
+        {
+            return prog_.GetInst(pc).type == InstType::Match;
+        });
+
+        if(match != insts.end())
+        {
+            flags |= MATCH;
+            if(flags & CUT)
+            {
+                insts.erase(match + 1, insts.end());
+                flags &= ~SEED;
+            }
+        }
+
+        if(insts.empty() && !(flags & SEED))
+            return DEAD;
+        return cache.fwd.Insert(insts, flags);
+    }
+
+    uint32_t StepForward(Cache &cache, uint32_t state, uint32_t cls) const
+    {
+        uint32_t flags = cache.fwd.GetFlags(state);
+
+        cache.closure.NewMarks();
+        cache.insts.clear();
+        for(uint32_t pc : cache.fwd.GetInsts(state))
+        {
+            InstType type = prog_.GetInst(pc).type;
+            if(type == InstType::Match)
+            {
+                if(flags & CUT)
+                    break;
+                continue;
+            }
+            if(type == InstType::End)
+                continue;
+
+            uint32_t c = cons_.idx[pc];
+            if(cons_.classes.Accept(cls, cons_.cond[c]))
+                cache.closure.Add(cache.insts, cons_.next[c], false, EndMode::Pending);
+        }
+
+        if(flags & SEED)
+            cache.closure.Add(cache.insts, 0, false, EndMode::Pending);
+
+        return MakeForwardState(cache, cache.insts, flags & (SEED | CUT));
+    }
+
+    uint32_t ForwardStartState(Cache &cache, uint32_t mode, bool atBegin) const
+    {
+        uint32_t &ret = cache.fwd.StartState(mode | (atBegin ? 0 : NOT_AT_BEGIN_SLOT));
+        if(ret == UNKNOWN)
+        {
+            cache.closure.NewMarks();
+            cache.insts.clear();
+            cache.closure.Add(cache.insts, 0, atBegin, EndMode::Pending);
+            ret = MakeForwardState(cache, cache.insts, mode);
+            if(ret == UNKNOWN)
+            {
+                cache.fwd.Clear();
+                return ForwardStartState(cache, mode, atBegin);
+            }
+        }
+        return ret;
+    }
+
+    // Whether Match is reached at the end of the input
+    bool FinalMatch(Cache &cache, uint32_t state, bool atBegin) const
+    {
+        cache.closure.NewMarks();
+        for(uint32_t pc : cache.fwd.GetInsts(state))
+        {
+            InstType type = prog_.GetInst(pc).type;
+            if(type == InstType::Match)
+                return true;
+            if(type == InstType::End)
+            {
+                cache.insts.clear();
+                cache.closure.Add(cache.insts, pc + 1, atBegin, EndMode::Pass);
+                for(uint32_t leaf : cache.insts)
+                {
+                    if(prog_.GetInst(leaf).type == InstType::Match)
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // ========================= Reverse DFA =========================
+
+    uint32_t MakeReverseState(Cache &cache, const std::vector<uint32_t> &insts, uint32_t flags) const
+    {
+        if(insts.empty())
+            return DEAD;
+        return cache.bwd.Insert(insts, flags);
+    }
+
+    uint32_t StepReverse(Cache &cache, uint32_t state, uint32_t cls) const
+    {
+        auto &insts = cache.bwd.GetInsts(state);
+        bool initial = insts.size() == 1 && insts[0] >= MATCH_TOKEN;
+        bool atEnd = initial && insts[0] == MATCH_AT_END_TOKEN;
+
+        cache.closure.NewMarks();
+        if(!initial)
+        {
+            for(uint32_t c : insts)
+                cache.closure.Mark(c);
+        }
+
+        cache.insts.clear();
+        for(uint32_t c = 0; c < cons_.pc.size(); ++c)
+        {
+            if(!cons_.classes.Accept(cls, cons_.cond[c]))
+                continue;
+
+            bool hit;
+            if(initial)
+                hit = atEnd ? consReachMatchAtEnd_[c] : consReachMatch_[c];
+            else
+            {
+                hit = std::any_of(consSucc_[c].begin(), consSucc_[c].end(),
+                                  [&](uint32_t s) { return cache.closure.IsMarked(s); });
+            }
+
+            if(hit)
+                cache.insts.push_back(c);
+        }
+
+        cache.closure.NewMarks();
+        for(uint32_t c : cache.insts)
+            cache.closure.Mark(c);
+        auto marked = [&](uint32_t c) { return cache.closure.IsMarked(c); };
+
+        uint32_t flags = 0;
+        if(std::any_of(seed_.begin(), seed_.end(), marked))
+            flags |= START;
+        if(std::any_of(seedAtBegin_.begin(), seedAtBegin_.end(), marked))
+            flags |= START_AT_BEGIN;
+
+        return MakeReverseState(cache, cache.insts, flags);
+    }
+
+    uint32_t ReverseStartState(Cache &cache, bool atEnd) const
+    {
+        uint32_t &ret = cache.bwd.StartState(atEnd);
+        if(ret == UNKNOWN)
+        {
+            uint32_t flags = (seedMatch_[0][atEnd] ? START : 0)
+                           | (seedMatch_[1][atEnd] ? START_AT_BEGIN : 0);
+            ret = MakeReverseState(cache, { atEnd ? MATCH_AT_END_TOKEN : MATCH_TOKEN }, flags);
+            if(ret == UNKNOWN)
+            {
+                cache.bwd.Clear();
+                return ReverseStartState(cache, atEnd);
+            }
+        }
+        return ret;
+    }
+
+    // ========================= Scanning =========================
+
+    // Compute the transition not in the cache yet. Return UNKNOWN if the DFA gives up
+    template<bool Forward>
+    uint32_t Transit(Cache &cache, uint32_t state, uint32_t cls, size_t pos, size_t &lastClearPos) const
+    {
+        StateCache &states = Forward ? cache.fwd : cache.bwd;
+        auto step = [&](uint32_t s)
+        {
+            if constexpr(Forward)
+                return StepForward(cache, s, cls);
+            else
+                return StepReverse(cache, s, cls);
+        };
+
+        uint32_t ret = step(state);
+        if(ret == UNKNOWN)
+        {
+            size_t dist = pos > lastClearPos ? pos - lastClearPos : lastClearPos - pos;
+            if(dist < MIN_CODE_UNITS_PER_STATE * states.GetStateCount())
+                return UNKNOWN;
+            lastClearPos = pos;
+
+            std::vector<uint32_t> insts = states.GetInsts(state);
+            uint32_t flags = states.GetFlags(state);
+            states.Clear();
+
+            state = states.Insert(insts, flags);
+            ret = step(state);
+            AGZ_ASSERT(state != UNKNOWN && ret != UNKNOWN);
+        }
+
+        states.SetNext(state, cls, ret);
+        return ret;
+    }
+
+    // Find the end of the match beginning at fromIdx (without SEED) or anywhere after it (with SEED).
+    // Without CUT, only a match ending at the end of dst is considered.
+    // Set *matchEnd to NPOS if there is no match. Return false if the DFA gives up
+    bool ScanForward(Cache &cache, const StringView<CS> &dst, uint32_t mode,
+                     size_t fromIdx, size_t *matchEnd) const
+    {
+        const CU *beg = dst.Data(), *end = beg + dst.Length(), *cur = beg + fromIdx;
+        size_t lastClearPos = fromIdx, ret = NPOS;
+
+        uint32_t state = ForwardStartState(cache, mode, cur == beg);
+        if((cache.fwd.GetFlags(state) & (MATCH | CUT)) == (MATCH | CUT))
+            ret = fromIdx;
+
+        while(cur != end && state != DEAD)
+        {
+            CP cp;
+            size_t n = DecodeForward<CS>(cur, end, &cp);
+            uint32_t cls = cons_.classes.ClassOf(cp);
+
+            uint32_t next = cache.fwd.Next(state, cls);
+            if(next == UNKNOWN)
+            {
+                next = Transit<true>(cache, state, cls, cur - beg, lastClearPos);
+                if(next == UNKNOWN)
+                    return false;
+            }
+
+            state = next;
+            cur += n;
+            if((cache.fwd.GetFlags(state) & (MATCH | CUT)) == (MATCH | CUT))
+                ret = cur - beg;
+        }
+
+        if(cur == end && state != DEAD && FinalMatch(cache, state, beg == end))
+            ret = dst.Length();
+
+        *matchEnd = ret;
+        return true;
+    }
+
+    // Find the smallest beg >= minIdx such that dst[beg, end) matches.
+    // Set *matchBeg to NPOS if there is no such beg. Return false if the DFA gives up
+    bool ScanBackward(Cache &cache, const StringView<CS> &dst, size_t endIdx,
+                      size_t minIdx, size_t *matchBeg) const
+    {
+        AGZ_ASSERT(minIdx <= endIdx);
+        const CU *beg = dst.Data(), *cur = beg + endIdx, *stop = beg + minIdx;
+        size_t lastClearPos = endIdx, ret = NPOS;
+
+        auto canStart = [&](uint32_t s)
+        {
+            return (cache.bwd.GetFlags(s) & (cur == beg ? START_AT_BEGIN : START)) != 0;
+        };
+
+        uint32_t state = ReverseStartState(cache, endIdx == dst.Length());
+        if(canStart(state))
+            ret = endIdx;
+
+        while(cur > stop && state != DEAD)
+        {
+            CP cp;
+            const CU *prev = DecodeBackward<CS>(beg, cur, &cp);
+            uint32_t cls = cons_.classes.ClassOf(cp);
+
+            uint32_t next = cache.bwd.Next(state, cls);
+            if(next == UNKNOWN)
+            {
+                next = Transit<false>(cache, state, cls, cur - beg, lastClearPos);
+                if(next == UNKNOWN)
+                    return false;
+            }
+
+            state = next;
+            cur = prev;
+            if(cur >= stop && canStart(state))
+                ret = cur - beg;
+        }
+
+        *matchBeg = ret;
+        return true;
+    }
+};
+
+} // namespace AGZ::StrImpl::LazyDFA
+
+/**
+ * @endcond
+ */
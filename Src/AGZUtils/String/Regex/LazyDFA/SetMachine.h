@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+#include "../../../Misc/Exception.h"
+#include "../../String/String.h"
+#include "../PikeVM/Backend.h"
+#include "../PikeVM/ScratchPool.h"
+#include "../PikeVM/Syntax.h"
+#include "CharClass.h"
+#include "Closure.h"
+#include "StateCache.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::LazyDFA {
+
+/*
+    Engine finding which patterns of a set match the input, in one scan.
+
+    All patterns are compiled into one program, where each of them ends
+    with a Match tagged by its index. Unlike Machine, there is no priority
+    between threads: a DFA state is the set of instructions alive at the
+    current position, so all patterns are simulated simultaneously and
+    every Match reached is recorded. Instructions of a state are sorted,
+    which lets more positions share the same state.
+
+    States are built lazily in a bounded cache. When it is filled up too
+    quickly, the remaining input is scanned by computing instruction sets
+    directly without caching them, which is an NFA simulation taking time
+    linear in the input length.
+
+    The machine is not modified after construction, and can be used by
+    multiple threads simultaneously.
+*/
+template<typename CS>
+class SetMachine
+{
+public:
+
+    using CU = typename CS::CodeUnit;
+    using CP = typename CS::CodePoint;
+
+    // Memory budget of the state cache
+    static constexpr size_t STATE_CACHE_BYTES = 4 << 20;
+
+    explicit SetMachine(const std::vector<StringView<CS>> &patterns)
+        : count_(patterns.size()), prog_(Compile(patterns)), cons_(prog_)
+    {
+
+    }
+
+    size_t PatternCount() const noexcept
+    {
+        return count_;
+    }
+
+    // Indices of patterns matching dst as a whole, in ascending order
+    std::vector<size_t> Match(const StringView<CS> &dst) const
+    {
+        return Run(dst, 0);
+    }
+
+    // Indices of patterns matching any substring of dst, in ascending order
+    std::vector<size_t> Search(const StringView<CS> &dst) const
+    {
+        return Run(dst, SEED);
+    }
+
+private:
+
+    static constexpr uint32_t DEAD    = StateCache::DEAD;
+    static constexpr uint32_t UNKNOWN = StateCache::UNKNOWN;
+
+    // Give up caching when the cache is filled up with less than this many code units scanned per state
+    static constexpr size_t MIN_CODE_UNITS_PER_STATE = 10;
+
+    // Flags of states
+    static constexpr uint32_t SEED  = 1; // Start a new thread at every position
+    static constexpr uint32_t MATCH = 2; // Some Match is reached at this position
+
+    struct Cache
+    {
+        Cache(uint32_t classCount, const Program<CP> &prog)
+            : fwd(classCount, STATE_CACHE_BYTES), closure(prog)
+        {
+
+        }
+
+        StateCache fwd;
+
+        ClosureBuilder<CP> closure;
+        std::vector<uint32_t> insts;
+        std::vector<uint32_t> leaves;
+    };
+
+    // Patterns matched so far by one call
+    struct Result
+    {
+        explicit Result(size_t count)
+            : matched(count, 0), remaining(count)
+        {
+
+        }
+
+        std::vector<uint8_t> matched;
+        size_t remaining;
+    };
+
+    size_t count_;
+    Program<CP> prog_;
+    ConsumingInsts<CP> cons_;
+
+    mutable PikeVM::ScratchPool<Cache> caches_;
+
+    static Program<CP> Compile(const std::vector<StringView<CS>> &patterns)
+    {
+        if(patterns.empty())
+            throw ArgumentException("Empty regular expression set");
+
+        // ASTs are allocated by the parser and freed along with it
+        PikeVM::Parser<CS> parser;
+        std::vector<const PikeVM::ASTNode<CP>*> asts;
+        for(auto &pattern : patterns)
+            asts.push_back(parser.Parse(pattern));
+
+        size_t slotCount;
+        return PikeVM::Backend<CS>().GenerateSet(asts, &slotCount);
+    }
+
+    typename PikeVM::ScratchPool<Cache>::Guard BorrowCache() const
+    {
+        return caches_.Acquire([&]
+        {
+            return new Cache(cons_.classes.ClassCount(), prog_);
+        });
+    }
+
+    void Collect(const std::vector<uint32_t> &insts, Result &result) const
+    {
+        for(uint32_t pc : insts)
+        {
+            auto &inst = prog_.GetInst(pc);
+            if(inst.type == InstType::Match && !result.matched[inst.dataMatch.tag])
+            {
+                result.matched[inst.dataMatch.tag] = 1;
+                --result.remaining;
+            }
+        }
+    }
+
+    // Record the Match reached at the end of the input
+    void CollectFinal(Cache &cache, const std::vector<uint32_t> &insts,
+                      bool atBegin, Result &result) const
+    {
+        cache.closure.NewMarks();
+        cache.leaves.clear();
+        for(uint32_t pc : insts)
+        {
+            auto type = prog_.GetInst(pc).type;
+            if(type == InstType::Match)
+                cache.leaves.push_back(pc);
+            else if(type == InstType::End)
+                cache.closure.Add(cache.leaves, pc + 1, atBegin, EndMode::Pass);
+        }
+        Collect(cache.leaves, result);
+    }
+
+    // Instructions alive after consuming a code point in class cls
+    void Advance(Cache &cache, const std::vector<uint32_t> &insts, uint32_t flags,
+                 uint32_t cls, std::vector<uint32_t> &out) const
+    {
+        cache.closure.NewMarks();
+        out.clear();
+        for(uint32_t pc : insts)
+        {
+            auto type = prog_.GetInst(pc).type;
+            if(type == InstType::Match || type == InstType::End)
+                continue;
+            if(cons_.Accept(pc, cls))
+                cache.closure.Add(out, cons_.next[cons_.idx[pc]], false, EndMode::Pending);
+        }
+
+        if(flags & SEED)
+            cache.closure.Add(out, 0, false, EndMode::Pending);
+    }
+
+    uint32_t MakeState(Cache &cache, std::vector<uint32_t> &insts, uint32_t flags) const
+    {
+        std::sort(insts.begin(), insts.end());
+        if(std::any_of(insts.begin(), insts.end(), [&](uint32_t pc)
+        {
+            return prog_.GetInst(pc).type == InstType::Match;
+        }))
+        {
+            flags |= MATCH;
+        }
+
+        if(insts.empty() && !(flags & SEED))
+            return DEAD;
+        return cache.fwd.Insert(insts, flags);
+    }
+
+    uint32_t Step(Cache &cache, uint32_t state, uint32_t cls) const
+    {
+        uint32_t flags = cache.fwd.GetFlags(state);
+        Advance(cache, cache.fwd.GetInsts(state), flags, cls, cache.insts);
+        return MakeState(cache, cache.insts, flags & SEED);
+    }
+
+    uint32_t StartState(Cache &cache, uint32_t mode) const
+    {
+        uint32_t &ret = cache.fwd.StartState(mode);
+        if(ret == UNKNOWN)
+        {
+            cache.closure.NewMarks();
+            cache.insts.clear();
+            cache.closure.Add(cache.insts, 0, true, EndMode::Pending);
+            ret = MakeState(cache, cache.insts, mode);
+            if(ret == UNKNOWN)
+            {
+                cache.fwd.Clear();
+                return StartState(cache, mode);
+            }
+        }
+        return ret;
+    }
+
+    // Compute the transition not in the cache yet. Return UNKNOWN if the DFA gives up
+    uint32_t Transit(Cache &cache, uint32_t state, uint32_t cls, size_t pos, size_t &lastClearPos) const
+    {
+        uint32_t ret = Step(cache, state, cls);
+        if(ret == UNKNOWN)
+        {
+            if(pos - lastClearPos < MIN_CODE_UNITS_PER_STATE * cache.fwd.GetStateCount())
+                return UNKNOWN;
+            lastClearPos = pos;
+
+            std::vector<uint32_t> insts = cache.fwd.GetInsts(state);
+            uint32_t flags = cache.fwd.GetFlags(state);
+            cache.fwd.Clear();
+
+            state = cache.fwd.Insert(insts, flags);
+            ret = Step(cache, state, cls);
+            AGZ_ASSERT(state != UNKNOWN && ret != UNKNOWN);
+        }
+
+        cache.fwd.SetNext(state, cls, ret);
+        return ret;
+    }
+
+    // Scan [cur, end) from the given instructions without caching states
+    void RunUncached(Cache &cache, std::vector<uint32_t> insts, uint32_t mode,
+                     const CU *beg, const CU *cur, const CU *end, Result &result) const
+    {
+        std::vector<uint32_t> next;
+        while(cur != end && (!insts.empty() || (mode & SEED)) && result.remaining)
+        {
+            CP cp;
+            cur += DecodeForward<CS>(cur, end, &cp);
+            Advance(cache, insts, mode, cons_.classes.ClassOf(cp), next);
+            insts.swap(next);
+
+            if(mode & SEED)
+                Collect(insts, result);
+        }
+
+        if(cur == end && result.remaining)
+            CollectFinal(cache, insts, beg == end, result);
+    }
+
+    std::vector<size_t> Run(const StringView<CS> &dst, uint32_t mode) const
+    {
+        Result result(count_);
+        auto cache = BorrowCache();
+
+        const CU *beg = dst.Data(), *end = beg + dst.Length(), *cur = beg;
+        size_t lastClearPos = 0;
+
+        // Without SEED, only Match reached at the end counts
+        uint32_t state = StartState(*cache, mode);
+        if(mode & SEED)
+            Collect(cache->fwd.GetInsts(state), result);
+
+        while(cur != end && state != DEAD && result.remaining)
+        {
+            CP cp;
+            size_t n = DecodeForward<CS>(cur, end, &cp);
+            uint32_t cls = cons_.classes.ClassOf(cp);
+
+            uint32_t next = cache->fwd.Next(state, cls);
+            if(next == UNKNOWN)
+            {
+                next = Transit(*cache, state, cls, cur - beg, lastClearPos);
+                if(next == UNKNOWN)
+                {
+                    RunUncached(*cache, cache->fwd.GetInsts(state), mode, beg, cur, end, result);
+                    return Indices(result);
+                }
+            }
+
+            state = next;
+            cur += n;
+            if((mode & SEED) && (cache->fwd.GetFlags(state) & MATCH))
+                Collect(cache->fwd.GetInsts(state), result);
+        }
+
+        if(cur == end && state != DEAD && result.remaining)
+            CollectFinal(*cache, cache->fwd.GetInsts(state), beg == end, result);
+
+        return Indices(result);
+    }
+
+    static std::vector<size_t> Indices(const Result &result)
+    {
+        std::vector<size_t> ret;
+        for(size_t i = 0; i < result.matched.size(); ++i)
+        {
+            if(result.matched[i])
+                ret.push_back(i);
+        }
+        return ret;
+    }
+};
+
+} // namespace AGZ::StrImpl::LazyDFA
+
+/**
+ * @endcond
+ */
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::LazyDFA {
+
+/*
+    Cache of lazily built DFA states and their transitions.
+
+    A state is identified by a list of instruction indices plus some flags
+    whose meanings are defined by the user. Memory used by the cache is
+    bounded: Insert fails once the budget is exceeded, after which the user
+    is expected to Clear the cache and continue from scratch.
+*/
+class StateCache
+{
+public:
+
+    static constexpr uint32_t DEAD    = 0;
+    static constexpr uint32_t UNKNOWN = (std::numeric_limits<uint32_t>::max)();
+
+    static constexpr size_t START_STATE_SLOTS = 8;
+
+    StateCache() = default;
+
+    StateCache(uint32_t classCount, size_t memBudget)
+        : classCount_(classCount), memBudget_(memBudget)
+    {
+        Clear();
+    }
+
+    // Destination of the transition from state on a code point in class cls
+    uint32_t Next(uint32_t state, uint32_t cls) const noexcept
+    {
+        AGZ_ASSERT(state < flags_.size() && cls < classCount_);
+        return trans_[state * classCount_ + cls];
+    }
+
+    void SetNext(uint32_t state, uint32_t cls, uint32_t dst) noexcept
+    {
+        AGZ_ASSERT(state < flags_.size() && cls < classCount_);
+        trans_[state * classCount_ + cls] = dst;
+    }
+
+    const std::vector<uint32_t> &GetInsts(uint32_t state) const noexcept
+    {
+        AGZ_ASSERT(state < insts_.size());
+        return insts_[state];
+    }
+
+    uint32_t GetFlags(uint32_t state) const noexcept
+    {
+        AGZ_ASSERT(state < flags_.size());
+        return flags_[state];
+    }
+
+    size_t GetStateCount() const noexcept
+    {
+        return flags_.size();
+    }
+
+    // User-defined slots for caching start states, reset to UNKNOWN by Clear
+    uint32_t &StartState(size_t slot) noexcept
+    {
+        AGZ_ASSERT(slot < START_STATE_SLOTS);
+        return starts_[slot];
+    }
+
+    // Find or create the state. Return UNKNOWN if the cache is full
+    uint32_t Insert(const std::vector<uint32_t> &insts, uint32_t flags)
+    {
+        key_.assign(insts.begin(), insts.end());
+        key_.push_back(flags);
+
+        auto it = ids_.find(key_);
+        if(it != ids_.end())
+            return it->second;
+
+        // Always leave room for the state being stepped from and its successor
+        size_t mem = StateMemory(insts.size());
+        if(flags_.size() > 2 && memUsed_ + mem > memBudget_)
+            return UNKNOWN;
+        memUsed_ += mem;
+
+        auto ret = static_cast<uint32_t>(flags_.size());
+        insts_.push_back(insts);
+        flags_.push_back(flags);
+        trans_.resize(trans_.size() + classCount_, UNKNOWN);
+        ids_.emplace(key_, ret);
+        return ret;
+    }
+
+    // Remove all states except the dead one
+    void Clear()
+    {
+        insts_.clear();
+        flags_.clear();
+        trans_.clear();
+        ids_.clear();
+        memUsed_ = 0;
+        for(auto &s : starts_)
+            s = UNKNOWN;
+
+        // The dead state has no instruction and no flag,
+        // and all of its transitions lead to itself
+        Insert({ }, 0);
+        for(uint32_t i = 0; i < classCount_; ++i)
+            SetNext(DEAD, i, DEAD);
+    }
+
+private:
+
+    struct KeyHash
+    {
+        size_t operator()(const std::vector<uint32_t> &key) const noexcept
+        {
+            size_t ret = key.size();
+            for(uint32_t v : key)
+                ret = CombineHash(ret, v);
+            return ret;
+        }
+    };
+
+    size_t StateMemory(size_t instCount) const noexcept
+    {
+        // Transition row, instruction list (stored twice) and bookkeeping
+        return classCount_ * sizeof(uint32_t) + 2 * (instCount + 1) * sizeof(uint32_t) + 96;
+    }
+
+    uint32_t classCount_ = 0;
+    size_t memBudget_ = 0;
+    size_t memUsed_ = 0;
+
+    std::vector<std::vector<uint32_t>> insts_;
+    std::vector<uint32_t> flags_;
+    std::vector<uint32_t> trans_;
+    std::unordered_map<std::vector<uint32_t>, uint32_t, KeyHash> ids_;
+    uint32_t starts_[START_STATE_SLOTS] = { };
+
+    std::vector<uint32_t> key_;
+};
+
+} // namespace AGZ::StrImpl::LazyDFA
+
+/**
+ * @endcond
+ */
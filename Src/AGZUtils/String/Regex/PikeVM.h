@@ -2,5 +2,7 @@
 
 #include "PikeVM/Backend.h"
 #include "PikeVM/Inst.h"
+#include "PikeVM/Literal.h"
+#include "PikeVM/ScratchPool.h"
 #include "PikeVM/Syntax.h"
 #include "PikeVM/Machine.h"
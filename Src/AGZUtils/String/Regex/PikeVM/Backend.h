@@ -1,6 +1,7 @@
 #pragma once
 
 #include <type_traits>
+#include <vector>
 
 #include "../../../Misc/Common.h"
 #include "../../../Misc/Exception.h"
@@ -72,6 +73,12 @@ namespace AGZ::StrImpl::PikeVM {
 
     !A => Inst(A)
           bool_not
+
+    Set of patterns P0, P1, ..., P_{n-1} =>
+            Alter(L0, L1, ..., L_{n-1})
+        L0  Inst(P0) -> Match(0)
+        L1  Inst(P1) -> Match(1)
+            ...
 */
 
 constexpr size_t INST_REL_OFFSET_CAPACITY = sizeof(Inst<char32_t>) / sizeof(int32_t);
@@ -216,6 +223,12 @@ public:
         return insts_[idx];
     }
 
+    const Inst<CP> &GetInst(size_t idx) const
+    {
+        AGZ_ASSERT(idx < instCount_);
+        return insts_[idx];
+    }
+
     const int32_t *GetRelativeOffsetArray(size_t instIdx) const
     {
         AGZ_ASSERT(instIdx + 1 < Size());
@@ -233,22 +246,6 @@ public:
         AGZ_ASSERT(Available() && Size() < Capacity());
         return Size();
     }
-
-    void ReinitLastSteps()
-    {
-        AGZ_ASSERT(Full());
-        for(uint32_t i = 0; i < instCount_; ++i)
-        {
-            if(insts_[i].type != InstType::Alter)
-                insts_[i].lastStep = (std::numeric_limits<uint32_t>::max)();
-            else
-            {
-                insts_[i].lastStep = (std::numeric_limits<uint32_t>::max)();
-                i += (insts_[i].dataAlter.count / INST_REL_OFFSET_CAPACITY)
-                   + (insts_[i].dataAlter.count / INST_REL_OFFSET_CAPACITY != 0);
-            }
-        }
-    }
 };
 
 template<typename CS>
@@ -280,6 +277,7 @@ public:
 
         auto bps = GenerateImpl(ast);
         auto match = prog_->Emit(NewInst(InstType::Match));
+        match->dataMatch.tag = 0;
         FillBP(bps, prog_->GetInstIndex(match));
 
         AGZ_ASSERT(prog_->Full());
@@ -288,6 +286,47 @@ public:
         return std::move(prog);
     }
 
+    // Compile a set of patterns into one program. Each pattern ends with
+    // a Match tagged by its index in asts. A null ast matches the empty string
+    Program<CP> GenerateSet(const std::vector<const ASTNode<CP>*> &asts,
+                            size_t *saveSlotCount)
+    {
+        AGZ_ASSERT(!asts.empty() && saveSlotCount);
+        AGZ_ASSERT(!prog_ && !saveSlotCount_);
+        AGZ_ASSERT(!inCharExpr_ && canSave_);
+
+        auto count = static_cast<uint32_t>(asts.size());
+        uint32_t instCount = AlterSize(count);
+        for(auto ast : asts)
+            instCount += (ast ? CountInst(ast) : 0) + 1;
+
+        Program<CP> prog(instCount);
+        prog_ = &prog;
+
+        auto alter = prog_->Emit(NewInst(InstType::Alter));
+        alter->dataAlter.count = count;
+        auto alterIdx = prog_->GetInstIndex(alter);
+        for(uint32_t i = 0; i < count; ++i)
+            prog_->EmitRelativeOffset();
+        auto alterDests = prog_->GetRelativeOffsetArray(alterIdx);
+
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            alterDests[i] = ComputeOffset(alterIdx, prog_->GetNextInstIndex());
+            BP bps;
+            if(asts[i])
+                bps = GenerateImpl(asts[i]);
+            auto match = prog_->Emit(NewInst(InstType::Match));
+            match->dataMatch.tag = i;
+            FillBP(bps, prog_->GetInstIndex(match));
+        }
+
+        AGZ_ASSERT(prog_->Full());
+
+        *saveSlotCount = saveSlotCount_;
+        return prog;
+    }
+
 private:
 
     Program<CP> *prog_ = nullptr;
@@ -21,7 +21,7 @@ enum class InstType : uint32_t
     Jump,               // Unconditioned jump
     Branch,             // Split to two threads
 
-    Match,              // Succeed
+    Match,              // Succeed, tagged with the index of the pattern in a set
 
     CharSingle,         // Specified character
     CharAny,            // Any character
@@ -73,13 +73,12 @@ union Inst
             struct { CP fst, lst;       } dataCharExprRange;
             struct { uint32_t slot;     } dataSave;
             struct { uint32_t count;    } dataAlter;
+            struct { uint32_t tag;      } dataMatch;
             struct { int32_t offset;    } dataJump;
             struct { int32_t dest[2];   } dataBranch;
             struct { int32_t offset;    } dataITSTAJ;
             struct { int32_t offset;    } dataIFSFAJ;
         };
-
-        uint32_t lastStep;
     };
 
     int32_t instArrUnit[4];
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+#include "../../String/StrAlgo.h"
+#include "Syntax.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::PikeVM {
+
+/*
+    Literals that every match of a regex must contain, extracted from the
+    AST. They are used to reject inputs and skip positions with a plain
+    substring search before running the VM.
+
+    Zero-width nodes (^, $ and save points) are transparent. Alternations
+    only keep what their branches have in common, and nodes that may
+    match the empty string require nothing.
+*/
+template<typename CS>
+class Prefilter
+{
+public:
+
+    using CU = typename CS::CodeUnit;
+    using CP = typename CS::CodePoint;
+
+    // Longer literals are truncated, which keeps them required
+    static constexpr size_t MAX_LITERAL_LENGTH = 64;
+
+    Prefilter() = default;
+
+    explicit Prefilter(const ASTNode<CP> *ast)
+    {
+        Info info = Analyze(ast);
+        prefix_ = Encode(info.prefix);
+        suffix_ = Encode(info.suffix);
+        inner_  = Encode(info.inner);
+
+        // The prefix and the suffix are checked anyway
+        if(inner_ == prefix_ || inner_ == suffix_)
+            inner_.clear();
+
+        BuildSearchers();
+    }
+
+    // Searchers point into the literal vectors and are rebuilt for the copies
+
+    Prefilter(const Prefilter &copyFrom)
+        : prefix_(copyFrom.prefix_), suffix_(copyFrom.suffix_), inner_(copyFrom.inner_)
+    {
+        BuildSearchers();
+    }
+
+    Prefilter(Prefilter &&moveFrom) noexcept
+        : prefix_(std::move(moveFrom.prefix_)),
+          suffix_(std::move(moveFrom.suffix_)),
+          inner_(std::move(moveFrom.inner_))
+    {
+        BuildSearchers();
+        moveFrom.BuildSearchers();
+    }
+
+    Prefilter &operator=(const Prefilter &copyFrom)
+    {
+        if(this != &copyFrom)
+        {
+            prefix_ = copyFrom.prefix_;
+            suffix_ = copyFrom.suffix_;
+            inner_  = copyFrom.inner_;
+            BuildSearchers();
+        }
+        return *this;
+    }
+
+    Prefilter &operator=(Prefilter &&moveFrom) noexcept
+    {
+        if(this != &moveFrom)
+        {
+            prefix_ = std::move(moveFrom.prefix_);
+            suffix_ = std::move(moveFrom.suffix_);
+            inner_  = std::move(moveFrom.inner_);
+            BuildSearchers();
+            moveFrom.BuildSearchers();
+        }
+        return *this;
+    }
+
+    bool HasPrefix() const noexcept
+    {
+        return !prefix_.empty();
+    }
+
+    // Whether [beg, end) may contain a match.
+    // With AnchorBegin/AnchorEnd, the match must begin/end at beg/end
+    template<bool AnchorBegin, bool AnchorEnd>
+    bool MayMatch(const CU *beg, const CU *end) const
+    {
+        size_t len = static_cast<size_t>(end - beg);
+
+        if constexpr(AnchorBegin)
+        {
+            if(len < prefix_.size() || !std::equal(prefix_.begin(), prefix_.end(), beg))
+                return false;
+        }
+
+        if constexpr(AnchorEnd)
+        {
+            if(len < suffix_.size() || !std::equal(suffix_.begin(), suffix_.end(), end - suffix_.size()))
+                return false;
+        }
+
+        return inner_.empty() || innerSearcher_.Find(beg, end) != end;
+    }
+
+    // The first position in [beg, end) where a match may begin, or end if there is none
+    const CU *NextStart(const CU *beg, const CU *end) const
+    {
+        return prefixSearcher_.Find(beg, end);
+    }
+
+private:
+
+    struct Info
+    {
+        bool exact = false; // The node matches prefix (== suffix == inner) only
+        std::vector<CP> prefix, suffix, inner;
+    };
+
+    static Info Exact(std::vector<CP> &&str)
+    {
+        Info ret;
+        ret.exact  = true;
+        ret.prefix = str;
+        ret.suffix = str;
+        ret.inner  = std::move(str);
+        return ret;
+    }
+
+    static std::vector<CP> Join(const std::vector<CP> &a, const std::vector<CP> &b)
+    {
+        std::vector<CP> ret(a);
+        ret.insert(ret.end(), b.begin(), b.end());
+        return ret;
+    }
+
+    static void KeepLonger(std::vector<CP> &dst, const std::vector<CP> &src)
+    {
+        if(src.size() > dst.size())
+            dst = src;
+    }
+
+    static void Truncate(Info &info)
+    {
+        if(info.prefix.size() > MAX_LITERAL_LENGTH)
+        {
+            info.exact = false;
+            info.prefix.resize(MAX_LITERAL_LENGTH);
+        }
+        if(info.suffix.size() > MAX_LITERAL_LENGTH)
+            info.suffix.erase(info.suffix.begin(), info.suffix.end() - MAX_LITERAL_LENGTH);
+        if(info.inner.size() > MAX_LITERAL_LENGTH)
+            info.inner.resize(MAX_LITERAL_LENGTH);
+    }
+
+    static Info Cat(const Info &a, const Info &b)
+    {
+        if(a.exact && b.exact)
+            return Exact(Join(a.prefix, b.prefix));
+
+        Info ret;
+        ret.prefix = a.exact ? Join(a.prefix, b.prefix) : a.prefix;
+        ret.suffix = b.exact ? Join(a.suffix, b.suffix) : b.suffix;
+
+        ret.inner = Join(a.suffix, b.prefix);
+        KeepLonger(ret.inner, a.inner);
+        KeepLonger(ret.inner, b.inner);
+        KeepLonger(ret.inner, ret.prefix);
+        KeepLonger(ret.inner, ret.suffix);
+        return ret;
+    }
+
+    static Info Or(const Info &a, const Info &b)
+    {
+        if(a.exact && b.exact && a.prefix == b.prefix)
+            return a;
+
+        Info ret;
+        auto pre = std::mismatch(a.prefix.begin(), a.prefix.end(), b.prefix.begin(), b.prefix.end());
+        ret.prefix.assign(a.prefix.begin(), pre.first);
+        auto suf = std::mismatch(a.suffix.rbegin(), a.suffix.rend(), b.suffix.rbegin(), b.suffix.rend());
+        ret.suffix.assign(suf.first.base(), a.suffix.end());
+
+        ret.inner = a.inner == b.inner ? a.inner : std::vector<CP>();
+        KeepLonger(ret.inner, ret.prefix);
+        KeepLonger(ret.inner, ret.suffix);
+        return ret;
+    }
+
+    // At least one occurrence of the node
+    static Info OneOrMore(const Info &sub)
+    {
+        Info ret(sub);
+        ret.exact = false;
+        return ret;
+    }
+
+    static Info Analyze(const ASTNode<CP> *node)
+    {
+        if(!node)
+            return Exact({ });
+
+        Info ret;
+        switch(node->type)
+        {
+        case ASTType::Begin:
+        case ASTType::End:
+        case ASTType::Save:
+            return Exact({ });
+
+        case ASTType::CharSingle:
+            return Exact({ node->dataCharSingle.codePoint });
+
+        case ASTType::Cat:
+            ret = Cat(Analyze(node->dataCat.dest[0]), Analyze(node->dataCat.dest[1]));
+            break;
+
+        case ASTType::Or:
+            ret = Or(Analyze(node->dataOr.dest[0]), Analyze(node->dataOr.dest[1]));
+            break;
+
+        case ASTType::Plus:
+            ret = OneOrMore(Analyze(node->dataPlus.dest));
+            break;
+
+        case ASTType::Repeat:
+        {
+            if(!node->dataRepeat.fst)
+                break;
+            Info sub = Analyze(node->dataRepeat.dest);
+            if(sub.exact && node->dataRepeat.fst == node->dataRepeat.lst &&
+               sub.prefix.size() * node->dataRepeat.fst <= MAX_LITERAL_LENGTH)
+            {
+                ret = sub;
+                for(uint32_t i = 1; i < node->dataRepeat.fst; ++i)
+                    ret = Cat(ret, sub);
+            }
+            else
+                ret = OneOrMore(sub);
+            break;
+        }
+
+        default:
+            // Star, Ques and char classes
+            break;
+        }
+
+        Truncate(ret);
+        return ret;
+    }
+
+    static std::vector<CU> Encode(const std::vector<CP> &cps)
+    {
+        std::vector<CU> ret;
+        CU buf[CS::MaxCUInCP];
+        for(CP cp : cps)
+        {
+            size_t n = CS::CP2CU(cp, buf);
+            ret.insert(ret.end(), buf, buf + n);
+        }
+        return ret;
+    }
+
+    static StrAlgo::Searcher<CU> MakeSearcher(const std::vector<CU> &lit) noexcept
+    {
+        return StrAlgo::Searcher<CU>(lit.data(), lit.data() + lit.size());
+    }
+
+    void BuildSearchers() noexcept
+    {
+        prefixSearcher_ = MakeSearcher(prefix_);
+        innerSearcher_  = MakeSearcher(inner_);
+    }
+
+    std::vector<CU> prefix_;
+    std::vector<CU> suffix_;
+    std::vector<CU> inner_;
+
+    // Built once, as NextStart may be called once per candidate position.
+    // The suffix is only compared at a fixed position and needs no searcher
+    StrAlgo::Searcher<CU> prefixSearcher_{ nullptr, nullptr };
+    StrAlgo::Searcher<CU> innerSearcher_{ nullptr, nullptr };
+};
+
+} // namespace AGZ::StrImpl::PikeVM
+
+/**
+ * @endcond
+ */
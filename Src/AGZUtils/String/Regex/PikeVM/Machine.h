@@ -6,8 +6,11 @@
 
 #include "../../../Alloc/FixedSizedArena.h"
 #include "../../../Misc/Common.h"
+#include "../../../Misc/ScopeGuard.h"
 #include "Syntax.h"
 #include "Backend.h"
+#include "Literal.h"
+#include "ScratchPool.h"
 
 /**
  * @cond
@@ -97,7 +100,7 @@ public:
 template<typename CP>
 struct Thread
 {
-    Thread(Inst<CP> *pc, SaveSlots &&saveSlots,
+    Thread(const Inst<CP> *pc, SaveSlots &&saveSlots,
            bool charExprReg, size_t startIdx)
         : pc(pc), saveSlots(std::move(saveSlots)),
           charExprReg(charExprReg), startIdx(startIdx)
@@ -105,7 +108,7 @@ struct Thread
 
     }
 
-    Inst<CP> *pc;
+    const Inst<CP> *pc;
     SaveSlots saveSlots;
     bool charExprReg;
     size_t startIdx;
@@ -121,18 +124,22 @@ public:
 
     using Interval = std::pair<size_t, size_t>;
 
+    // The regex is compiled here, so that the machine is never modified
+    // afterwards and can be used by multiple threads simultaneously
     explicit Machine(const StringView<CS> &regex)
-        : slotCount_(0), regex_(regex)
+        : slotCount_(0)
     {
-        
+        Parser<CS> parser;
+        auto ast = parser.Parse(regex);
+        prefilter_ = Prefilter<CS>(ast);
+        prog_ = Backend<CS>().Generate(ast, &slotCount_);
+        AGZ_ASSERT(prog_.Available() && prog_.Full());
     }
 
     std::optional<std::vector<size_t>>
         Match(const StringView<CS> &dst) const
     {
-        if(!prog_.Available())
-            Compile();
-        auto ret = Run<true, true>(dst);
+        auto ret = FilterAndRun<true, true>(dst);
         return ret.has_value() ? std::make_optional(
                                     std::move(ret.value().second))
                                : std::nullopt;
@@ -142,27 +149,60 @@ public:
                             std::vector<size_t>>>
         Search(const StringView<CS> &dst) const
     {
-        if(!prog_.Available())
-            Compile();
-        return Run<false, false>(dst);
+        return FilterAndRun<false, false>(dst);
     }
 
     std::optional<std::pair<std::pair<size_t, size_t>,
                   std::vector<size_t>>>
         SearchPrefix(const StringView<CS> &dst) const
     {
-        if(!prog_.Available())
-            Compile();
-        return Run<true, false>(dst);
+        return FilterAndRun<true, false>(dst);
     }
 
     std::optional<std::pair<std::pair<size_t, size_t>,
                   std::vector<size_t>>>
         SearchSuffix(const StringView<CS> &dst) const
     {
-        if(!prog_.Available())
-            Compile();
-        return Run<false, true>(dst);
+        return FilterAndRun<false, true>(dst);
+    }
+
+    // Search in dst[fromIdx, dst.Length()).
+    // '^' and '$' still refer to the beginning/end of dst.
+    std::optional<std::pair<std::pair<size_t, size_t>,
+                  std::vector<size_t>>>
+        SearchFrom(const StringView<CS> &dst, size_t fromIdx) const
+    {
+        AGZ_ASSERT(fromIdx <= dst.Length());
+        return FilterAndRun<false, false>(dst, fromIdx);
+    }
+
+    // Match dst[begIdx, endIdx) as a whole and return the save points.
+    // '^' and '$' still refer to the beginning/end of dst.
+    std::optional<std::vector<size_t>>
+        MatchRange(const StringView<CS> &dst, size_t begIdx, size_t endIdx) const
+    {
+        AGZ_ASSERT(begIdx <= endIdx && endIdx <= dst.Length());
+        auto ret = Run<true, true>(dst, begIdx, endIdx);
+        return ret.has_value() ? std::make_optional(
+                                    std::move(ret.value().second))
+                               : std::nullopt;
+    }
+
+    // Compiled program, shared with other engines built on top of this one
+    const Program<CP> &GetProgram() const noexcept
+    {
+        return prog_;
+    }
+
+    size_t GetSaveSlotCount() const noexcept
+    {
+        return slotCount_;
+    }
+
+    // Literals required by the regex
+    const Prefilter<CS> &GetPrefilter() const noexcept
+    {
+        return prefilter_;
     }
 
 private:
@@ -170,9 +210,31 @@ private:
     using It = typename CS::Iterator;
     using CPR = StrImpl::CodePointRange<CS>;
 
-    mutable Program<CP> prog_;
-    mutable size_t slotCount_;
-    mutable String<CS> regex_;
+    // Memory written during matching, owned by one call at a time
+    struct Scratch
+    {
+        explicit Scratch(size_t instCount, size_t slotCount)
+            : saveSlotsArena(SaveSlots::AllocSize(slotCount)),
+              marks(instCount, 0), markBase(0)
+        {
+            rdyThds.reserve(instCount);
+            newThds.reserve(instCount);
+        }
+
+        FixedSizedArena<> saveSlotsArena;
+        std::vector<Thread<CP>> rdyThds, newThds;
+
+        // marks[i] == markBase + cpIdx + 1 if instruction i has been
+        // visited when adding threads for the cpIdx-th position
+        std::vector<size_t> marks;
+        size_t markBase;
+    };
+
+    Program<CP> prog_;
+    size_t slotCount_;
+    Prefilter<CS> prefilter_;
+
+    mutable ScratchPool<Scratch> scratchPool_;
 
     struct MatchState
     {
@@ -183,26 +245,25 @@ private:
         size_t matchedEnd;
         std::optional<SaveSlots> matchedSaveSlots;
 
-        uint32_t cpIdx;
-    };
+        size_t cpIdx;
 
-    void Compile() const
-    {
-        prog_ = Backend<CS>().Generate(
-            Parser<CS>().Parse(regex_), &slotCount_);
-        regex_ = String<CS>();
-        AGZ_ASSERT(prog_.Available() && prog_.Full());
-    }
+        size_t *marks;
+        size_t markBase;
+    };
 
     void AddThread(
         MatchState &state,
         std::vector<Thread<CP>> &thds,
-        Inst<CP> *pc, CP cp,
+        const Inst<CP> *pc, CP cp,
         SaveSlots &&saves, bool reg,
         size_t startIdx) const
     {
-        if(pc->lastStep == state.cpIdx)
+        // A thread reaching a visited instruction has a lower priority
+        // than the previous one, and can be safely discarded
+        size_t &mark = state.marks[prog_.GetInstIndex(pc)];
+        if(mark == state.markBase + state.cpIdx + 1)
             return;
+        mark = state.markBase + state.cpIdx + 1;
 
         switch(pc->type)
         {
@@ -388,12 +449,13 @@ private:
     void AddThreadWithPC(
         MatchState &state,
         std::vector<Thread<CP>> &thds,
-        Inst<CP> *pc,
+        const Inst<CP> *pc,
         CP cp, bool reg,
         Thread<CP> *oriTh) const
     {
         auto oldCur = state.cur;
         ++state.cur;
+        ++state.cpIdx;
         AddThread(
             state,
             thds,
@@ -401,6 +463,7 @@ private:
             std::move(oriTh->saveSlots),
             reg, oriTh->startIdx);
         state.cur = oldCur;
+        --state.cpIdx;
     }
 
     static CP NextCP(MatchState &state)
@@ -418,61 +481,114 @@ private:
             NextCP(state), th->charExprReg, th); \
     } while(0)
 
+    static CP CurCP(const MatchState &state, const It &end)
+    {
+        return state.cur == end ? (std::numeric_limits<CP>::max)()
+                                : *state.cur;
+    }
+
+    // Reject the input by the required literals before running the VM
     template<bool AnchorBegin, bool AnchorEnd>
     std::optional<std::pair<Interval, std::vector<size_t>>>
-        Run(const StringView<CS> &str) const
+        FilterAndRun(const StringView<CS> &str, size_t begIdx = 0) const
     {
-        AGZ_ASSERT(prog_.Available());
+        const CU *beg = str.Data() + begIdx, *end = str.Data() + str.Length();
+        if(!prefilter_.template MayMatch<AnchorBegin, AnchorEnd>(beg, end))
+            return std::nullopt;
+        return Run<AnchorBegin, AnchorEnd>(str, begIdx, str.Length());
+    }
 
-        size_t saveAllocSize = SaveSlots::AllocSize(slotCount_);
-        FixedSizedArena<> saveSlotsArena(saveAllocSize);
+    // Run the VM on str[begIdx, endIdx).
+    // Positions are code unit indices in str, as are the save points.
+    template<bool AnchorBegin, bool AnchorEnd>
+    std::optional<std::pair<Interval, std::vector<size_t>>>
+        Run(const StringView<CS> &str, size_t begIdx, size_t endIdx) const
+    {
+        AGZ_ASSERT(prog_.Available());
 
-        prog_.ReinitLastSteps();
-        std::vector<Thread<CP>> rdyThds, newThds;
-        rdyThds.reserve(prog_.Size());
-        newThds.reserve(prog_.Size());
+        auto scratch = scratchPool_.Acquire([&]
+        {
+            return new Scratch(prog_.Size(), slotCount_);
+        });
+
+        FixedSizedArena<> &saveSlotsArena = scratch->saveSlotsArena;
+        std::vector<Thread<CP>> &rdyThds = scratch->rdyThds;
+        std::vector<Thread<CP>> &newThds = scratch->newThds;
+        AGZ_ASSERT(rdyThds.empty() && newThds.empty());
+
+        // Threads hold save slots allocated from the arena
+        // and must be destroyed before the scratch is released
+        AGZ_SCOPE_GUARD({
+            rdyThds.clear();
+            newThds.clear();
+        });
 
         CPR cpr = str.CodePoints();
+        const It winEnd(str.Data() + endIdx);
+
         MatchState state;
-        state.cur = cpr.begin();
+        state.cur = It(str.Data() + begIdx);
         state.cpr = &cpr;
         state.matchedStart = 0;
         state.matchedEnd = 0;
         state.matchedSaveSlots.reset();
         state.cpIdx = 0;
+        state.marks = scratch->marks.data();
+        state.markBase = scratch->markBase;
+
+        // Marks made by this run are never equal to the ones of later runs,
+        // even if the run is left by an exception
+        AGZ_SCOPE_GUARD({
+            scratch->markBase = state.markBase + state.cpIdx + 2;
+        });
 
         if constexpr(AnchorBegin)
         {
-            if(!str.Empty())
-            {
-                AddThread(
-                    state, rdyThds, &prog_.GetInst(0), *state.cur,
-                    SaveSlots(slotCount_, saveSlotsArena),
-                    true, 0);
-            }
+            AddThread(
+                state, rdyThds, &prog_.GetInst(0), CurCP(state, winEnd),
+                SaveSlots(slotCount_, saveSlotsArena),
+                true, begIdx);
         }
 
-        for(; state.cur != cpr.end(); ++state.cur, ++state.cpIdx)
+        for(;; ++state.cur, ++state.cpIdx)
         {
-            CP cp = *state.cur;
-
             if constexpr(!AnchorBegin)
             {
-                AddThread(
-                    state, rdyThds, &prog_.GetInst(0),
-                    cp, SaveSlots(slotCount_, saveSlotsArena),
-                    true, state.cpIdx);
-            }
-            else
-            {
-                if(rdyThds.empty())
-                    break;
+                // Threads started later have lower priorities than
+                // the matched one, so there is no need to start them
+                if(!state.matchedSaveSlots)
+                {
+                    // With no thread alive, a match can only begin
+                    // at the next occurrence of the required prefix
+                    if(rdyThds.empty() && prefilter_.HasPrefix())
+                    {
+                        const CU *next = prefilter_.NextStart(
+                            CS::CodeUnitsBeginFromCodePointIterator(state.cur),
+                            str.Data() + endIdx);
+                        if(next == str.Data() + endIdx)
+                            break;
+                        state.cur = It(next);
+                    }
+
+                    AddThread(
+                        state, rdyThds, &prog_.GetInst(0),
+                        CurCP(state, winEnd),
+                        SaveSlots(slotCount_, saveSlotsArena),
+                        true, cpr.CodeUnitIndex(state.cur));
+                }
             }
 
+            if(state.cur == winEnd)
+                break;
+            if(rdyThds.empty() && (AnchorBegin || state.matchedSaveSlots))
+                break;
+
+            CP cp = *state.cur;
+
             for(size_t i = 0; i < rdyThds.size(); ++i)
             {
                 Thread<CP> *th = &rdyThds[i];
-                Inst<CP> *pc = th->pc;
+                const Inst<CP> *pc = th->pc;
 
                 switch(pc->type)
                 {
@@ -547,7 +663,7 @@ private:
             {
                 state.matchedSaveSlots.emplace(std::move(th.saveSlots));
                 state.matchedStart = th.startIdx;
-                state.matchedEnd = str.Length();
+                state.matchedEnd = endIdx;
                 break;
             }
         }
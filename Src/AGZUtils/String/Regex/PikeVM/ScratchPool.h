@@ -0,0 +1,93 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../../../Misc/Common.h"
+
+/**
+ * @cond
+ */
+
+namespace AGZ::StrImpl::PikeVM {
+
+/*
+    Pool of mutable working states of a regex engine.
+
+    Compiled programs are immutable and shared by all threads, while
+    everything written during matching lives in a scratch object. Each call
+    borrows one from the pool and gives it back when done, so concurrent
+    calls never share a scratch object, and sequential calls reuse the
+    memory allocated by previous ones.
+*/
+template<typename T>
+class ScratchPool
+{
+    std::mutex mut_;
+    std::vector<std::unique_ptr<T>> free_;
+
+public:
+
+    class Guard
+    {
+        ScratchPool *pool_;
+        std::unique_ptr<T> obj_;
+
+    public:
+
+        Guard(ScratchPool *pool, std::unique_ptr<T> &&obj) noexcept
+            : pool_(pool), obj_(std::move(obj))
+        {
+
+        }
+
+        Guard(const Guard&) = delete;
+        Guard &operator=(const Guard&) = delete;
+
+        ~Guard()
+        {
+            if(obj_)
+                pool_->Release(std::move(obj_));
+        }
+
+        T &operator*()  const noexcept { return *obj_; }
+        T *operator->() const noexcept { return obj_.get(); }
+    };
+
+    ScratchPool() = default;
+
+    ScratchPool(const ScratchPool&) = delete;
+    ScratchPool &operator=(const ScratchPool&) = delete;
+
+    // Borrow a scratch object. create() is called to make a new one when the pool is empty
+    template<typename Creator>
+    Guard Acquire(Creator &&create)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mut_);
+            if(!free_.empty())
+            {
+                auto ret = std::move(free_.back());
+                free_.pop_back();
+                return Guard(this, std::move(ret));
+            }
+        }
+        return Guard(this, std::unique_ptr<T>(create()));
+    }
+
+private:
+
+    void Release(std::unique_ptr<T> &&obj)
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        free_.push_back(std::move(obj));
+    }
+};
+
+} // namespace AGZ::StrImpl::PikeVM
+
+/**
+ * @endcond
+ */
@@ -1,12 +1,17 @@
 ﻿#pragma once
 
+#include <initializer_list>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "../../Misc/Common.h"
 #include "../String/String.h"
+#include "LazyDFA.h"
 #include "PikeVM.h"
 
 // Regular expression
@@ -19,6 +24,9 @@
         std::optional<std::pair<std::pair<size_t, size_t>,
                                 std::vector<size_t>>>
             Search(const StringView<CS> &dst);
+        std::optional<std::pair<std::pair<size_t, size_t>,
+                                std::vector<size_t>>>
+            SearchFrom(const StringView<CS> &dst, size_t fromIdx);
     }
 */
 
@@ -159,9 +167,204 @@ private:
     std::vector<size_t> savePoints_;
 };
 
+template<typename CS, typename Eng>
+class MatchIterator;
+
+/**
+ * @brief 引用目标串的轻量匹配结果，由 Regex<CS, Eng>::SearchAll 产生
+ *
+ * 与 MatchResult<CS> 不同，该对象不持有目标串的副本，因此目标串必须在其生命期内保持有效。
+ * 该对象总是表示一次成功的匹配。
+ */
+template<typename CS>
+class MatchView
+{
+public:
+
+    template<typename OCS, typename Eng>
+    friend class MatchIterator;
+
+    using Interval = std::pair<size_t, size_t>;
+
+    //! 取得第idx个保存点所记录的码元位置
+    size_t operator[](size_t idx) const
+    {
+        AGZ_ASSERT(idx < savePoints_.size());
+        return savePoints_[idx];
+    }
+
+    //! 搜索得到的子串的第一个码元的位置
+    size_t GetMatchedStart() const { return interval_.first; }
+
+    //! 搜索得到的子串的结尾的下一个码元位置
+    size_t GetMatchedEnd() const { return interval_.second; }
+
+    //! 搜索得到的子串的码元下标范围
+    Interval GetMatchedInterval() const { return interval_; }
+
+    //! 搜索得到的子串
+    StringView<CS> GetMatched() const
+    {
+        return whole_.Slice(interval_.first, interval_.second);
+    }
+
+    //! 取得一对保存点所记录的位置间的子串
+    StringView<CS> operator()(size_t firstSavePoint, size_t secondSavePoint) const
+    {
+        AGZ_ASSERT(firstSavePoint <= secondSavePoint);
+        AGZ_ASSERT(secondSavePoint < savePoints_.size());
+        return whole_.Slice(savePoints_[firstSavePoint],
+                            savePoints_[secondSavePoint]);
+    }
+
+    //! 共定义了多少个保存点
+    size_t SavePointCount() const
+    {
+        return savePoints_.size();
+    }
+
+private:
+
+    MatchView(const StringView<CS> &whole, const Interval &interval,
+              std::vector<size_t> &&savePoints)
+        : whole_(whole), interval_(interval),
+          savePoints_(std::move(savePoints))
+    {
+
+    }
+
+    StringView<CS> whole_;
+    Interval interval_;
+    std::vector<size_t> savePoints_;
+};
+
+/**
+ * @brief 依次遍历目标串中互不重叠的匹配的迭代器，缺省构造的迭代器表示遍历结束
+ *
+ * 每次匹配从上一次匹配的结尾处开始搜索，紧接在上一次匹配之后的空匹配会被跳过。
+ * 引擎在各次搜索间复用其内部的临时数据。
+ */
+template<typename CS, typename Eng>
+class MatchIterator
+{
+public:
+
+    using value_type        = MatchView<CS>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const MatchView<CS>*;
+    using reference         = const MatchView<CS>&;
+    using iterator_category = std::input_iterator_tag;
+
+    MatchIterator() = default;
+
+    MatchIterator(const Eng *engine, const StringView<CS> &whole)
+        : engine_(engine)
+    {
+        Find(whole, 0);
+    }
+
+    reference operator*() const
+    {
+        AGZ_ASSERT(cur_);
+        return *cur_;
+    }
+
+    pointer operator->() const
+    {
+        AGZ_ASSERT(cur_);
+        return &*cur_;
+    }
+
+    MatchIterator &operator++()
+    {
+        AGZ_ASSERT(cur_);
+        StringView<CS> whole = cur_->whole_;
+        Find(whole, cur_->interval_.second);
+        return *this;
+    }
+
+    MatchIterator operator++(int)
+    {
+        MatchIterator ret = *this;
+        ++*this;
+        return ret;
+    }
+
+    bool operator==(const MatchIterator &rhs) const
+    {
+        if(!cur_ || !rhs.cur_)
+            return !cur_ && !rhs.cur_;
+        return cur_->interval_ == rhs.cur_->interval_;
+    }
+
+    bool operator!=(const MatchIterator &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+private:
+
+    void Find(const StringView<CS> &whole, size_t fromIdx)
+    {
+        std::optional<size_t> lastEnd;
+        if(cur_)
+            lastEnd = cur_->interval_.second;
+
+        for(;;)
+        {
+            auto rt = engine_->SearchFrom(whole, fromIdx);
+            if(!rt)
+                break;
+
+            auto interval = rt.value().first;
+            if(interval.first != interval.second || interval.first != lastEnd)
+            {
+                cur_ = MatchView<CS>(whole, interval, std::move(rt.value().second));
+                return;
+            }
+
+            // Skip the empty match right after the previous one
+            if(fromIdx == whole.Length())
+                break;
+            typename CS::Iterator it(whole.Data() + fromIdx);
+            fromIdx = CS::CodeUnitsBeginFromCodePointIterator(++it) - whole.Data();
+        }
+
+        cur_.reset();
+    }
+
+    const Eng *engine_ = nullptr;
+    std::optional<MatchView<CS>> cur_;
+};
+
+/**
+ * @brief 由 Regex<CS, Eng>::SearchAll 返回的range，持有引擎的引用计数
+ */
+template<typename CS, typename Eng>
+class MatchRange
+{
+    std::shared_ptr<const Eng> engine_;
+    StringView<CS> whole_;
+
+public:
+
+    using Iterator = MatchIterator<CS, Eng>;
+
+    MatchRange(std::shared_ptr<const Eng> engine, const StringView<CS> &whole)
+        : engine_(std::move(engine)), whole_(whole)
+    {
+
+    }
+
+    Iterator begin() const { return Iterator(engine_.get(), whole_); }
+    Iterator end()   const { return Iterator(); }
+};
+
 /**
  * @brief 正则表达式类，表达式语法与所用的引擎有关，缺省使用PikeVM引擎
- * @warning PikeVM引擎不是线程安全的
+ *
+ * 表达式在构造时即被编译，此后引擎不再被修改，匹配过程中使用的临时数据由各次调用单独持有。
+ * 因此同一个正则表达式对象（及其副本）可以同时被多个线程用于匹配，无需为每个线程复制。
  */
 template<typename CS, typename Eng = StrImpl::PikeVM::Machine<CS>>
 class Regex
@@ -267,6 +470,55 @@ public:
         return Result(dst, rt.value().first, std::move(rt.value().second));
     }
 
+    /**
+     * @brief 依次搜索目标串中所有互不重叠的匹配
+     *
+     * 得到的 MatchView<CS> 仅引用目标串而不复制它，因此目标串必须在遍历过程中保持有效。
+     * 紧接在上一个匹配之后的空匹配会被跳过。
+     */
+    MatchRange<CS, Eng> SearchAll(const StringView<CS> &dst) const
+    {
+        return MatchRange<CS, Eng>(engine_, dst);
+    }
+
+    //! 遍历结果会引用临时字符串，故禁止之
+    MatchRange<CS, Eng> SearchAll(const String<CS> &&dst) const = delete;
+
+    //! 将目标串中所有互不重叠的匹配替换为replacement，结果被写入同一个缓存中
+    String<CS> ReplaceAll(const StringView<CS> &dst, const StringView<CS> &replacement) const
+    {
+        return ReplaceAll(dst, [&](const MatchView<CS>&) { return replacement; });
+    }
+
+    //! @copydoc Regex<CS, Eng>::ReplaceAll(const StringView<CS>&, const StringView<CS>&) const
+    String<CS> ReplaceAll(const String<CS> &dst, const String<CS> &replacement) const
+    {
+        return ReplaceAll(dst.AsView(), replacement.AsView());
+    }
+
+    /**
+     * @brief 将目标串中所有互不重叠的匹配m替换为func(m)，结果被写入同一个缓存中
+     *
+     * @param func 以 const MatchView<CS>& 为参数，返回值可被追加到 StringBuilder<CS> 中
+     */
+    template<typename Func, typename = std::enable_if_t<
+                                std::is_invocable_v<Func, const MatchView<CS>&>>>
+    String<CS> ReplaceAll(const StringView<CS> &dst, Func &&func) const
+    {
+        StringBuilder<CS> builder;
+        builder.Reserve(dst.Length());
+
+        size_t last = 0;
+        for(auto &m : SearchAll(dst))
+        {
+            builder << dst.Slice(last, m.GetMatchedStart()) << func(m);
+            last = m.GetMatchedEnd();
+        }
+        builder << dst.Slice(last);
+
+        return builder.Get();
+    }
+
 private:
 
     std::shared_ptr<Engine> engine_;
@@ -277,4 +529,116 @@ using Regex16 = Regex<UTF16<>>; ///< 用于UTF-16编码字符串的正则表达
 using Regex32 = Regex<UTF32<>>; ///< 用于UTF-32编码字符串的正则表达式
 using WRegex  = Regex<WUTF>;    ///< 用于宽字符编码字符串的正则表达式
 
+/**
+ * @brief 使用惰性DFA引擎的正则表达式，语法和匹配结果与缺省的PikeVM引擎相同
+ *
+ * DFA的状态在匹配过程中按需构造并缓存在有上限的缓存中，之后再遇到相同的状态时只需查表，
+ * 适合用同一个表达式反复搜索大量文本的场合。表达式中含有保存点时，
+ * 先由DFA确定匹配的范围，再只在该范围上运行PikeVM来求得各保存点的位置。
+ * 缓存被过快地填满时（状态数量随输入剧烈增长的表达式），会退回到PikeVM引擎。
+ *
+ * 同时进行的各次匹配使用各自的状态缓存，缓存在调用之间被复用，因此可以多线程共享同一个表达式。
+ */
+template<typename CS>
+using DFARegex = Regex<CS, StrImpl::LazyDFA::Machine<CS>>;
+
+using DFARegex8  = DFARegex<UTF8<>>;  ///< 用于UTF-8编码字符串的惰性DFA正则表达式
+using DFARegex16 = DFARegex<UTF16<>>; ///< 用于UTF-16编码字符串的惰性DFA正则表达式
+using DFARegex32 = DFARegex<UTF32<>>; ///< 用于UTF-32编码字符串的惰性DFA正则表达式
+using WDFARegex  = DFARegex<WUTF>;    ///< 用于宽字符编码字符串的惰性DFA正则表达式
+
+/**
+ * @brief 正则表达式集合，一次扫描即可求出目标串能和集合中的哪些表达式匹配
+ *
+ * 所有表达式被编译到同一个程序中，每个表达式以标有其序号的匹配指令结尾，
+ * 匹配时由惰性DFA同时模拟所有表达式，耗时与表达式的数量基本无关。
+ * 状态缓存被过快地填满时，剩余的输入改为不经缓存逐个位置地计算状态。
+ *
+ * 只报告匹配的表达式序号，不提供匹配位置和保存点；需要时可再用对应的 Regex 求得。
+ * 和 Regex 一样，同一个集合对象可以被多个线程同时使用。
+ */
+template<typename CS>
+class RegexSet
+{
+public:
+
+    using Charset   = CS;
+    using CodePoint = typename CS::CodePoint;
+    using CodeUnit  = typename CS::CodeUnit;
+    using Engine    = StrImpl::LazyDFA::SetMachine<CS>;
+    using Self      = RegexSet<CS>;
+
+    /**
+     * 用给定的一组表达式初始化，表达式的序号即其在参数中的下标
+     *
+     * @exception ArgumentException 表达式集合为空或某个表达式不合法时抛出
+     */
+    explicit RegexSet(const std::vector<StringView<CS>> &regexes)
+        : engine_(std::make_shared<Engine>(regexes))
+    {
+
+    }
+
+    /**
+     * 用给定的一组表达式初始化，表达式的序号即其在参数中的下标
+     *
+     * @exception ArgumentException 表达式集合为空或某个表达式不合法时抛出
+     */
+    explicit RegexSet(const std::vector<String<CS>> &regexes)
+        : RegexSet(std::vector<StringView<CS>>(regexes.begin(), regexes.end()))
+    {
+
+    }
+
+    /**
+     * 用给定的一组表达式初始化，表达式的序号即其在参数中的下标
+     *
+     * @exception ArgumentException 表达式集合为空或某个表达式不合法时抛出
+     */
+    RegexSet(std::initializer_list<String<CS>> regexes)
+        : RegexSet(std::vector<StringView<CS>>(regexes.begin(), regexes.end()))
+    {
+
+    }
+
+    //! 集合中表达式的数量
+    size_t Size() const noexcept
+    {
+        return engine_->PatternCount();
+    }
+
+    //! 能和整个目标串匹配的表达式的序号，按升序排列
+    std::vector<size_t> Match(const StringView<CS> &dst) const
+    {
+        return engine_->Match(dst);
+    }
+
+    //! 能和整个目标串匹配的表达式的序号，按升序排列
+    std::vector<size_t> Match(const String<CS> &dst) const
+    {
+        return Match(dst.AsView());
+    }
+
+    //! 能和目标串的某个子串匹配的表达式的序号，按升序排列
+    std::vector<size_t> Search(const StringView<CS> &dst) const
+    {
+        return engine_->Search(dst);
+    }
+
+    //! 能和目标串的某个子串匹配的表达式的序号，按升序排列
+    std::vector<size_t> Search(const String<CS> &dst) const
+    {
+        return Search(dst.AsView());
+    }
+
+private:
+
+    std::shared_ptr<const Engine> engine_;
+};
+
+using RegexSet8  = RegexSet<UTF8<>>;  ///< 用于UTF-8编码字符串的正则表达式集合
+using RegexSet16 = RegexSet<UTF16<>>; ///< 用于UTF-16编码字符串的正则表达式集合
+using RegexSet32 = RegexSet<UTF32<>>; ///< 用于UTF-32编码字符串的正则表达式集合
+using WRegexSet  = RegexSet<WUTF>;    ///< 用于宽字符编码字符串的正则表达式集合
+
 } // namespace AGZ
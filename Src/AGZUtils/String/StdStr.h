@@ -11,6 +11,8 @@
 
 #include "../Misc/Common.h"
 #include "../Misc/Exception.h"
+#include "NumConv.h"
+#include "String/StrAlgo.h"
 #include "String/String.h"
 
 namespace AGZ
@@ -680,12 +682,16 @@ size_t Split(
     CONV(src);
     CONV(splitter);
 
+    StrAlgo::Searcher<TCHAR(T1)> searcher(splitter.data(), splitter.data() + splitter.size());
+
     size_t beg = 0, ret = 0;
     while(beg < src.size())
     {
-        size_t end = src.find(splitter, beg);
+        const TCHAR(T1) *srcEnd = src.data() + src.size();
+        const TCHAR(T1) *hit = searcher.Find(src.data() + beg, srcEnd);
+        size_t end = static_cast<size_t>(hit - src.data());
 
-        if(end == std::basic_string_view<TCHAR(T1)>::npos)
+        if(hit == srcEnd)
         {
             ++ret;
             outIterator = typename TOutIterator::container_type::value_type(src.substr(beg, src.size() - beg));
@@ -719,6 +725,67 @@ size_t Split(const T &_src, TOutIterator outIterator, bool removeEmptyResult = t
     return Split(src, IsWhitespace<TCHAR(T)>, outIterator, removeEmptyResult);
 }
 
+namespace Impl
+{
+    template<typename TChar>
+    struct SplitToken
+    {
+        std::basic_string_view<TChar> operator()(const TChar *beg, const TChar *end) const
+        {
+            return std::basic_string_view<TChar>(beg, static_cast<size_t>(end - beg));
+        }
+    };
+
+    template<typename TChar, typename TDelim>
+    using SplitRange = StrAlgo::SplitRange<TChar, TDelim, SplitToken<TChar>>;
+}
+
+/**
+ * @brief 惰性地用给定的字符谓词分割字符串
+ *
+ * 结果与对应的 Split 相同，但子串在遍历时才被逐个找出，且不分配内存，可以和Range中的 Filter、Map、Take 等组合使用
+ *
+ * @param _src 待分割的字符串，在返回的range被使用期间必须保持有效
+ * @param pred 字符谓词，凡满足该谓词的字符均被视为分割字符
+ * @param removeEmptyResult 是否移除分割结果中的空字符串，缺省为 true
+ * @return 元素类型为 std::basic_string_view<TChar> 的range
+ */
+template<typename T, typename TPred, CONV_T(T),
+         std::enable_if_t<std::is_invocable_r_v<bool, TPred&, TCHAR(T)>, int> = 0>
+auto LazySplit(const T &_src, TPred pred, bool removeEmptyResult = true)
+{
+    CONV(src);
+    using Delim = StrAlgo::SplitByPred<TCHAR(T), TPred>;
+    return Impl::SplitRange<TCHAR(T), Delim>(
+        src.data(), src.data() + src.size(), Delim{ std::move(pred) }, {}, removeEmptyResult);
+}
+
+/**
+ * @brief 惰性地用给定的字符串分割字符串，参见 LazySplit(const T&, TPred, bool)
+ *
+ * @param _src 待分割的字符串，在返回的range被使用期间必须保持有效
+ * @param _splitter 用于作为分割串的非空字符串，在返回的range被使用期间必须保持有效
+ * @param removeEmptyResult 是否移除分割结果中的空字符串，缺省为 true
+ */
+template<typename T1, typename T2, CONV_T(T1), CONV_T(T2), TCHAR_EQ(T1, T2)>
+auto LazySplit(const T1 &_src, const T2 &_splitter, bool removeEmptyResult = true)
+{
+    CONV(src);
+    CONV(splitter);
+    using Delim = StrAlgo::SplitBySubstr<TCHAR(T1)>;
+    return Impl::SplitRange<TCHAR(T1), Delim>(
+        src.data(), src.data() + src.size(), Delim{ splitter.data(), splitter.size() }, {}, removeEmptyResult);
+}
+
+/**
+ * @brief 惰性地用空白字符作为分隔符分割字符串，参见 LazySplit(const T&, TPred, bool)
+ */
+template<typename T, CONV_T(T)>
+auto LazySplit(const T &_src, bool removeEmptyResult = true)
+{
+    return LazySplit(_src, IsWhitespace<TCHAR(T)>, removeEmptyResult);
+}
+
 /**
  * @brief 原地将字符串中的指定子串替换为另外的子串
  * @param str 被处理的母串
@@ -733,13 +800,29 @@ size_t ReplaceInPlace(
 {
     if(oldSubstr.empty())
         return 0;
-    size_t ret = 0, pos = 0;
-    while((pos = str.find(oldSubstr, pos)) != std::basic_string_view<TChar>::npos)
+
+    StrAlgo::Searcher<TChar> searcher(oldSubstr.data(), oldSubstr.data() + oldSubstr.size());
+    const TChar *cur = str.data(), *end = cur + str.size();
+    const TChar *hit = searcher.Find(cur, end);
+    if(hit == end)
+        return 0;
+
+    // 一次扫描中将结果写入新的缓冲区，避免每次替换都移动母串的剩余部分
+    std::basic_string<TChar> dst;
+    dst.reserve(str.size());
+    size_t ret = 0;
+    for(;;)
     {
-        str.replace(pos, oldSubstr.size(), newSubstr);
-        pos += newSubstr.size();
+        dst.append(cur, hit);
+        if(hit == end)
+            break;
+        dst.append(newSubstr.data(), newSubstr.size());
         ++ret;
+        cur = hit + oldSubstr.size();
+        hit = searcher.Find(cur, end);
     }
+
+    str.swap(dst);
     return ret;
 }
 
@@ -776,8 +859,17 @@ namespace Impl
     template<> struct ToImpl<char, uint16_t> { static std::string Call(uint16_t obj) { return std::to_string(obj); } };
     template<> struct ToImpl<char, uint32_t> { static std::string Call(uint32_t obj) { return std::to_string(obj); } };
     template<> struct ToImpl<char, uint64_t> { static std::string Call(uint64_t obj) { return std::to_string(obj); } };
-    template<> struct ToImpl<char, float>    { static std::string Call(float    obj) { return std::to_string(obj); } };
-    template<> struct ToImpl<char, double>   { static std::string Call(double   obj) { return std::to_string(obj); } };
+    template<typename T> struct ToShortestFloat
+    {
+        static std::string Call(T obj)
+        {
+            char buf[MAX_FLOAT_CHARS];
+            return std::string(buf, ToChars(obj, buf));
+        }
+    };
+
+    template<> struct ToImpl<char, float>    : ToShortestFloat<float>  { };
+    template<> struct ToImpl<char, double>   : ToShortestFloat<double> { };
     
     template<typename TChar> struct ToImpl<TChar, std::basic_string<TChar>>      { static std::basic_string<TChar> Call(const std::basic_string     <TChar> &obj) { return obj; } };
     template<typename TChar> struct ToImpl<TChar, std::basic_string_view<TChar>> { static std::basic_string<TChar> Call(const std::basic_string_view<TChar> &obj) { return obj; } };
@@ -786,7 +878,6 @@ namespace Impl
 
     template<typename TChar, typename T, typename...Args> struct FromImpl { };
 
-    // 为什么不把这个也用于floating point呢，因为截至到2019.3.12，gcc和clang还没实现float和double的from_chars。。。
     template<typename T> struct FromStr2Int
     {
         static_assert(std::is_integral_v<T>);
@@ -794,10 +885,10 @@ namespace Impl
         template<typename...OtherArgs>
         static T Call(const std::string_view &str, OtherArgs&&...otherArgs)
         {
-            T ret;
-            auto [np, er] = std::from_chars(str.data(), str.data() + str.size(), ret, std::forward<OtherArgs>(otherArgs)...);
-            if(er != std::errc() || np != str.data() + str.size())
-                throw FromException(str.data());
+            T ret = T(0);
+            NumConvError err = FromCharsExact(str.data(), str.data() + str.size(), ret, std::forward<OtherArgs>(otherArgs)...);
+            if(err != NumConvError::OK)
+                throw FromException(std::string(str));
             return ret;
         }
     };
@@ -809,14 +900,9 @@ namespace Impl
         template<typename...OtherArgs>
         static T Call(const std::string_view &str, OtherArgs&&...)
         {
-            std::stringstream sst;
-            sst << str;
-            T ret;
-            sst >> ret;
-            //if(!sst.str().empty())
-            //    throw FromException(str.data());
-            if(!sst.eof() || !sst)
-                throw FromException(str.data());
+            T ret = T(0);
+            if(FromCharsExact(str.data(), str.data() + str.size(), ret) != NumConvError::OK)
+                throw FromException(std::string(str));
             return ret;
         }
     };
@@ -1378,40 +1464,12 @@ namespace Impl
     {
         static TOut Call(const char **pStr, const char *end)
         {
-#if defined(AGZ_CC_CLANG) || defined(AGZ_CC_GCC)
-
-            // clang和gcc 8都没有实现from_chars的浮点版本
-            // 真是心碎
-
-            (void)pStr;
-            (void)end;
-            throw ParseFirstException(std::string("TParseFirstFloat is unimplemented") + typeid(TOut).name());
-
-            //TOut ret;
-            //std::string_view sv = std::string_view(*pStr, end - *pStr);
-
-            //std::stringstream sst;
-            //sst << sv;
-            //sst >> std::noskipws;
-            //sst >> ret;
-            //if(!sst)
-            //{
-            //    printf("%s %f\n", std::string(sst.str()).c_str(), ret);
-            //    throw ParseFirstException(std::string("TParseFirstFloat: failed to parse") + typeid(TOut).name());
-            //}
-            //*pStr += sv.length() - sst.str().length();
-            //return ret;
-
-#else
-
-            TOut ret;
-            auto [newPStr, err] = std::from_chars(*pStr, end, ret);
-            if(err != std::errc())
+            TOut ret = TOut(0);
+            auto [newPStr, err] = FromChars(*pStr, end, ret);
+            if(err != NumConvError::OK)
                 throw ParseFirstException(std::string("TParseFirstFloat: failed to parse") + typeid(TOut).name());
             *pStr = newPStr;
             return ret;
-
-#endif // if defined(AGZ_CC_CLANG) || defined(AGZ_CC_GCC) else
         }
     };
 }
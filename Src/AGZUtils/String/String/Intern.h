@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "../../Misc/Common.h"
+#include "../../Misc/Hash.h"
+#include "String.h"
+#include "StringArena.h"
+
+namespace AGZ::StrImpl {
+
+template<typename CS>
+class InternPool;
+
+namespace InternAux
+{
+    // 驻留池中的一项，创建后不会被修改或释放
+    template<typename CS>
+    struct Entry
+    {
+        String<CS> str;
+        size_t hash;
+    };
+
+    template<typename CU>
+    size_t HashCodeUnits(const CU *data, size_t len) noexcept
+    {
+        // 须与String::GetHash的结果一致
+        return static_cast<size_t>(HashBytes(data, len * sizeof(CU)));
+    }
+
+} // namespace InternAux
+
+/**
+ * @brief 驻留字符串句柄
+ *
+ * 仅包含一个指针。内容相同的字符串在同一驻留池中只有一份，因此比较相等只需比较指针，哈希值也在驻留时就已算好。
+ * 缺省构造的句柄表示空串，与驻留空串得到的句柄相等。
+ *
+ * @note operator< 比较的是驻留项的地址而非字符串内容，仅用于在有序容器中作为键
+ */
+template<typename CS>
+class InternedString
+{
+    friend class InternPool<CS>;
+
+    using Entry = InternAux::Entry<CS>;
+
+    const Entry *entry_;
+
+    explicit InternedString(const Entry *entry) noexcept
+        : entry_(entry)
+    {
+
+    }
+
+public:
+
+    using Charset  = CS;
+    using CodeUnit = typename CS::CodeUnit;
+    using Str      = String<CS>;
+    using View     = StringView<CS>;
+
+    //! 空串
+    InternedString() noexcept : entry_(nullptr) { }
+
+    //! 在全局驻留池中驻留[data, data + len)
+    InternedString(const CodeUnit *data, size_t len);
+
+    //! 在全局驻留池中驻留str
+    explicit InternedString(const Str &str) : InternedString(str.Data(), str.Length()) { }
+
+    //! 在全局驻留池中驻留view
+    explicit InternedString(const View &view) : InternedString(view.Data(), view.Length()) { }
+
+    /**
+     * @brief 被驻留的字符串，在驻留池析构前一直有效
+     *
+     * @note 未定义AGZ_THREAD_SAFE_STRING时，不应在多个线程中同时复制返回的字符串
+     */
+    const Str &Get() const noexcept
+    {
+        static const Str EMPTY;
+        return entry_ ? entry_->str : EMPTY;
+    }
+
+    View AsView() const { return Get().AsView(); }
+
+    const CodeUnit *Data() const { return Get().Data(); }
+
+    size_t Length() const { return Get().Length(); }
+
+    bool Empty() const noexcept { return !entry_; }
+
+    //! 与 String::GetHash 的结果相同，但不需要计算
+    size_t GetHash() const noexcept
+    {
+        static const size_t EMPTY_HASH = InternAux::HashCodeUnits<CodeUnit>(nullptr, 0);
+        return entry_ ? entry_->hash : EMPTY_HASH;
+    }
+
+    bool operator==(const InternedString &rhs) const noexcept { return entry_ == rhs.entry_; }
+    bool operator!=(const InternedString &rhs) const noexcept { return entry_ != rhs.entry_; }
+
+    bool operator<(const InternedString &rhs) const noexcept
+    {
+        return std::less<const Entry*>()(entry_, rhs.entry_);
+    }
+};
+
+/**
+ * @brief 字符串驻留池
+ *
+ * 按哈希值的高位分为若干分片，每个分片由各自的读写锁保护，不同线程驻留不同字符串时很少互相阻塞。
+ * 已驻留的字符串直到驻留池析构时才会被释放，因此只应驻留数量有限的字符串，如配置项名、对象组名等。
+ *
+ * 通常只需使用全局驻留池 Global，或直接构造 InternedString。
+ */
+template<typename CS>
+class InternPool : public Uncopiable
+{
+public:
+
+    using Str      = String<CS>;
+    using View     = StringView<CS>;
+    using Interned = InternedString<CS>;
+
+private:
+
+    using Entry    = InternAux::Entry<CS>;
+    using CodeUnit = typename CS::CodeUnit;
+
+    static constexpr size_t SHARD_BITS  = 4;
+    static constexpr size_t SHARD_COUNT = size_t(1) << SHARD_BITS;
+
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mut;
+        std::unordered_multimap<size_t, const Entry*> index;
+        std::deque<Entry> entries;
+
+        const Entry *Find(const CodeUnit *data, size_t len, size_t hash) const
+        {
+            auto [beg, end] = index.equal_range(hash);
+            for(; beg != end; ++beg)
+            {
+                const Str &str = beg->second->str;
+                if(str.Length() == len && std::equal(data, data + len, str.Data()))
+                    return beg->second;
+            }
+            return nullptr;
+        }
+    };
+
+    Shard shards_[SHARD_COUNT];
+
+    static size_t ShardIndex(size_t hash) noexcept
+    {
+        // 低位由unordered_multimap用于选择桶，分片使用高位以免二者相关
+        return hash >> (sizeof(size_t) * 8 - SHARD_BITS);
+    }
+
+public:
+
+    InternPool() = default;
+
+    //! 全局驻留池，InternedString 的构造函数使用此驻留池
+    static InternPool &Global()
+    {
+        static InternPool ret;
+        return ret;
+    }
+
+    /**
+     * @brief 驻留[data, data + len)，返回其句柄。可在任意线程中调用
+     */
+    Interned Intern(const CodeUnit *data, size_t len)
+    {
+        if(!len)
+            return Interned();
+
+        size_t hash = InternAux::HashCodeUnits(data, len);
+        Shard &shard = shards_[ShardIndex(hash)];
+
+        {
+            std::shared_lock<std::shared_mutex> lk(shard.mut);
+            if(auto entry = shard.Find(data, len, hash))
+                return Interned(entry);
+        }
+
+        std::lock_guard<std::shared_mutex> lk(shard.mut);
+        if(auto entry = shard.Find(data, len, hash))
+            return Interned(entry);
+
+        // 总是复制内容，以免驻留一个子串时使其所在的整个缓冲区都无法释放。
+        // 驻留项会一直存在，不能从调用方线程当前的 StringArena 中分配
+        HeapStringScope heapScope;
+        const Entry &entry = shard.entries.emplace_back(Entry{ Str(data, len), hash });
+        shard.index.emplace(hash, &entry);
+        return Interned(&entry);
+    }
+
+    Interned Intern(const Str &str)   { return Intern(str.Data(), str.Length()); }
+    Interned Intern(const View &view) { return Intern(view.Data(), view.Length()); }
+
+    /**
+     * @brief 查找已驻留的字符串，未驻留时返回std::nullopt，不会驻留新的字符串
+     */
+    std::optional<Interned> TryFind(const View &view) const
+    {
+        if(view.Empty())
+            return Interned();
+
+        size_t hash = view.GetHash();
+        const Shard &shard = shards_[ShardIndex(hash)];
+        std::shared_lock<std::shared_mutex> lk(shard.mut);
+        if(auto entry = shard.Find(view.Data(), view.Length(), hash))
+            return Interned(entry);
+        return std::nullopt;
+    }
+
+    //! 已驻留的字符串数量
+    size_t GetCount() const
+    {
+        size_t ret = 0;
+        for(auto &shard : shards_)
+        {
+            std::shared_lock<std::shared_mutex> lk(shard.mut);
+            ret += shard.entries.size();
+        }
+        return ret;
+    }
+};
+
+template<typename CS>
+InternedString<CS>::InternedString(const CodeUnit *data, size_t len)
+    : InternedString(InternPool<CS>::Global().Intern(data, len))
+{
+
+}
+
+} // namespace AGZ::StrImpl
+
+namespace AGZ {
+
+//! @copydoc StrImpl::InternedString<CS>
+template<typename CS>
+using InternedString = StrImpl::InternedString<CS>;
+//! @copydoc StrImpl::InternPool<CS>
+template<typename CS>
+using InternPool = StrImpl::InternPool<CS>;
+
+using InternedStr8  = InternedString<UTF8<>>;
+using InternedStr16 = InternedString<UTF16<>>;
+using InternedStr32 = InternedString<UTF32<>>;
+using InternedAStr  = InternedString<ASCII<>>;
+using InternedWStr  = InternedString<WUTF>;
+using InternedPStr  = InternedString<PUTF>;
+
+} // namespace AGZ
+
+namespace std
+{
+    template<typename CS>
+    struct hash<AGZ::InternedString<CS>>
+    {
+        size_t operator()(const AGZ::InternedString<CS> &s) const noexcept
+        {
+            return s.GetHash();
+        }
+    };
+}
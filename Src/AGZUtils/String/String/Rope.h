@@ -0,0 +1,509 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../../Misc/Common.h"
+#include "String.h"
+
+namespace AGZ::StrImpl {
+
+template<typename CS>
+class Rope;
+
+template<typename CS>
+class RopeCodePointRange;
+
+namespace RopeAux
+{
+    /**
+     * @brief 绳索中的节点，创建后不会被修改，因此可以在多个绳索间共享
+     *
+     * 叶节点的内容是一个非空的 String<CS>，它通常与其他字符串共享同一块引用计数缓存；
+     * 内部节点恰有两个子节点，height为子节点高度的较大者加1。
+     */
+    template<typename CS>
+    struct Node
+    {
+        using NodePtr = std::shared_ptr<const Node>;
+
+        size_t len;
+        int height;
+        NodePtr left, right;
+        String<CS> str;
+
+        bool IsLeaf() const noexcept { return !left; }
+    };
+
+    /**
+     * @brief 按从左到右的顺序遍历一棵树的所有叶节点
+     */
+    template<typename CS>
+    class LeafCursor
+    {
+        using NodeT = Node<CS>;
+
+        std::vector<const NodeT*> pending_; // 尚未访问的右子树
+        const NodeT *leaf_ = nullptr;
+
+        void DescendLeft(const NodeT *node)
+        {
+            while(!node->IsLeaf())
+            {
+                pending_.push_back(node->right.get());
+                node = node->left.get();
+            }
+            leaf_ = node;
+        }
+
+    public:
+
+        LeafCursor() = default;
+
+        explicit LeafCursor(const NodeT *root)
+        {
+            if(root)
+                DescendLeft(root);
+        }
+
+        //! 当前叶节点，遍历结束时为nullptr
+        const NodeT *Leaf() const noexcept { return leaf_; }
+
+        void Next()
+        {
+            AGZ_ASSERT(leaf_);
+            if(pending_.empty())
+            {
+                leaf_ = nullptr;
+                return;
+            }
+            const NodeT *node = pending_.back();
+            pending_.pop_back();
+            DescendLeft(node);
+        }
+    };
+
+} // namespace RopeAux
+
+/**
+ * @brief 绳索中码点的迭代器，只能向前移动
+ */
+template<typename CS>
+class RopeCodePointIterator
+{
+    friend class RopeCodePointRange<CS>;
+
+    using CodeUnit = typename CS::CodeUnit;
+
+    RopeAux::LeafCursor<CS> cursor_;
+    const CodeUnit *cur_ = nullptr, *end_ = nullptr;
+    size_t pos_ = 0;
+
+    typename CS::CodePoint cp_ = 0;
+    size_t cpLen_ = 0;
+
+    void Load()
+    {
+        while(cur_ == end_)
+        {
+            if(!cursor_.Leaf())
+            {
+                cur_ = end_ = nullptr;
+                return;
+            }
+            std::tie(cur_, end_) = cursor_.Leaf()->str.BeginAndEnd();
+            cursor_.Next();
+        }
+        // 非法的码元序列按每个码元一个码点处理，以保证总能前进
+        cpLen_ = (std::max)(size_t(1), CS::CheckedCU2CP(cur_, end_, &cp_));
+    }
+
+    RopeCodePointIterator(const RopeAux::Node<CS> *root, size_t pos)
+        : cursor_(root), pos_(pos)
+    {
+        Load();
+    }
+
+public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = typename CS::CodePoint;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const value_type*;
+    using reference         = const value_type&;
+
+    RopeCodePointIterator() = default;
+
+    reference operator*() const noexcept { return cp_; }
+
+    RopeCodePointIterator &operator++()
+    {
+        cur_ += cpLen_;
+        pos_ += cpLen_;
+        Load();
+        return *this;
+    }
+
+    RopeCodePointIterator operator++(int)
+    {
+        auto ret = *this;
+        ++*this;
+        return ret;
+    }
+
+    //! 当前码点的第一个码元在绳索中的下标
+    size_t CodeUnitIndex() const noexcept { return pos_; }
+
+    // 不同的叶节点可能共享同一块缓存，因此以下标而非指针判断位置
+    bool operator==(const RopeCodePointIterator &rhs) const noexcept { return pos_ == rhs.pos_; }
+    bool operator!=(const RopeCodePointIterator &rhs) const noexcept { return pos_ != rhs.pos_; }
+};
+
+/**
+ * @brief 用于遍历绳索中码点的range对象，其中保存了绳索的副本
+ */
+template<typename CS>
+class RopeCodePointRange
+{
+    std::shared_ptr<const RopeAux::Node<CS>> root_;
+    size_t len_;
+
+public:
+
+    using Iterator = RopeCodePointIterator<CS>;
+
+    RopeCodePointRange(std::shared_ptr<const RopeAux::Node<CS>> root, size_t len) noexcept
+        : root_(std::move(root)), len_(len)
+    {
+
+    }
+
+    Iterator begin() const { return Iterator(root_.get(), 0); }
+    Iterator end()   const { return Iterator(nullptr, len_); }
+};
+
+/**
+ * @brief 绳索，一种适合频繁在任意位置插入、删除的字符串
+ *
+ * 内容由一棵平衡二叉树（AVL）的叶节点依次连接而成，叶节点直接复用 String<CS> 的存储：
+ * 从字符串构造绳索、在叶节点内部切分时都不复制码元，而是与原字符串共享同一块引用计数缓存。
+ *
+ * 树节点是不可变的，修改操作只重建从根到修改位置的路径，因此复制绳索的开销是O(1)，
+ * Insert、Erase、Slice、Append、operator[]的开销均为O(log n)。
+ * 相邻的短叶节点在连接时会被合并，以免逐字符追加时产生大量过短的叶节点。
+ *
+ * 所有下标均以码元计，且应位于码点的边界上。
+ *
+ * @note 未定义AGZ_THREAD_SAFE_STRING时，不应在多个线程中同时复制共享了节点的绳索
+ */
+template<typename CS>
+class Rope
+{
+public:
+
+    using Charset   = CS;
+    using CodeUnit  = typename CS::CodeUnit;
+    using CodePoint = typename CS::CodePoint;
+    using Str       = String<CS>;
+    using View      = StringView<CS>;
+    using Self      = Rope<CS>;
+
+    //! 两个相邻叶节点的总长度不超过此值时，连接时会被合并为一个叶节点
+    static constexpr size_t MAX_MERGED_LEAF_LENGTH = 512;
+
+private:
+
+    using Node    = RopeAux::Node<CS>;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    NodePtr root_;
+
+    explicit Rope(NodePtr root) noexcept : root_(std::move(root)) { }
+
+    static size_t LengthOf(const NodePtr &node) noexcept { return node ? node->len : 0; }
+    static int HeightOf(const NodePtr &node)    noexcept { return node ? node->height : -1; }
+
+    static NodePtr MakeLeaf(Str str)
+    {
+        if(str.Empty())
+            return nullptr;
+        size_t len = str.Length();
+        return std::make_shared<const Node>(Node{ len, 0, nullptr, nullptr, std::move(str) });
+    }
+
+    static NodePtr MakeInner(NodePtr left, NodePtr right)
+    {
+        AGZ_ASSERT(left && right);
+        size_t len = left->len + right->len;
+        int height = (std::max)(left->height, right->height) + 1;
+        return std::make_shared<const Node>(Node{ len, height, std::move(left), std::move(right), Str() });
+    }
+
+    static bool IsMergeableLeaf(const NodePtr &lhs, const NodePtr &rhs) noexcept
+    {
+        return lhs->IsLeaf() && rhs->IsLeaf() && lhs->len + rhs->len <= MAX_MERGED_LEAF_LENGTH;
+    }
+
+    // 以left、right为子节点构造一个节点，二者的高度差不超过2，必要时旋转以恢复平衡
+    static NodePtr Balance(NodePtr left, NodePtr right)
+    {
+        int hl = HeightOf(left), hr = HeightOf(right);
+        if(hl > hr + 1)
+        {
+            if(HeightOf(left->left) >= HeightOf(left->right))
+                return MakeInner(left->left, MakeInner(left->right, std::move(right)));
+            return MakeInner(MakeInner(left->left, left->right->left),
+                             MakeInner(left->right->right, std::move(right)));
+        }
+        if(hr > hl + 1)
+        {
+            if(HeightOf(right->right) >= HeightOf(right->left))
+                return MakeInner(MakeInner(std::move(left), right->left), right->right);
+            return MakeInner(MakeInner(std::move(left), right->left->left),
+                             MakeInner(right->left->right, right->right));
+        }
+        return MakeInner(std::move(left), std::move(right));
+    }
+
+    // 连接两棵树，开销为O(|height(lhs) - height(rhs)| + 1)
+    static NodePtr Join(const NodePtr &lhs, const NodePtr &rhs)
+    {
+        if(!lhs)
+            return rhs;
+        if(!rhs)
+            return lhs;
+
+        if(IsMergeableLeaf(lhs, rhs))
+        {
+            typename Str::Builder builder;
+            builder.Reserve(lhs->len + rhs->len);
+            builder.Append(lhs->str).Append(rhs->str);
+            return MakeLeaf(builder.Get());
+        }
+
+        int hl = lhs->height, hr = rhs->height;
+
+        // 沿较高一侧的边缘下降，直到高度相近；rhs是短叶节点时一直下降到lhs最右侧的叶节点，以便与之合并
+        if(hl > hr + 1 || (rhs->IsLeaf() && !lhs->IsLeaf() && IsMergeableLeaf(lhs->right, rhs)))
+            return Balance(lhs->left, Join(lhs->right, rhs));
+        if(hr > hl + 1 || (lhs->IsLeaf() && !rhs->IsLeaf() && IsMergeableLeaf(lhs, rhs->left)))
+            return Balance(Join(lhs, rhs->left), rhs->right);
+
+        return MakeInner(lhs, rhs);
+    }
+
+    // 将树分为[0, idx)和[idx, len)两部分，开销为O(log n)
+    static std::pair<NodePtr, NodePtr> Split(const NodePtr &node, size_t idx)
+    {
+        if(!node || !idx)
+            return { nullptr, node };
+        if(idx >= node->len)
+            return { node, nullptr };
+
+        if(node->IsLeaf())
+        {
+            // 两部分都与原叶节点共享存储
+            return { MakeLeaf(Str(node->str, 0, idx)), MakeLeaf(Str(node->str, idx, node->len)) };
+        }
+
+        size_t leftLen = node->left->len;
+        if(idx < leftLen)
+        {
+            auto [l, r] = Split(node->left, idx);
+            return { std::move(l), Join(r, node->right) };
+        }
+        if(idx > leftLen)
+        {
+            auto [l, r] = Split(node->right, idx - leftLen);
+            return { Join(node->left, l), std::move(r) };
+        }
+        return { node->left, node->right };
+    }
+
+    template<typename F>
+    static void ForEachLeaf(const Node *node, F &f)
+    {
+        while(!node->IsLeaf())
+        {
+            ForEachLeaf(node->left.get(), f);
+            node = node->right.get();
+        }
+        f(node->str);
+    }
+
+public:
+
+    //! 空绳索
+    Rope() = default;
+
+    //! 以str为唯一的叶节点，不复制其内容
+    explicit Rope(const Str &str) : root_(MakeLeaf(str)) { }
+
+    //! 以view所引用的子串为唯一的叶节点，与view所引用的字符串共享存储
+    explicit Rope(const View &view)
+    {
+        size_t begIdx = static_cast<size_t>(view.beg_ - view.str_->Data());
+        root_ = MakeLeaf(Str(*view.str_, begIdx, begIdx + view.len_));
+    }
+
+    //! 复制[beg, beg + len)中的码元
+    Rope(const CodeUnit *beg, size_t len) : Rope(Str(beg, len)) { }
+
+    //! 码元数量
+    size_t Length() const noexcept { return LengthOf(root_); }
+
+    //! 是否为空
+    bool Empty() const noexcept { return !root_; }
+
+    //! 树的高度，空绳索与只有一个叶节点的绳索高度为0
+    int GetHeight() const noexcept { return (std::max)(0, HeightOf(root_)); }
+
+    //! 取得下标为idx的码元，开销为O(log n)
+    CodeUnit operator[](size_t idx) const
+    {
+        AGZ_ASSERT(idx < Length());
+        const Node *node = root_.get();
+        while(!node->IsLeaf())
+        {
+            if(idx < node->left->len)
+                node = node->left.get();
+            else
+            {
+                idx -= node->left->len;
+                node = node->right.get();
+            }
+        }
+        return node->str.Data()[idx];
+    }
+
+    //! 在下标为idx的码元前插入rope
+    Self &Insert(size_t idx, const Self &rope)
+    {
+        AGZ_ASSERT(idx <= Length());
+        auto [l, r] = Split(root_, idx);
+        root_ = Join(Join(l, rope.root_), r);
+        return *this;
+    }
+
+    //! 在下标为idx的码元前插入str，不复制str的内容（除非它很短，会被合并到相邻的叶节点中）
+    Self &Insert(size_t idx, const Str &str)  { return Insert(idx, Self(str)); }
+    Self &Insert(size_t idx, const View &view) { return Insert(idx, Self(view)); }
+
+    //! 在末尾追加内容
+    Self &Append(const Self &rope)  { root_ = Join(root_, rope.root_); return *this; }
+    Self &Append(const Str &str)    { return Append(Self(str)); }
+    Self &Append(const View &view)  { return Append(Self(view)); }
+
+    //! 删除下标位于[begIdx, endIdx)中的码元
+    Self &Erase(size_t begIdx, size_t endIdx)
+    {
+        AGZ_ASSERT(begIdx <= endIdx && endIdx <= Length());
+        auto [lm, r] = Split(root_, endIdx);
+        root_ = Join(Split(lm, begIdx).first, r);
+        return *this;
+    }
+
+    //! 下标位于[begIdx, endIdx)中的码元构成的子绳索，与自身共享节点
+    Self Slice(size_t begIdx, size_t endIdx) const
+    {
+        AGZ_ASSERT(begIdx <= endIdx && endIdx <= Length());
+        return Self(Split(Split(root_, endIdx).first, begIdx).second);
+    }
+
+    //! 从下标为begIdx的码元开始直到结尾的子绳索
+    Self Slice(size_t begIdx) const { return Slice(begIdx, Length()); }
+
+    /**
+     * @brief 按顺序对每一段连续的码元调用func(const String<CS> &)
+     *
+     * 可以借此将内容写入文件等，而不必先转换为一整个字符串
+     */
+    template<typename F>
+    void ForEachChunk(F &&func) const
+    {
+        if(root_)
+            ForEachLeaf(root_.get(), func);
+    }
+
+    /**
+     * @brief 转换为字符串
+     *
+     * 只有一个叶节点时直接返回该叶节点的字符串，否则将所有内容复制到一块新分配的缓存中
+     */
+    Str ToString() const
+    {
+        if(!root_)
+            return Str();
+        if(root_->IsLeaf())
+            return root_->str;
+
+        typename Str::Builder builder;
+        builder.Reserve(root_->len);
+        ForEachChunk([&](const Str &chunk) { builder.Append(chunk); });
+        return builder.Get();
+    }
+
+    //! 遍历所有码点的range，保存了绳索的副本，因此在自身被修改后仍然有效
+    RopeCodePointRange<CS> CodePoints() const { return RopeCodePointRange<CS>(root_, Length()); }
+
+    //! 内容是否相同
+    bool operator==(const Self &rhs) const
+    {
+        if(Length() != rhs.Length())
+            return false;
+        if(root_ == rhs.root_)
+            return true;
+
+        RopeAux::LeafCursor<CS> lc(root_.get()), rc(rhs.root_.get());
+        const CodeUnit *lcur = nullptr, *lend = nullptr, *rcur = nullptr, *rend = nullptr;
+        for(;;)
+        {
+            if(lcur == lend)
+            {
+                if(!lc.Leaf())
+                    return true;
+                std::tie(lcur, lend) = lc.Leaf()->str.BeginAndEnd();
+                lc.Next();
+            }
+            if(rcur == rend)
+            {
+                std::tie(rcur, rend) = rc.Leaf()->str.BeginAndEnd();
+                rc.Next();
+            }
+
+            size_t n = (std::min)(lend - lcur, rend - rcur);
+            if(!std::equal(lcur, lcur + n, rcur))
+                return false;
+            lcur += n;
+            rcur += n;
+        }
+    }
+
+    bool operator!=(const Self &rhs) const { return !(*this == rhs); }
+};
+
+template<typename CS>
+Rope<CS> operator+(const Rope<CS> &lhs, const Rope<CS> &rhs)
+{
+    return Rope<CS>(lhs).Append(rhs);
+}
+
+} // namespace AGZ::StrImpl
+
+namespace AGZ {
+
+//! @copydoc StrImpl::Rope<CS>
+template<typename CS>
+using Rope = StrImpl::Rope<CS>;
+
+using Rope8  = Rope<UTF8<>>;
+using Rope16 = Rope<UTF16<>>;
+using Rope32 = Rope<UTF32<>>;
+using ARope  = Rope<ASCII<>>;
+using WRope  = Rope<WUTF>;
+using PRope  = Rope<PUTF>;
+
+} // namespace AGZ
@@ -1,11 +1,23 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <limits>
+#include <optional>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(AGZ_USE_SSE2)
+#include <emmintrin.h>
+#endif
+
 #include "../../Misc/Exception.h"
+#include "../../Range/Iterator.h"
+#include "../../Time/Clock.h"
+#include "../NumConv.h"
 #include "String.h"
 
 namespace AGZ::StrAlgo {
@@ -69,17 +81,710 @@ const unsigned char *BoyerMooreHorspool(const unsigned char *beg,
     return end;
 }
 
-// Boyer-Moore-Horspool ALgorithm
+// Substring searcher with a preprocessed pattern.
+//
+// The pattern is preprocessed once at construction, so one searcher can be
+// reused across any number of haystacks. Patterns no longer than
+// SIMD_PATTERN_LENGTH code units are located with an SSE2 first/last code unit
+// filter when AGZ_USE_SSE2 is defined; all other patterns use
+// Boyer-Moore-Horspool with a skip table keyed by the low byte of code units.
+//
+// Only pointers to the pattern are kept, so the pattern must outlive the
+// searcher.
+template<typename CU>
+class Searcher
+{
+    using UCU = CharsetAux::UnsignedCU<CU>;
+
+    const CU *pbeg_;
+    size_t pLen_;
+    bool useSIMD_;
+
+    // shift distances of Boyer-Moore-Horspool, unused by the SIMD filter
+    size_t skip_[256];
+
+    static size_t Key(CU cu) noexcept
+    {
+        return static_cast<UCU>(cu) & 0xff;
+    }
+
+    bool MatchAt(const CU *p) const noexcept
+    {
+        return !std::memcmp(p, pbeg_, pLen_ * sizeof(CU));
+    }
+
+    const CU *FindBMH(const CU *beg, const CU *end) const noexcept
+    {
+        size_t last = pLen_ - 1;
+        CU lastCU = pbeg_[last];
+        for(const CU *p = beg, *stop = end - last; p < stop;)
+        {
+            CU c = p[last];
+            if(c == lastCU && !std::memcmp(p, pbeg_, last * sizeof(CU)))
+                return p;
+            p += skip_[Key(c)];
+        }
+        return end;
+    }
+
+#if defined(AGZ_USE_SSE2)
+
+    static __m128i Broadcast(CU cu) noexcept
+    {
+        if constexpr(sizeof(CU) == 1)
+            return _mm_set1_epi8(static_cast<char>(cu));
+        else if constexpr(sizeof(CU) == 2)
+            return _mm_set1_epi16(static_cast<short>(cu));
+        else
+            return _mm_set1_epi32(static_cast<int>(cu));
+    }
+
+    static __m128i CmpEq(__m128i a, __m128i b) noexcept
+    {
+        if constexpr(sizeof(CU) == 1)
+            return _mm_cmpeq_epi8(a, b);
+        else if constexpr(sizeof(CU) == 2)
+            return _mm_cmpeq_epi16(a, b);
+        else
+            return _mm_cmpeq_epi32(a, b);
+    }
+
+    static int LowestBit(unsigned int mask) noexcept
+    {
+#if defined(AGZ_CC_MSVC)
+        unsigned long ret;
+        _BitScanForward(&ret, mask);
+        return static_cast<int>(ret);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // Compare 16 bytes of candidate positions against the first and the last
+    // code unit of the pattern at once, and verify only those matching both.
+    // See http://0x80.pl/articles/simd-strfind.html
+    const CU *FindSIMD(const CU *beg, const CU *end) const noexcept
+    {
+        constexpr size_t STEP = 16 / sizeof(CU);
+        constexpr unsigned int CU_BITS = (1u << sizeof(CU)) - 1;
+
+        size_t last = pLen_ - 1;
+        const __m128i first = Broadcast(pbeg_[0]);
+        const __m128i lastv = Broadcast(pbeg_[last]);
+
+        const CU *p = beg;
+        for(; static_cast<size_t>(end - p) >= last + STEP; p += STEP)
+        {
+            __m128i bf = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i bl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + last));
+            auto mask = static_cast<unsigned int>(
+                _mm_movemask_epi8(_mm_and_si128(CmpEq(bf, first), CmpEq(bl, lastv))));
+            while(mask)
+            {
+                size_t k = static_cast<size_t>(LowestBit(mask)) / sizeof(CU);
+                if(MatchAt(p + k))
+                    return p + k;
+                mask &= ~(CU_BITS << (k * sizeof(CU)));
+            }
+        }
+
+        for(; static_cast<size_t>(end - p) >= pLen_; ++p)
+        {
+            if(*p == pbeg_[0] && MatchAt(p))
+                return p;
+        }
+        return end;
+    }
+
+#endif
+
+public:
+
+    static constexpr size_t SIMD_PATTERN_LENGTH = 32;
+
+    Searcher(const CU *pbeg, const CU *pend)
+        : pbeg_(pbeg), pLen_(static_cast<size_t>(pend - pbeg))
+    {
+        AGZ_ASSERT(pbeg <= pend);
+
+#if defined(AGZ_USE_SSE2)
+        useSIMD_ = (sizeof(CU) == 1 || sizeof(CU) == 2 || sizeof(CU) == 4)
+                && pLen_ <= SIMD_PATTERN_LENGTH;
+#else
+        useSIMD_ = false;
+#endif
+
+        if(!useSIMD_ && pLen_)
+        {
+            // colliding keys keep the smallest shift, which is always safe
+            size_t pLenM1 = pLen_ - 1;
+            for(auto &v : skip_)
+                v = pLen_;
+            for(size_t i = 0; i < pLenM1; ++i)
+                skip_[Key(pbeg_[i])] = pLenM1 - i;
+        }
+    }
+
+    Searcher(const Searcher<CU> &copyFrom) noexcept
+    {
+        *this = copyFrom;
+    }
+
+    // skip_ is left uninitialized when the SIMD filter is used
+    Searcher<CU> &operator=(const Searcher<CU> &copyFrom) noexcept
+    {
+        pbeg_    = copyFrom.pbeg_;
+        pLen_    = copyFrom.pLen_;
+        useSIMD_ = copyFrom.useSIMD_;
+        if(!useSIMD_)
+            std::memcpy(skip_, copyFrom.skip_, sizeof(skip_));
+        return *this;
+    }
+
+    size_t GetPatternLength() const noexcept
+    {
+        return pLen_;
+    }
+
+    // Returns the first occurrence of the pattern in [beg, end), or end if
+    // there is none. An empty pattern matches at beg.
+    const CU *Find(const CU *beg, const CU *end) const noexcept
+    {
+        AGZ_ASSERT(beg <= end);
+
+        if(static_cast<size_t>(end - beg) < pLen_)
+            return end;
+        if(!pLen_)
+            return beg;
+
+#if defined(AGZ_USE_SSE2)
+        if(useSIMD_)
+        {
+            if constexpr(sizeof(CU) == 1 || sizeof(CU) == 2 || sizeof(CU) == 4)
+                return FindSIMD(beg, end);
+        }
+#endif
+        return FindBMH(beg, end);
+    }
+};
+
 template<typename CU>
 const CU *FindSubPattern(const CU *beg, const CU *end,
                          const CU *pbeg, const CU *pend)
 {
-    return reinterpret_cast<const CU*>(
-            BoyerMooreHorspool<sizeof(CU)>(
-                reinterpret_cast<const unsigned char*>(beg),
-                reinterpret_cast<const unsigned char*>(end),
-                reinterpret_cast<const unsigned char*>(pbeg),
-                reinterpret_cast<const unsigned char*>(pend)));
+    return Searcher<CU>(pbeg, pend).Find(beg, end);
+}
+
+// Delimiter for SplitRange: any single code unit satisfying Pred.
+template<typename CU, typename Pred>
+struct SplitByPred
+{
+    Pred pred;
+
+    std::pair<const CU*, const CU*> operator()(const CU *beg, const CU *end) const
+    {
+        const CU *p = std::find_if(beg, end, pred);
+        return { p, p == end ? end : p + 1 };
+    }
+};
+
+// Delimiter for SplitRange: occurrences of a non-empty pattern. Only a pointer
+// to the pattern is kept, so the pattern must outlive the split range.
+//
+// A Searcher is not used here since its skip table would be copied along
+// with every iterator; separators are short, and basic_string_view::find
+// already scans for the first code unit with memchr-like routines.
+template<typename CU>
+struct SplitBySubstr
+{
+    const CU *pbeg = nullptr;
+    size_t plen    = 0;
+
+    std::pair<const CU*, const CU*> operator()(const CU *beg, const CU *end) const
+    {
+        AGZ_ASSERT(plen);
+        size_t pos = std::basic_string_view<CU>(beg, end - beg)
+                        .find(std::basic_string_view<CU>(pbeg, plen));
+        if(pos == std::basic_string_view<CU>::npos)
+            return { end, end };
+        return { beg + pos, beg + pos + plen };
+    }
+};
+
+// Lazy range of the tokens of [beg, end) separated by delimiters.
+//
+// Delim returns the first delimiter in [beg, end) as a pair of pointers, or
+// (end, end) if there is none. Token turns the code units of one token into
+// the value type of the range, e.g. a string view.
+//
+// Tokens are found one at a time as the iterator advances and nothing is
+// allocated. Iterators carry their own copies of Delim and Token instead of
+// pointing back to the range, so they stay valid after the range is moved
+// into a Range adaptor such as Filter, Map or Take.
+//
+// Same as the eager Split functions, a token only starts before end: a
+// trailing delimiter never produces an empty last token.
+template<typename CU, typename Delim, typename Token>
+class SplitRange
+{
+    struct Funcs
+    {
+        Delim delim;
+        Token token;
+    };
+
+    const CU *beg_;
+    const CU *end_;
+    bool removeEmpty_;
+    Funcs funcs_;
+
+public:
+
+    class Iterator
+    {
+        friend class SplitRange;
+
+        const CU *tokBeg_ = nullptr;
+        const CU *tokEnd_ = nullptr;
+        const CU *next_   = nullptr;
+        const CU *end_    = nullptr;
+        bool removeEmpty_ = true;
+
+        // optional, so that iterators are default constructible and copy
+        // assignable even if Delim or Token is a lambda
+        std::optional<Funcs> funcs_;
+
+        Iterator(const CU *beg, const CU *end, const Funcs &funcs, bool removeEmpty)
+            : next_(beg), end_(end), removeEmpty_(removeEmpty), funcs_(funcs)
+        {
+            Advance();
+        }
+
+        void Advance()
+        {
+            while(next_ < end_)
+            {
+                auto [delimBeg, delimEnd] = funcs_->delim(next_, end_);
+                AGZ_ASSERT(delimBeg < delimEnd || delimBeg == end_);
+
+                tokBeg_ = next_;
+                tokEnd_ = delimBeg;
+                next_   = delimEnd;
+                if(tokBeg_ != tokEnd_ || !removeEmpty_)
+                    return;
+            }
+            tokBeg_ = tokEnd_ = nullptr;
+        }
+
+    public:
+
+        using value_type        = decltype(std::declval<const Token&>()(
+                                    std::declval<const CU*>(), std::declval<const CU*>()));
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = ValuePointer<value_type>;
+        using reference         = value_type;
+        using iterator_category = std::forward_iterator_tag;
+
+        Iterator() = default;
+
+        Iterator(const Iterator &copyFrom)
+            : tokBeg_(copyFrom.tokBeg_), tokEnd_(copyFrom.tokEnd_),
+              next_(copyFrom.next_), end_(copyFrom.end_),
+              removeEmpty_(copyFrom.removeEmpty_), funcs_(copyFrom.funcs_)
+        {
+
+        }
+
+        Iterator &operator=(const Iterator &copyFrom)
+        {
+            if(this != &copyFrom)
+            {
+                tokBeg_      = copyFrom.tokBeg_;
+                tokEnd_      = copyFrom.tokEnd_;
+                next_        = copyFrom.next_;
+                end_         = copyFrom.end_;
+                removeEmpty_ = copyFrom.removeEmpty_;
+                funcs_.reset();
+                if(copyFrom.funcs_)
+                    funcs_.emplace(*copyFrom.funcs_);
+            }
+            return *this;
+        }
+
+        value_type operator*() const
+        {
+            return funcs_->token(tokBeg_, tokEnd_);
+        }
+
+        pointer operator->() const
+        {
+            return pointer(**this);
+        }
+
+        Iterator &operator++()
+        {
+            Advance();
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        // the end iterator has null token pointers
+        bool operator==(const Iterator &rhs) const noexcept
+        {
+            return tokBeg_ == rhs.tokBeg_ && tokEnd_ == rhs.tokEnd_;
+        }
+
+        bool operator!=(const Iterator &rhs) const noexcept
+        {
+            return !(*this == rhs);
+        }
+    };
+
+    SplitRange(const CU *beg, const CU *end, Delim delim, Token token,
+               bool removeEmpty = true)
+        : beg_(beg), end_(end), removeEmpty_(removeEmpty),
+          funcs_{ std::move(delim), std::move(token) }
+    {
+        AGZ_ASSERT(beg <= end);
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(beg_, end_, funcs_, removeEmpty_);
+    }
+
+    Iterator end() const
+    {
+        return Iterator();
+    }
+};
+
+// Aho-Corasick automaton matching many patterns in one pass.
+// See https://en.wikipedia.org/wiki/Aho–Corasick_algorithm
+//
+// Code units occurring in any pattern are numbered as character classes and
+// all other code units share class 0, so every state needs only one dense
+// row of (class count) transitions. Failure links are folded into the rows
+// when the automaton is built, so matching takes exactly one table lookup
+// per code unit of the haystack.
+//
+// Matches are reported in the order of their end positions; matches ending
+// at the same position are reported from the longest to the shortest.
+// Overlapping matches are all reported.
+template<typename CU>
+class AhoCorasick
+{
+    using UCU = CharsetAux::UnsignedCU<CU>;
+
+    static constexpr uint32_t NONE = (std::numeric_limits<uint32_t>::max)();
+
+    // classes of code units less than DIRECT_CLASS_COUNT are looked up
+    // directly, the others by binary search in wideClasses_, which holds
+    // only the wide code units occurring in the patterns
+    static constexpr size_t DIRECT_CLASS_COUNT = 256;
+
+    std::vector<uint32_t> directClasses_;
+    std::vector<std::pair<UCU, uint32_t>> wideClasses_;
+    size_t classCount_ = 1;
+
+    std::vector<uint32_t> delta_;     // stateCount * classCount_
+    std::vector<uint32_t> outBeg_;    // stateCount + 1, own patterns of state s are outIDs_[outBeg_[s], outBeg_[s + 1])
+    std::vector<uint32_t> outIDs_;
+    std::vector<uint32_t> dictLink_;  // nearest state on the failure chain having own patterns
+    std::vector<size_t> patternLengths_;
+
+    uint64_t buildMicroseconds_ = 0;
+
+    uint32_t ClassOf(CU cu) const noexcept
+    {
+        auto u = static_cast<UCU>(cu);
+        if(u < DIRECT_CLASS_COUNT)
+            return directClasses_[u];
+        auto it = std::lower_bound(wideClasses_.begin(), wideClasses_.end(), u,
+            [](const std::pair<UCU, uint32_t> &lhs, UCU rhs) { return lhs.first < rhs; });
+        return it != wideClasses_.end() && it->first == u ? it->second : 0;
+    }
+
+    uint32_t Step(uint32_t state, CU cu) const noexcept
+    {
+        return delta_[state * classCount_ + ClassOf(cu)];
+    }
+
+    // first state with own patterns among state and its dictionary links
+    uint32_t FirstOutput(uint32_t state) const noexcept
+    {
+        return outBeg_[state] != outBeg_[state + 1] ? state : dictLink_[state];
+    }
+
+    void Build(const std::vector<std::vector<CU>> &patterns);
+
+public:
+
+    struct Match
+    {
+        size_t patternID; // index of the pattern in the construction order
+        size_t position;  // index of the first matched code unit
+        size_t length;    // number of matched code units
+    };
+
+    class MatchIterator
+    {
+        const AhoCorasick<CU> *ac_;
+        const CU *beg_, *cur_, *end_;
+        uint32_t state_, outState_, outIdx_;
+        Match match_;
+
+        void Advance() noexcept
+        {
+            for(;;)
+            {
+                if(outState_ != NONE)
+                {
+                    if(outIdx_ < ac_->outBeg_[outState_ + 1])
+                    {
+                        size_t id = ac_->outIDs_[outIdx_++];
+                        size_t len = ac_->patternLengths_[id];
+                        match_ = { id, static_cast<size_t>(cur_ - beg_) - len, len };
+                        return;
+                    }
+                    outState_ = ac_->dictLink_[outState_];
+                    if(outState_ != NONE)
+                        outIdx_ = ac_->outBeg_[outState_];
+                    continue;
+                }
+
+                if(cur_ == end_)
+                {
+                    ac_ = nullptr;
+                    return;
+                }
+
+                state_ = ac_->Step(state_, *cur_++);
+                outState_ = ac_->FirstOutput(state_);
+                if(outState_ != NONE)
+                    outIdx_ = ac_->outBeg_[outState_];
+            }
+        }
+
+    public:
+
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = Match;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const Match*;
+        using reference         = const Match&;
+
+        MatchIterator() noexcept
+            : ac_(nullptr), beg_(nullptr), cur_(nullptr), end_(nullptr),
+              state_(0), outState_(NONE), outIdx_(0), match_()
+        {
+
+        }
+
+        MatchIterator(const AhoCorasick<CU> *ac, const CU *beg, const CU *end) noexcept
+            : ac_(ac), beg_(beg), cur_(beg), end_(end),
+              state_(0), outState_(NONE), outIdx_(0), match_()
+        {
+            Advance();
+        }
+
+        reference operator*() const noexcept { return match_; }
+        pointer operator->() const noexcept { return &match_; }
+
+        MatchIterator &operator++() noexcept
+        {
+            Advance();
+            return *this;
+        }
+
+        MatchIterator operator++(int) noexcept
+        {
+            auto ret = *this;
+            Advance();
+            return ret;
+        }
+
+        bool operator==(const MatchIterator &rhs) const noexcept
+        {
+            if(!ac_ || !rhs.ac_)
+                return ac_ == rhs.ac_;
+            return cur_ == rhs.cur_ && outState_ == rhs.outState_ && outIdx_ == rhs.outIdx_;
+        }
+
+        bool operator!=(const MatchIterator &rhs) const noexcept
+        {
+            return !(*this == rhs);
+        }
+    };
+
+    class MatchRange
+    {
+        MatchIterator beg_;
+
+    public:
+
+        explicit MatchRange(MatchIterator beg) noexcept : beg_(beg) { }
+
+        MatchIterator begin() const noexcept { return beg_; }
+        MatchIterator end()   const noexcept { return MatchIterator(); }
+    };
+
+    // Each element of patterns is a non-empty sequence of code units
+    // providing std::begin/std::end, e.g. String<CS> or std::basic_string<CU>.
+    // Throws ArgumentException on empty patterns.
+    template<typename R>
+    explicit AhoCorasick(const R &patterns)
+    {
+        std::vector<std::vector<CU>> ps;
+        for(auto &p : patterns)
+        {
+            ps.emplace_back(std::begin(p), std::end(p));
+            if(ps.back().empty())
+                throw ArgumentException("Empty pattern in AhoCorasick");
+        }
+        Build(ps);
+    }
+
+    // All matches in [beg, end), see MatchIterator.
+    MatchRange Matches(const CU *beg, const CU *end) const noexcept
+    {
+        return MatchRange(MatchIterator(this, beg, end));
+    }
+
+    // Whether any pattern occurs in [beg, end). Stops at the first match.
+    bool MatchAny(const CU *beg, const CU *end) const noexcept
+    {
+        uint32_t state = 0;
+        for(; beg < end; ++beg)
+        {
+            state = Step(state, *beg);
+            if(FirstOutput(state) != NONE)
+                return true;
+        }
+        return false;
+    }
+
+    size_t GetPatternCount() const noexcept { return patternLengths_.size(); }
+
+    size_t GetStateCount() const noexcept { return dictLink_.size(); }
+
+    // number of character classes, including the class of code units
+    // occurring in no pattern
+    size_t GetClassCount() const noexcept { return classCount_; }
+
+    // bytes allocated by the automaton
+    size_t GetMemoryUsage() const noexcept
+    {
+        return sizeof(*this)
+             + directClasses_.capacity()  * sizeof(uint32_t)
+             + wideClasses_.capacity()    * sizeof(std::pair<UCU, uint32_t>)
+             + delta_.capacity()          * sizeof(uint32_t)
+             + outBeg_.capacity()         * sizeof(uint32_t)
+             + outIDs_.capacity()         * sizeof(uint32_t)
+             + dictLink_.capacity()       * sizeof(uint32_t)
+             + patternLengths_.capacity() * sizeof(size_t);
+    }
+
+    // time spent building the automaton
+    uint64_t GetBuildMicroseconds() const noexcept { return buildMicroseconds_; }
+};
+
+template<typename CU>
+void AhoCorasick<CU>::Build(const std::vector<std::vector<CU>> &patterns)
+{
+    Clock clock;
+
+    // Number character classes
+
+    directClasses_.assign(DIRECT_CLASS_COUNT, 0);
+    std::vector<UCU> wides;
+    for(auto &p : patterns)
+    {
+        for(CU cu : p)
+        {
+            auto u = static_cast<UCU>(cu);
+            if(u >= DIRECT_CLASS_COUNT)
+                wides.push_back(u);
+            else if(!directClasses_[u])
+                directClasses_[u] = static_cast<uint32_t>(classCount_++);
+        }
+    }
+    std::sort(wides.begin(), wides.end());
+    wides.erase(std::unique(wides.begin(), wides.end()), wides.end());
+    for(UCU u : wides)
+        wideClasses_.emplace_back(u, static_cast<uint32_t>(classCount_++));
+
+    // Build the trie. 0 marks a missing edge as no edge leads back to the root
+
+    std::vector<std::vector<uint32_t>> ownOutputs(1);
+    delta_.assign(classCount_, 0);
+    for(size_t id = 0; id < patterns.size(); ++id)
+    {
+        uint32_t state = 0;
+        for(CU cu : patterns[id])
+        {
+            size_t edge = state * classCount_ + ClassOf(cu);
+            if(!delta_[edge])
+            {
+                delta_[edge] = static_cast<uint32_t>(ownOutputs.size());
+                ownOutputs.emplace_back();
+                delta_.resize(delta_.size() + classCount_, 0);
+            }
+            state = delta_[edge];
+        }
+        ownOutputs[state].push_back(static_cast<uint32_t>(id));
+        patternLengths_.push_back(patterns[id].size());
+    }
+
+    // Compute failure links in BFS order and fold them into the transition rows
+
+    size_t stateCount = ownOutputs.size();
+    std::vector<uint32_t> fail(stateCount, 0);
+    dictLink_.assign(stateCount, NONE);
+
+    std::vector<uint32_t> queue;
+    queue.reserve(stateCount);
+    for(size_t c = 0; c < classCount_; ++c)
+    {
+        if(uint32_t t = delta_[c])
+            queue.push_back(t);
+    }
+
+    for(size_t head = 0; head < queue.size(); ++head)
+    {
+        uint32_t s = queue[head];
+        uint32_t *row = &delta_[s * classCount_];
+        const uint32_t *failRow = &delta_[fail[s] * classCount_];
+        for(size_t c = 0; c < classCount_; ++c)
+        {
+            if(uint32_t t = row[c])
+            {
+                fail[t] = failRow[c];
+                dictLink_[t] = !ownOutputs[fail[t]].empty() ? fail[t] : dictLink_[fail[t]];
+                queue.push_back(t);
+            }
+            else
+                row[c] = failRow[c];
+        }
+    }
+
+    // Flatten output lists
+
+    outBeg_.reserve(stateCount + 1);
+    for(auto &o : ownOutputs)
+    {
+        outBeg_.push_back(static_cast<uint32_t>(outIDs_.size()));
+        outIDs_.insert(outIDs_.end(), o.begin(), o.end());
+    }
+    outBeg_.push_back(static_cast<uint32_t>(outIDs_.size()));
+
+    buildMicroseconds_ = clock.Microseconds();
 }
 
 enum class CompareResult { Greater, Equal, Less };
@@ -105,56 +810,23 @@ template<typename T, typename CS,
          std::enable_if_t<std::is_integral_v<T>, int> = 0>
     String<CS> Int2Str(T v, unsigned int base)
 {
-    // IMPROVE
-
     AGZ_ASSERT(2 <= base && base <= 36);
-    std::vector<typename CS::CodeUnit> cus;
 
-    [[maybe_unused]]
-    bool neg = false;
-
-    // Handle negative sign
-    if constexpr(std::is_signed_v<T>)
-    {
-        // Corner case ignored: v == numeric_limits<T>::min()
-        if(v < 0)
-        {
-            neg = true;
-            v = ~v + 1;
-        }
-    }
+    using CU = typename CS::CodeUnit;
+    CU buf[MAX_INT_CHARS];
+    CU *end = ToChars(v, buf, static_cast<int>(base));
 
-    if(!v)
-        cus.push_back('0');
-    else
+    // Digits above 9 are written in upper case
+    if(base > 10)
     {
-        while(v)
+        for(CU *p = buf; p != end; ++p)
         {
-            static const char chs[36] =
-            {
-                '0', '1', '2', '3', '4',
-                '5', '6', '7', '8', '9',
-                'A', 'B', 'C', 'D', 'E',
-                'F', 'G', 'H', 'I', 'J',
-                'K', 'L', 'M', 'N', 'O',
-                'P', 'Q', 'R', 'S', 'T',
-                'U', 'V', 'W', 'X', 'Y',
-                'Z'
-            };
-            auto d = v % base;
-            v      = v / base;
-            cus.push_back(chs[d]);
+            if(CU('a') <= *p && *p <= CU('z'))
+                *p = static_cast<CU>(*p - 'a' + 'A');
         }
     }
 
-    if constexpr(std::is_signed_v<T>)
-    {
-        if(neg)
-            cus.push_back('-');
-    }
-
-    std::reverse(std::begin(cus), std::end(cus));
-    return String<CS>(cus.data(), cus.size());
+    return String<CS>(buf, end);
 }
 
 // < 10    : digit
@@ -255,19 +927,24 @@ struct Str2IntImpl
         if(cur == end || (*c++ == '0' && c != end))
             throw ArgumentException("Parsing error in Str2Int");
 
-        T ret = T(0);
+        // Accumulate the magnitude as unsigned so that numeric_limits<T>::min() is representable
+        using U = std::make_unsigned_t<T>;
+        const U limit = neg ? static_cast<U>(static_cast<U>((std::numeric_limits<T>::max)()) + 1)
+                            : static_cast<U>((std::numeric_limits<T>::max)());
+
+        U ret = U(0);
         while(cur != end)
         {
             auto cp = *cur++;
             if(cp < 0 || cp >= 128 || DIGIT_CHAR_VALUE_TABLE[cp] >= base)
                 throw ArgumentException("Parsing error in Str2Int");
-            ret = base * ret + DIGIT_CHAR_VALUE_TABLE[cp];
+            U d = DIGIT_CHAR_VALUE_TABLE[cp];
+            if(ret > (limit - d) / base)
+                throw ArgumentException("Parsing error in Str2Int: value out of range");
+            ret = static_cast<U>(base * ret + d);
         }
 
-        if constexpr(std::is_signed_v<T>)
-            return neg ? -ret : ret;
-        else
-            return ret;
+        return neg ? static_cast<T>(static_cast<U>(U(0) - ret)) : static_cast<T>(ret);
     }
 };
 
@@ -9,10 +9,25 @@
 #include <vector>
 
 #include "../../Misc/Common.h"
+#include "../../Misc/Hash.h"
 #include "../../Range/Iterator.h"
 #include "../../Utils/Serialize.h"
 #include "../Charset/ASCII.h"
 #include "../Charset/UTF.h"
+#include "../NumConv.h"
+
+namespace AGZ::StrAlgo {
+
+template<typename CU>
+class Searcher;
+
+template<typename CU, typename Pred>
+struct SplitByPred;
+
+template<typename CU, typename Delim, typename Token>
+class SplitRange;
+
+} // namespace AGZ::StrAlgo
 
 namespace AGZ::StrImpl {
 
@@ -25,24 +40,70 @@ enum class NativeCharset
     WUTF, ///< for const wchar_t * / std::wstring
 };
 
+/**
+ * @brief 字符串缓存的分配来源，参见 AGZ::StringArena
+ *
+ * 当前线程设置了分配来源时，新创建的 RefCountedBuf 都从中分配。这样的缓存不会被单独释放，而是由分配来源统一回收
+ */
+class StringBufSource
+{
+public:
+
+    /** 分配size字节、对齐到align的内存，失败时抛出std::bad_alloc */
+    virtual void *AllocStringBuf(size_t size, size_t align) = 0;
+
+protected:
+
+    ~StringBufSource() = default;
+};
+
+/**
+ * @brief 当前线程的字符串缓存分配来源，为nullptr时使用全局堆
+ */
+inline StringBufSource *&CurrentStringBufSource() noexcept
+{
+    static thread_local StringBufSource *source = nullptr;
+    return source;
+}
+
 /**
  * @brief 使用引用计数的缓存块
  */
 template<typename E>
 class RefCountedBuf
 {
+    // 引用计数的最高位标记缓存来自 StringBufSource，此时计数归零也不释放内存
+    static constexpr size_t FROM_SOURCE = size_t(1) << (sizeof(size_t) * 8 - 1);
+
 #if defined(AGZ_THREAD_SAFE_STRING)
     std::atomic<size_t> refs_;
 #else
     size_t refs_;
 #endif
+    // 常量字符串可能被多个线程同时求哈希值，因此总是以relaxed原子操作读写缓存的哈希值
+    mutable std::atomic<size_t> hash_;
+    size_t len_;
     E data_[1];
 
 public:
 
-    /** 创建一块含有n个可用字节的引用计数缓存 */
+    /** 创建一块含有n个可用字节的引用计数缓存。当前线程设置了 StringBufSource 时从中分配 */
     static RefCountedBuf<E> *New(size_t n);
 
+    /**
+     * @brief 将缓存的元素数量改为n，原有的前min(n, GetLength())个元素被保留
+     *
+     * 前置条件：buf的引用计数为1。buf会失效，应改用返回的指针
+     */
+    static RefCountedBuf<E> *Resize(RefCountedBuf<E> *buf, size_t n);
+
+    /**
+     * @brief 将缓存的元素数量减少为n，不释放多余的内存
+     *
+     * 前置条件：引用计数为1，n <= GetLength()
+     */
+    void Truncate(size_t n);
+
     /** 不允许默认构造，只能通过 RefCountedBuf<E>::New 来创建 */
     RefCountedBuf()                                      = delete;
     /** 不允许复制，只能通过指针共享 */
@@ -58,12 +119,28 @@ public:
     void DecRef();
 
     /** 取得引用计数数量 */
-    size_t GetRefCount() const { return refs_; }
+    size_t GetRefCount() const { return refs_ & ~FROM_SOURCE; }
+
+    /** 是否由 StringBufSource 分配 */
+    bool IsFromSource() const { return (refs_ & FROM_SOURCE) != 0; }
 
     /** 取得缓存区域指针 */
     E *GetData();
     /** 取得缓存区域指针 */
     const E *GetData() const;
+
+    /** 取得创建时指定的元素数量 */
+    size_t GetLength() const { return len_; }
+
+    /**
+     * @brief 取得整个缓存区域内容的哈希值，第一次调用时计算并缓存
+     *
+     * 共享同一缓存的字符串只需计算一次哈希值
+     */
+    size_t GetHash() const;
+
+    /** 缓存区域被修改后，丢弃已缓存的哈希值 */
+    void ResetHash();
 };
 
 /**
@@ -74,8 +151,13 @@ public:
 template<typename CU>
 class Storage
 {
+public:
+
+    //! 能存储在栈上的最大码元数量
     static constexpr size_t SMALL_BUF_SIZE = 31 / sizeof(CU);
 
+private:
+
     using LargeBuf = RefCountedBuf<CU>;
 
     union
@@ -126,6 +208,8 @@ public:
     Storage(const CU *data, size_t len);
     //! 准备合适长度的缓存，保存[beg, end)间的内容
     Storage(const CU *beg, const CU *end);
+    //! 接管buf的一个引用，内容为整个缓存区域
+    explicit Storage(LargeBuf *buf);
 
     /**
      * 复制copyFrom的内容。若copyFrom长度较小，则逐字节拷贝数据；否则共享引用计数
@@ -157,6 +241,9 @@ public:
     std::pair<const CU*, size_t> BeginAndLength() const;
     //! 同时取得首元素地址和末元素下一个元素的地址
     std::pair<const CU*, const CU*> BeginAndEnd() const;
+
+    //! 内容的哈希值。若内容恰好占据整个引用计数缓存，则使用缓存中记录的结果
+    size_t GetHash() const;
 };
 
 /**
@@ -184,6 +271,7 @@ public:
     explicit Storage_NoSSO(size_t len);
     Storage_NoSSO(const CU *data, size_t len);
     Storage_NoSSO(const CU *beg, const CU *end);
+    explicit Storage_NoSSO(Buf *buf);
 
     Storage_NoSSO(const Self &copyFrom);
     Storage_NoSSO(const Self &copyFrom, size_t begIdx, size_t endIdx);
@@ -201,11 +289,16 @@ public:
 
     std::pair<const CU*, size_t> BeginAndLength() const;
     std::pair<const CU*, const CU*> BeginAndEnd() const;
+
+    size_t GetHash() const;
 };
 
 template<typename CS, typename Eng>
 class Regex;
 
+template<typename CS>
+class Rope;
+
 template<typename CS>
 class StringBuilder;
 
@@ -307,6 +400,8 @@ public:
 template<typename CS>
 class StringView
 {
+    friend class Rope<CS>;
+
     const String<CS> *str_;
     const typename CS::CodeUnit *beg_;
     size_t len_;
@@ -354,7 +449,11 @@ public:
     template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
     T Parse(unsigned base = 10) const;
 
-    //! 转换为指定类型的浮点数
+    /**
+     * @brief 转换为指定类型的浮点数，格式参见 AGZ::FromChars
+     *
+     * @exception ArgumentException 不是合法的浮点数或超出表示范围时抛出
+     */
     template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
     T Parse() const;
 
@@ -437,6 +536,40 @@ public:
                          typename = std::void_t<decltype(std::declval<C>().begin())>>
     std::vector<Self> Split(const C &spliters) const;
 
+    //! 惰性拆分时用于将一段码元转换为视图
+    struct SplitToken
+    {
+        const Str *str = nullptr;
+        Self operator()(const CodeUnit *beg, const CodeUnit *end) const { return Self(*str, beg, end - beg); }
+    };
+
+    //! 惰性拆分时用于判断空白字符
+    struct IsSpaceCU
+    {
+        bool operator()(CodeUnit cu) const { return CS::IsSpace(cu); }
+    };
+
+    //! 惰性拆分时用于查找分隔符，持有分隔符的一份共享拷贝
+    struct SpliterDelim
+    {
+        Str spliter;
+        std::pair<const CodeUnit*, const CodeUnit*> operator()(const CodeUnit *beg, const CodeUnit *end) const;
+    };
+
+    using WhitespaceSplitRange = StrAlgo::SplitRange<CodeUnit, StrAlgo::SplitByPred<CodeUnit, IsSpaceCU>, SplitToken>;
+    using SpliterSplitRange    = StrAlgo::SplitRange<CodeUnit, SpliterDelim, SplitToken>;
+
+    /**
+     * @brief 以空白字符为分隔符惰性地拆分此串
+     *
+     * 结果与 Split() 相同，但子串在遍历时才被逐个找出，且不分配内存，可以和Range中的 Filter、Map、Take 等组合使用
+     */
+    WhitespaceSplitRange LazySplit() const;
+    //! 以给定的字符串为分隔符惰性地拆分此串，结果与 Split(spliter) 相同
+    SpliterSplitRange LazySplit(const Self &spliter) const;
+    //! 以给定的字符串为分隔符惰性地拆分此串，结果与 Split(spliter) 相同
+    SpliterSplitRange LazySplit(const Str &spliter) const { return LazySplit(spliter.AsView()); }
+
     //! 以自己为分隔符连接一个字符串range中的所有元素
     template<typename R>
     Str Join(R &&strRange) const;
@@ -449,6 +582,14 @@ public:
     size_t Find(const Self &dst, size_t begIdx = 0) const;
     //! @copydoc StringView<CS>::Find(const StringView<CS>&, size_t) const
     size_t Find(const Str &dst, size_t begIdx = 0)  const { return Find(dst.AsView(), begIdx); }
+    /**
+     * @brief 从以begIdx为下标的码元开始，用预处理过的查找器查找子串
+     *
+     * 以同一子串在多处查找时，可只构造一次查找器以避免重复预处理
+     *
+     * @return 查找失败时返回NPOS
+     */
+    size_t Find(const StrAlgo::Searcher<CodeUnit> &searcher, size_t begIdx = 0) const;
 
     /**
      * @brief 查找第一个满足给定谓词的码点的第一个码元的下标
@@ -475,6 +616,9 @@ public:
     //! 转换为string_view
     operator std::string_view() const { return std::string_view(Data(), Length()); }
 
+    //! 哈希值，与内容相同的 String<CS> 的哈希值相等
+    size_t GetHash() const;
+
 #if defined(AGZ_OS_WIN32)
     //! 转换为平台默认使用的字符串
     std::wstring ToPlatformString() const { return ToStdWString(); }
@@ -519,6 +663,7 @@ class String
 
     friend class StringBuilder<CS>;
     friend class StringView<CS>;
+    friend class CharsetConvertor;
 
     InternalStorage storage_;
 
@@ -528,6 +673,9 @@ class String
 
     explicit String(size_t len);
 
+    // 接管buf的一个引用，不复制其内容
+    explicit String(RefCountedBuf<typename CS::CodeUnit> *buf);
+
 public:
 
     using Charset   = CS;                      ///< 字符编码方案
@@ -611,9 +759,9 @@ public:
     /** 见 String<CS>::From(char, unsigned int) */
     static Self From(unsigned long long v, unsigned int base = 10);
 
-    /** 将浮点数转换为字符串 */
+    /** 将浮点数转换为能还原出v的十进制表示（绝大多数情况下最短），参见 AGZ::ToChars */
     static Self From(float v);
-    /** 将浮点数转换为字符串 */
+    /** 见 String<CS>::From(float) */
     static Self From(double v);
 
     /**
@@ -673,9 +821,13 @@ public:
     template<typename C, std::enable_if_t<!std::is_array_v<C>, int> = 0,
                          typename = std::void_t<decltype(std::declval<C>().begin())>>
     std::vector<View> Split(const C &spliters)      const { return AsView().template Split<C>(spliters);     }
+    typename View::WhitespaceSplitRange LazySplit() const { return AsView().LazySplit(); }
+    typename View::SpliterSplitRange LazySplit(const View &spliter) const { return AsView().LazySplit(spliter); }
+    typename View::SpliterSplitRange LazySplit(const Self &spliter) const { return AsView().LazySplit(spliter); }
     template<typename R> Self Join(R &&strRange)    const { return AsView().Join(std::forward<R>(strRange)); }
     size_t Find(const View &dst, size_t begIdx = 0) const { return AsView().Find(dst, begIdx);               }
     size_t Find(const Self &dst, size_t begIdx = 0) const { return AsView().Find(dst, begIdx);               }
+    size_t Find(const StrAlgo::Searcher<CodeUnit> &searcher, size_t begIdx = 0) const { return AsView().Find(searcher, begIdx); }
 
     template<typename F>
     size_t FindCPIf(F &&f) const { return AsView().FindCPIf(std::forward<F>(f)); }
@@ -704,6 +856,9 @@ public:
 
     std::pair<const CodeUnit*, const CodeUnit*> BeginAndEnd() const { return storage_.BeginAndEnd(); }
 
+    //! 哈希值，与内容相同的 StringView<CS> 的哈希值相等。较长的字符串会在共享的缓存中记录计算结果
+    size_t GetHash() const { return storage_.GetHash(); }
+
     //! 将其他字符串追加到末尾
     template<typename RHS>
     Self &operator+=(const RHS &rhs) { return *this = *this + rhs; }
@@ -761,18 +916,43 @@ AGZ_WRAP_STR_COMP(std::wstring&,   StringView<CS>&, String<CS>(lhs),          rh
 
 /**
  * @brief 用于加速大量字符串的拼接
- * 
+ *
+ * 追加的内容被直接写入一块按几何级数增长的连续缓存中。Get 会将这块缓存直接交给返回的字符串，不再复制；
+ * 此后若继续追加，才会在写入前复制一份（写时复制）。
+ *
  * @note 线程不安全
  */
 template<typename CS>
 class StringBuilder
 {
-    mutable std::list<String<CS>> strs_;
+    using CodeUnit = typename CS::CodeUnit;
+    using Buf      = RefCountedBuf<CodeUnit>;
+
+    // 缓存区域的元素数量即容量，[0, len_)中是已追加的内容。引用计数大于1时缓存已被共享，不可修改
+    mutable Buf *buf_ = nullptr;
+    size_t len_       = 0;
+
+    // 确保缓存未被共享且至少能容纳len_ + n个码元，返回写入位置
+    CodeUnit *PrepareAppend(size_t n);
 
 public:
 
     using Self = StringBuilder<CS>;
 
+    StringBuilder() = default;
+    StringBuilder(const Self &copyFrom);
+    StringBuilder(Self &&moveFrom) noexcept;
+
+    ~StringBuilder();
+
+    Self &operator=(const Self &copyFrom);
+    Self &operator=(Self &&moveFrom) noexcept;
+
+    /**
+     * @brief 预留至少能容纳n个码元的空间
+     */
+    void Reserve(size_t n);
+
     /**
      * @brief 将给定视图的内容追加到正在构建的字符串末尾
      * 
@@ -793,14 +973,20 @@ public:
     //! 将给定字符串追加到正在构建的字符串末尾
     Self &operator<<(const String<CS> &view) { return *this << view.AsView(); }
 
-    //! 取得被构建的字符串
+    //! 取得被构建的字符串。缓存未被共享时会直接交给返回值，不复制其内容
     String<CS> Get() const;
 
     //! 是否包含任何正在被构建的字符串
-    bool Empty() const { return strs_.empty(); }
+    bool Empty() const { return !len_; }
+
+    //! 已追加的码元数量
+    size_t Length() const { return len_; }
+
+    //! 不必重新分配缓存就能容纳的码元数量
+    size_t Capacity() const { return buf_ ? buf_->GetLength() : 0; }
 
-    //! 清空正在被构建的字符串
-    void Clear() { strs_.clear(); }
+    //! 清空正在被构建的字符串。缓存未被共享时会被保留
+    void Clear();
 };
 
 /**
@@ -896,10 +1082,7 @@ namespace std
     {
         size_t operator()(const AGZ::String<CS>& s) const noexcept
         {
-            size_t ret = 0;
-            for(size_t i = 0; i < s.Length(); i++)
-                ret = 65599 * ret + s.Data()[i];
-            return ret ^ (ret >> 16);
+            return s.GetHash();
         }
     };
 
@@ -908,10 +1091,7 @@ namespace std
     {
         size_t operator()(const AGZ::StringView<CS>& s) const noexcept
         {
-            size_t ret = 0;
-            for(size_t i = 0; i < s.Length(); i++)
-                ret = 65599 * ret + s.Data()[i];
-            return ret ^ (ret >> 16);
+            return s.GetHash();
         }
     };
 }
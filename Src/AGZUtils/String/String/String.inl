@@ -24,11 +24,56 @@ template<typename E>
 RefCountedBuf<E> *RefCountedBuf<E>::New(size_t n)
 {
     size_t allocSize = (sizeof(RefCountedBuf<E>) - sizeof(E)) + n * sizeof(E);
-    auto *ret = alloc_throw<RefCountedBuf<E>>(std::malloc, allocSize);
-    ret->refs_ = 1;
+    RefCountedBuf<E> *ret;
+    if(auto source = CurrentStringBufSource())
+    {
+        ret = static_cast<RefCountedBuf<E>*>(source->AllocStringBuf(allocSize, alignof(RefCountedBuf<E>)));
+        ret->refs_ = FROM_SOURCE | 1;
+    }
+    else
+    {
+        ret = alloc_throw<RefCountedBuf<E>>(std::malloc, allocSize);
+        ret->refs_ = 1;
+    }
+    ret->hash_.store(0, std::memory_order_relaxed);
+    ret->len_  = n;
     return ret;
 }
 
+template<typename E>
+RefCountedBuf<E> *RefCountedBuf<E>::Resize(RefCountedBuf<E> *buf, size_t n)
+{
+    AGZ_ASSERT(buf->GetRefCount() == 1);
+
+    if(buf->IsFromSource())
+    {
+        // 来自StringBufSource的缓存不能realloc：缩小时原地修改长度，扩大时复制到新缓存，原缓存留待统一回收
+        if(n <= buf->len_)
+        {
+            buf->hash_.store(0, std::memory_order_relaxed);
+            buf->len_  = n;
+            return buf;
+        }
+        auto *ret = New(n);
+        Copy(buf->GetData(), buf->len_, ret->GetData());
+        return ret;
+    }
+
+    size_t allocSize = (sizeof(RefCountedBuf<E>) - sizeof(E)) + n * sizeof(E);
+    auto *ret = alloc_throw<RefCountedBuf<E>>(std::realloc, buf, allocSize);
+    ret->hash_.store(0, std::memory_order_relaxed);
+    ret->len_  = n;
+    return ret;
+}
+
+template<typename E>
+void RefCountedBuf<E>::Truncate(size_t n)
+{
+    AGZ_ASSERT(GetRefCount() == 1 && n <= len_);
+    hash_.store(0, std::memory_order_relaxed);
+    len_ = n;
+}
+
 template<typename E>
 void RefCountedBuf<E>::IncRef()
 {
@@ -40,6 +85,7 @@ void RefCountedBuf<E>::DecRef()
 {
     if(!--refs_)
         std::free(this);
+    // 来自StringBufSource的缓存计数归零后剩下FROM_SOURCE标记，不需要释放
 }
 
 template<typename E>
@@ -54,6 +100,25 @@ const E *RefCountedBuf<E>::GetData() const
     return &data_[0];
 }
 
+template<typename E>
+size_t RefCountedBuf<E>::GetHash() const
+{
+    // 0表示尚未计算。真实哈希值恰好为0时只是每次重新计算，不影响正确性
+    size_t ret = hash_.load(std::memory_order_relaxed);
+    if(!ret)
+    {
+        ret = static_cast<size_t>(HashBytes(GetData(), len_ * sizeof(E)));
+        hash_.store(ret, std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+template<typename E>
+void RefCountedBuf<E>::ResetHash()
+{
+    hash_.store(0, std::memory_order_relaxed);
+}
+
 template<typename CU>
 void Storage<CU>::AllocSmall(size_t len)
 {
@@ -89,8 +154,10 @@ template<typename CU>
 CU *Storage<CU>::GetMutableData()
 {
     AGZ_ASSERT(IsSmallStorage() || large_.buf->GetRefCount() == 1);
-    return IsSmallStorage() ? GetSmallMutableData() :
-                              GetLargeMutableData();
+    if(IsSmallStorage())
+        return GetSmallMutableData();
+    large_.buf->ResetHash();
+    return GetLargeMutableData();
 }
 
 template<typename CU>
@@ -124,6 +191,25 @@ Storage<CU>::Storage(const CU *beg, const CU *end)
 
 }
 
+template<typename CU>
+Storage<CU>::Storage(LargeBuf *buf)
+{
+    size_t len = buf->GetLength();
+    if(len <= SMALL_BUF_SIZE)
+    {
+        AllocSmall(len);
+        Copy(buf->GetData(), len, GetSmallMutableData());
+        buf->DecRef();
+    }
+    else
+    {
+        small_.len = SMALL_BUF_SIZE + 1;
+        large_.buf = buf;
+        large_.beg = buf->GetData();
+        large_.end = large_.beg + len;
+    }
+}
+
 template<typename CU>
 Storage<CU>::Storage(const Self &copyFrom)
     : Storage(copyFrom, 0, copyFrom.GetLength())
@@ -257,6 +343,16 @@ std::pair<const CU*, const CU*> Storage<CU>::BeginAndEnd() const
             { large_.beg, large_.end };
 }
 
+template<typename CU>
+size_t Storage<CU>::GetHash() const
+{
+    if(IsLargeStorage() && large_.beg == large_.buf->GetData() &&
+       GetLargeLength() == large_.buf->GetLength())
+        return large_.buf->GetHash();
+    auto [data, len] = BeginAndLength();
+    return static_cast<size_t>(HashBytes(data, len * sizeof(CU)));
+}
+
 template<typename CU>
 void Storage_NoSSO<CU>::Alloc(size_t len)
 {
@@ -268,6 +364,8 @@ void Storage_NoSSO<CU>::Alloc(size_t len)
 template<typename CU>
 CU *Storage_NoSSO<CU>::GetMutableData()
 {
+    if(buf_)
+        buf_->ResetHash();
     return beg_;
 }
 
@@ -291,6 +389,14 @@ Storage_NoSSO<CU>::Storage_NoSSO(const CU *beg, const CU *end)
 
 }
 
+template<typename CU>
+Storage_NoSSO<CU>::Storage_NoSSO(Buf *buf)
+{
+    buf_ = buf;
+    beg_ = buf->GetData();
+    end_ = beg_ + buf->GetLength();
+}
+
 template<typename CU>
 Storage_NoSSO<CU>::Storage_NoSSO(const Self &copyFrom)
     : Storage_NoSSO(copyFrom, 0, copyFrom.GetLength())
@@ -373,6 +479,14 @@ std::pair<const CU*, const CU*> Storage_NoSSO<CU>::BeginAndEnd() const
     return { beg_, end_ };
 }
 
+template<typename CU>
+size_t Storage_NoSSO<CU>::GetHash() const
+{
+    if(buf_ && beg_ == buf_->GetData() && GetLength() == buf_->GetLength())
+        return buf_->GetHash();
+    return static_cast<size_t>(HashBytes(beg_, GetLength() * sizeof(CU)));
+}
+
 template<typename CS>
 CodePointRange<CS>::CodePointRange(const CodeUnit *beg, const CodeUnit *end)
     : beg_(beg), end_(end)
@@ -530,6 +644,14 @@ const typename CS::CodeUnit *StringView<CS>::Data() const
     return beg_;
 }
 
+template<typename CS>
+size_t StringView<CS>::GetHash() const
+{
+    if(str_->Data() == beg_ && str_->Length() == len_)
+        return str_->GetHash();
+    return static_cast<size_t>(HashBytes(beg_, len_ * sizeof(CodeUnit)));
+}
+
 template<typename CS>
 std::pair<const typename CS::CodeUnit*, size_t>
 StringView<CS>::DataAndLength() const
@@ -556,46 +678,21 @@ T StringView<CS>::Parse(unsigned int base) const
     return StrAlgo::Str2Int<T, CS>(*this, base);
 }
 
-template<typename T>
-struct Str2FloatImpl;
-
-template<>
-struct Str2FloatImpl<float>
-{
-    static float Convert(const std::string &s)
-    {
-        try
-        {
-            return std::stof(s);
-        }
-        catch(const std::exception &err)
-        {
-            throw ArgumentException(err.what());
-        }
-    }
-};
-
-template<>
-struct Str2FloatImpl<double>
-{
-    static double Convert(const std::string &s)
-    {
-        try
-        {
-            return std::stod(s);
-        }
-        catch(const std::exception &err)
-        {
-            throw ArgumentException(err.what());
-        }
-    }
-};
-
 template<typename CS>
 template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int>>
 T StringView<CS>::Parse() const
 {
-    return Str2FloatImpl<T>::Convert(this->ToStdString());
+    // 数值中只含ASCII字符，在各字符集中都恰好占一个码元，因此直接解析码元即可
+    T ret = T(0);
+    switch(FromCharsExact(Data(), Data() + Length(), ret))
+    {
+    case NumConvError::OK:
+        return ret;
+    case NumConvError::OutOfRange:
+        throw ArgumentException("Parsing error in Str2Float: value out of range");
+    default:
+        throw ArgumentException("Parsing error in Str2Float: invalid number");
+    }
 }
 
 template<typename CS>
@@ -910,10 +1007,11 @@ StringView<CS>::Split(const Self &spliter) const
 {
     AGZ_ASSERT(spliter.Empty() == false);
     std::vector<Self> ret;
+    StrAlgo::Searcher<CodeUnit> searcher(spliter.begin(), spliter.end());
     size_t segBeg = 0; size_t offBeg = beg_ - str_->begin();
     while(segBeg < len_)
     {
-        size_t fi = Find(spliter, segBeg);
+        size_t fi = Find(searcher, segBeg);
         if(fi == NPOS)
         {
             ret.emplace_back(*str_, offBeg + segBeg, offBeg + len_);
@@ -927,20 +1025,30 @@ StringView<CS>::Split(const Self &spliter) const
     return ret;
 }
 
-template<typename CS>
-size_t UniStrLen(const String<CS> &s) { return s.Length(); }
-template<typename CS>
-size_t UniStrLen(const StringView<CS> &s) { return s.Length(); }
-template<typename CS>
-size_t UniStrLen(const char *s) { return std::strlen(s); }
-template<typename CS>
-size_t UniStrLen(const std::string &s) { return s.length(); }
-
 template<typename CS>
 template<typename C, std::enable_if_t<!std::is_array_v<C>, int>, typename V>
 std::vector<StringView<CS>> StringView<CS>::Split(const C &spliters) const
 {
-    // IMPROVE
+    // 分隔符统一转换为String<CS>保存，并为每个分隔符构造一次查找器
+    std::vector<Str> spliterStrs;
+    for(auto &s : spliters)
+    {
+        if constexpr(std::is_same_v<remove_rcv_t<decltype(s)>, Self>)
+            spliterStrs.push_back(s.AsString());
+        else
+            spliterStrs.push_back(Str(s));
+        if(spliterStrs.back().Empty())
+            spliterStrs.pop_back();
+    }
+
+    std::vector<StrAlgo::Searcher<CodeUnit>> searchers;
+    searchers.reserve(spliterStrs.size());
+    for(auto &s : spliterStrs)
+        searchers.emplace_back(s.begin(), s.end());
+
+    // 每个分隔符下一次出现的位置。位置不小于segBeg时仍然有效，无需重新查找
+    std::vector<size_t> nextPos(searchers.size(), 0);
+    bool first = true;
 
     std::vector<Self> ret;
     size_t segBeg = 0; size_t offBeg = beg_ - str_->begin();
@@ -949,21 +1057,18 @@ std::vector<StringView<CS>> StringView<CS>::Split(const C &spliters) const
     {
         size_t fi = NPOS, slen = 0;
 
-        for(auto &s : spliters)
+        for(size_t i = 0; i < searchers.size(); ++i)
         {
-            size_t fi2;
-            if constexpr(std::is_same_v<remove_rcv_t<decltype(s)>, Self> ||
-                         std::is_same_v<remove_rcv_t<decltype(s)>, Str>)
-                fi2 = Find(s, segBeg);
-            else
-                fi2 = Find(String<CS>(s), segBeg);
-
-            if(fi2 != NPOS && (fi == NPOS || fi2 < fi))
+            if(first || (nextPos[i] != NPOS && nextPos[i] < segBeg))
+                nextPos[i] = Find(searchers[i], segBeg);
+
+            if(nextPos[i] != NPOS && (fi == NPOS || nextPos[i] < fi))
             {
-                fi = fi2;
-                slen = UniStrLen(s);
+                fi = nextPos[i];
+                slen = searchers[i].GetPatternLength();
             }
         }
+        first = false;
 
         if(fi == NPOS)
         {
@@ -980,6 +1085,26 @@ std::vector<StringView<CS>> StringView<CS>::Split(const C &spliters) const
     return ret;
 }
 
+template<typename CS>
+std::pair<const typename CS::CodeUnit*, const typename CS::CodeUnit*>
+StringView<CS>::SpliterDelim::operator()(const CodeUnit *beg, const CodeUnit *end) const
+{
+    return StrAlgo::SplitBySubstr<CodeUnit>{ spliter.Data(), spliter.Length() }(beg, end);
+}
+
+template<typename CS>
+typename StringView<CS>::WhitespaceSplitRange StringView<CS>::LazySplit() const
+{
+    return WhitespaceSplitRange(beg_, beg_ + len_, { IsSpaceCU() }, SplitToken{ str_ });
+}
+
+template<typename CS>
+typename StringView<CS>::SpliterSplitRange StringView<CS>::LazySplit(const Self &spliter) const
+{
+    AGZ_ASSERT(spliter.Empty() == false);
+    return SpliterSplitRange(beg_, beg_ + len_, SpliterDelim{ spliter.AsString() }, SplitToken{ str_ });
+}
+
 template<typename CS>
 template<typename R>
 String<CS> StringView<CS>::Join(R &&strRange) const
@@ -996,10 +1121,15 @@ String<CS> StringView<CS>::Join(R &&strRange) const
 
 template<typename CS>
 size_t StringView<CS>::Find(const Self &dst, size_t begIdx) const
+{
+    return Find(StrAlgo::Searcher<CodeUnit>(dst.begin(), dst.end()), begIdx);
+}
+
+template<typename CS>
+size_t StringView<CS>::Find(const StrAlgo::Searcher<CodeUnit> &searcher, size_t begIdx) const
 {
     AGZ_ASSERT(begIdx <= len_);
-    auto rt = StrAlgo::FindSubPattern(begin() + begIdx, end(),
-                                      dst.begin(), dst.end());
+    auto rt = searcher.Find(begin() + begIdx, end());
     return rt == end() ? NPOS : (rt - beg_);
 }
 
@@ -1078,6 +1208,7 @@ template<typename CS>
 String<CS> StringView<CS>::operator+(const Self &rhs) const
 {
     StringBuilder<CS> builder;
+    builder.Reserve(len_ + rhs.len_);
     builder << *this << rhs;
     return builder.Get();
 }
@@ -1150,9 +1281,16 @@ String<CS>::String(size_t len)
 
 }
 
+template<typename CS>
+String<CS>::String(RefCountedBuf<typename CS::CodeUnit> *buf)
+    : storage_(buf)
+{
+
+}
+
 template<typename CS>
 String<CS>::String()
-    : storage_(0)
+    : storage_(size_t(0))
 {
 
 }
@@ -1208,7 +1346,7 @@ String<CS>::String(const Self &copyFrom, size_t begIdx, size_t endIdx)
 
 template<typename CS>
 String<CS>::String(const char *cstr, NativeCharset cs)
-    : storage_(0)
+    : storage_(size_t(0))
 {
     switch(cs)
     {
@@ -1225,7 +1363,7 @@ String<CS>::String(const char *cstr, NativeCharset cs)
 
 template<typename CS>
 String<CS>::String(const std::string &cppStr, NativeCharset cs)
-    : storage_(0)
+    : storage_(size_t(0))
 {
     switch(cs)
     {
@@ -1242,7 +1380,7 @@ String<CS>::String(const std::string &cppStr, NativeCharset cs)
 
 template<typename CS>
 String<CS>::String(const wchar_t *cstr, NativeCharset cs)
-    : storage_(0)
+    : storage_(size_t(0))
 {
     switch(cs)
     {
@@ -1259,7 +1397,7 @@ String<CS>::String(const wchar_t *cstr, NativeCharset cs)
 
 template<typename CS>
 String<CS>::String(const std::wstring &cppStr, NativeCharset cs)
-    : storage_(0)
+    : storage_(size_t(0))
 {
     switch(cs)
     {
@@ -1332,13 +1470,15 @@ AGZ_STR_FROM_INT_IMPL(unsigned long long)
 template<typename CS>
 String<CS> String<CS>::From(float v)
 {
-    return Self(std::to_string(v));
+    CodeUnit buf[MAX_FLOAT_CHARS];
+    return Self(buf, ToChars(v, buf));
 }
 
 template<typename CS>
 String<CS> String<CS>::From(double v)
 {
-    return Self(std::to_string(v));
+    CodeUnit buf[MAX_FLOAT_CHARS];
+    return Self(buf, ToChars(v, buf));
 }
 
 template<typename CS>
@@ -1412,23 +1552,107 @@ String<CS> operator*(const String<CS> &lhs, size_t rhs)
     return b.Get();
 }
 
+template<typename CS>
+StringBuilder<CS>::StringBuilder(const Self &copyFrom)
+    : buf_(copyFrom.buf_), len_(copyFrom.len_)
+{
+    if(buf_)
+        buf_->IncRef();
+}
+
+template<typename CS>
+StringBuilder<CS>::StringBuilder(Self &&moveFrom) noexcept
+    : buf_(moveFrom.buf_), len_(moveFrom.len_)
+{
+    moveFrom.buf_ = nullptr;
+    moveFrom.len_ = 0;
+}
+
+template<typename CS>
+StringBuilder<CS>::~StringBuilder()
+{
+    if(buf_)
+        buf_->DecRef();
+}
+
+template<typename CS>
+StringBuilder<CS> &StringBuilder<CS>::operator=(const Self &copyFrom)
+{
+    if(copyFrom.buf_)
+        copyFrom.buf_->IncRef();
+    if(buf_)
+        buf_->DecRef();
+    buf_ = copyFrom.buf_;
+    len_ = copyFrom.len_;
+    return *this;
+}
+
+template<typename CS>
+StringBuilder<CS> &StringBuilder<CS>::operator=(Self &&moveFrom) noexcept
+{
+    if(this != &moveFrom)
+    {
+        if(buf_)
+            buf_->DecRef();
+        buf_ = moveFrom.buf_;
+        len_ = moveFrom.len_;
+        moveFrom.buf_ = nullptr;
+        moveFrom.len_ = 0;
+    }
+    return *this;
+}
+
+template<typename CS>
+typename CS::CodeUnit *StringBuilder<CS>::PrepareAppend(size_t n)
+{
+    size_t need = len_ + n;
+    if(buf_ && buf_->GetRefCount() == 1)
+    {
+        if(need > buf_->GetLength())
+            buf_ = Buf::Resize(buf_, (std::max)(need, 2 * buf_->GetLength()));
+        else
+            buf_->ResetHash();
+    }
+    else
+    {
+        // 缓存被返回的字符串或其他构造器共享时，复制一份再写入
+        Buf *newBuf = Buf::New((std::max)({ need, 2 * Capacity(), size_t(16) }));
+        if(buf_)
+        {
+            Copy(buf_->GetData(), len_, newBuf->GetData());
+            buf_->DecRef();
+        }
+        buf_ = newBuf;
+    }
+    return buf_->GetData() + len_;
+}
+
+template<typename CS>
+void StringBuilder<CS>::Reserve(size_t n)
+{
+    if(n > Capacity())
+        PrepareAppend(n - len_);
+}
+
 template<typename CS>
 StringBuilder<CS> &StringBuilder<CS>::Append(
     const StringView<CS> &view, size_t n)
 {
-    // IMPROVE
-    while(n-- > 0)
-        strs_.emplace_back(view);
+    size_t len = view.Length();
+    if(!len || !n)
+        return *this;
+
+    CodeUnit *dst = PrepareAppend(len * n);
+    for(size_t i = 0; i < n; ++i, dst += len)
+        Copy(view.Data(), len, dst);
+    len_ += len * n;
     return *this;
 }
 
 template<typename CS>
 StringBuilder<CS> &StringBuilder<CS>::Append(const String<CS> &str, size_t n)
 {
-    // IMPROVE
-    while(n-- > 0)
-        strs_.emplace_back(str);
-    return *this;
+    return Append(str.AsView(), n);
 }
 
 template<typename CS>
@@ -1440,25 +1664,40 @@ StringBuilder<CS> &StringBuilder<CS>::operator<<(const StringView<CS> &view)
 template<typename CS>
 String<CS> StringBuilder<CS>::Get() const
 {
-    if(strs_.size() == 1)
-        return strs_.front();
+    if(!len_)
+        return String<CS>();
 
-    size_t len = 0;
-    for(auto &s : strs_)
-        len += s.Length();
+#if defined(AGZ_ENABLE_STRING_SSO)
+    // 结果能放进SSO缓存时直接复制，构建器保留自己的缓存和容量
+    if(len_ <= Storage<CodeUnit>::SMALL_BUF_SIZE)
+        return String<CS>(buf_->GetData(), len_);
+#endif
 
-    String<CS> ret(len);
-    auto data = ret.GetMutableData();
-    for(auto &s : strs_)
+    if(buf_->GetRefCount() == 1)
     {
-        Copy(s.Data(), s.Length(), data);
-        data += s.Length();
+        // 缓存直接交给返回的字符串。多余的容量较大时才重新分配以释放它，否则只修改长度
+        size_t slack = buf_->GetLength() - len_;
+        if(slack > len_ / 4 && slack * sizeof(CodeUnit) >= 64)
+            buf_ = Buf::Resize(buf_, len_);
+        else if(slack)
+            buf_->Truncate(len_);
     }
+    else if(buf_->GetLength() != len_)
+        return String<CS>(buf_->GetData(), len_);
 
-    strs_.clear();
-    if(!ret.Empty())
-        strs_.push_back(ret);
-    return ret;
+    buf_->IncRef();
+    return String<CS>(buf_);
+}
+
+template<typename CS>
+void StringBuilder<CS>::Clear()
+{
+    if(buf_ && buf_->GetRefCount() != 1)
+    {
+        buf_->DecRef();
+        buf_ = nullptr;
+    }
+    len_ = 0;
 }
 
 template<typename DCS, typename SCS>
@@ -1468,26 +1707,64 @@ String<DCS> CharsetConvertor::Convert(const typename String<SCS>::View &src)
         return String<SCS>(src.AsString());
     else
     {
-        std::vector<typename DCS::CodeUnit> cus;
-        typename DCS::CodeUnit sgl[DCS::MaxCUInCP];
+        using SCU = typename SCS::CodeUnit;
+        using DCU = typename DCS::CodeUnit;
 
-        auto beg = src.begin(), end = src.end();
-        while(beg < end)
+        constexpr bool COPY_ASCII = SCS::ASCIICompatible && DCS::ASCIICompatible;
+        const SCU *srcBeg = src.begin(), *srcEnd = src.end();
+
+        // 第一遍：校验输入并求出结果的准确长度，以便一次分配恰好大小的存储
+        size_t dstLen = 0;
+        for(const SCU *beg = srcBeg; beg < srcEnd;)
         {
+            // 连续的ASCII字符在两种编码下各占一个码元
+            if constexpr(COPY_ASCII)
+            {
+                size_t n = CharsetAux::ASCIIPrefixLength(beg, static_cast<size_t>(srcEnd - beg));
+                beg += n;
+                dstLen += n;
+                if(beg == srcEnd)
+                    break;
+            }
+
             typename SCS::CodePoint scp;
-            size_t skip = SCS::CU2CP(beg, &scp);
+            size_t skip = SCS::CheckedCU2CP(beg, srcEnd, &scp);
             if(!skip)
                 throw CharsetException("Invalid " + SCS::Name()
                                      + " sequence");
             beg += skip;
 
-            size_t sgls = DCS::CP2CU(DCS::template From<SCS>(scp), sgl);
-            AGZ_ASSERT(sgls);
-            for(size_t i = 0; i < sgls; ++i)
-                cus.push_back(sgl[i]);
+            DCU sgl[DCS::MaxCUInCP];
+            size_t dsts = DCS::CP2CU(DCS::template From<SCS>(scp), sgl);
+            if(!dsts)
+                throw CharsetException("Code point not representable in " + DCS::Name());
+            dstLen += dsts;
+        }
+
+        // 第二遍：输入已经过校验，直接编码到结果的存储中
+        String<DCS> ret(dstLen);
+        DCU *dstBeg = ret.GetMutableData(), *dst = dstBeg;
+        for(const SCU *beg = srcBeg; beg < srcEnd;)
+        {
+            if constexpr(COPY_ASCII)
+            {
+                if(static_cast<CharsetAux::UnsignedCU<SCU>>(*beg) < 0x80)
+                {
+                    size_t n = CharsetAux::CopyASCII(beg, static_cast<size_t>(srcEnd - beg), dst);
+                    beg += n;
+                    dst += n;
+                    if(beg == srcEnd)
+                        break;
+                }
+            }
+
+            typename SCS::CodePoint scp;
+            beg += SCS::CheckedCU2CP(beg, srcEnd, &scp);
+            dst += DCS::CP2CU(DCS::template From<SCS>(scp), dst);
         }
+        AGZ_ASSERT(dst == dstBeg + dstLen);
 
-        return String<DCS>(cus.data(), cus.size());
+        return ret;
     }
 }
 
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../../Alloc/Alloc.h"
+#include "../../Misc/Common.h"
+#include "../../Misc/Exception.h"
+#include "String.h"
+
+namespace AGZ {
+
+/**
+ * @brief 字符串缓存的区域分配器
+ *
+ * 在 StringArenaScope 的作用范围内，当前线程新创建的字符串缓存（包括 String 、StringBuilder 等内部的缓存）
+ * 都以指针递增的方式从本分配器预先申请的大块内存中取得，引用计数归零时也不单独释放，而是在 Clear 或析构时一次性归还给Alloc。
+ * 适合解析文件等会产生大量短命字符串的场合。
+ *
+ * 字符串的使用方式不受影响，仍可以与其他字符串自由地复制、比较、拼接，但由本分配器分配的字符串必须在 Clear 或析构之前销毁。
+ * 需要保留到之后的结果应在作用范围外复制一份，如 Str8(s.Data(), s.Length())，或在 HeapStringScope 的作用范围内创建。
+ * 驻留池（ InternPool ）总是从全局堆复制被驻留的字符串，不受本分配器影响。
+ *
+ * 分配器本身不是线程安全的，同一时刻只应在一个线程中作为分配来源。由它分配的字符串可以在任意线程中销毁。
+ *
+ * @tparam Alloc 用于申请大块内存的分配器，参见 Alloc/Alloc.h 中的Allocator concept
+ */
+template<typename Alloc = CRTAllocator>
+class StringArena : public StrImpl::StringBufSource, public Uncopiable
+{
+    struct ChunkHead
+    {
+        ChunkHead *nextChunk;
+    };
+
+    static constexpr size_t CHUNK_HEAD_SIZE = (sizeof(ChunkHead) + alignof(std::max_align_t) - 1)
+                                            / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    ChunkHead *chunkEntry_;
+    char *curChunkTop_;   // 当前chunk中首个未占用字节的地址
+    char *curChunkEnd_;
+
+    const size_t chunkDataSize_;
+    size_t usedBytes_;
+
+    char *AllocChunk(size_t dataSize)
+    {
+        auto head = static_cast<ChunkHead*>(Alloc::Malloc(CHUNK_HEAD_SIZE + dataSize));
+        head->nextChunk = chunkEntry_;
+        chunkEntry_ = head;
+        return reinterpret_cast<char*>(head) + CHUNK_HEAD_SIZE;
+    }
+
+public:
+
+    /**
+     * @param chunkDataSize 每次预分配块中有多少可用字节，默认为64KB
+     *
+     * @exception ArgumentException 参数非法时抛出
+     */
+    explicit StringArena(size_t chunkDataSize = 64 * 1024)
+        : chunkEntry_(nullptr), curChunkTop_(nullptr), curChunkEnd_(nullptr),
+          chunkDataSize_(chunkDataSize), usedBytes_(0)
+    {
+        if(chunkDataSize < 1)
+            throw ArgumentException("StringArena: chunkDataSize must be positive");
+    }
+
+    ~StringArena()
+    {
+        Clear();
+    }
+
+    /**
+     * @brief 分配size字节、对齐到align的内存
+     *
+     * 超过预分配块一半大小的请求会单独向Alloc申请一块内存，以免浪费当前块的剩余空间
+     *
+     * @exception std::bad_alloc 向Alloc申请内存失败时抛出
+     */
+    void *AllocStringBuf(size_t size, size_t align) override
+    {
+        AGZ_ASSERT(align && !(align & (align - 1)) && align <= alignof(std::max_align_t));
+
+        if(size > chunkDataSize_ / 2)
+        {
+            usedBytes_ += size;
+            return AllocChunk(size);
+        }
+
+        auto top = reinterpret_cast<std::uintptr_t>(curChunkTop_);
+        auto beg = reinterpret_cast<char*>((top + align - 1) & ~std::uintptr_t(align - 1));
+        if(!curChunkTop_ || beg + size > curChunkEnd_)
+        {
+            beg = AllocChunk(chunkDataSize_);
+            curChunkEnd_ = beg + chunkDataSize_;
+        }
+
+        curChunkTop_ = beg + size;
+        usedBytes_ += size;
+        return beg;
+    }
+
+    /**
+     * @brief 取得已分配给字符串缓存的总字节数，不包含预分配但未使用的内存
+     */
+    size_t GetUsedBytes() const noexcept
+    {
+        return usedBytes_;
+    }
+
+    /**
+     * @brief 归还所有内存。此前由本分配器分配的字符串必须都已被销毁
+     */
+    void Clear()
+    {
+        for(ChunkHead *chunk = chunkEntry_, *next; chunk; chunk = next)
+        {
+            next = chunk->nextChunk;
+            Alloc::Free(chunk);
+        }
+        chunkEntry_ = nullptr;
+        curChunkTop_ = curChunkEnd_ = nullptr;
+        usedBytes_ = 0;
+    }
+
+    /**
+     * @brief 复制view中的内容，得到一个从本分配器分配的字符串
+     */
+    template<typename CS>
+    String<CS> Copy(const StringView<CS> &view);
+};
+
+/**
+ * @brief 在其生命周期内，将当前线程的字符串缓存分配来源设置为给定的 StringArena
+ *
+ * 可以嵌套，析构时恢复之前的分配来源
+ */
+class StringArenaScope : public Uncopiable
+{
+    StrImpl::StringBufSource *prev_;
+
+public:
+
+    explicit StringArenaScope(StrImpl::StringBufSource &source) noexcept
+        : prev_(StrImpl::CurrentStringBufSource())
+    {
+        StrImpl::CurrentStringBufSource() = &source;
+    }
+
+    ~StringArenaScope()
+    {
+        StrImpl::CurrentStringBufSource() = prev_;
+    }
+};
+
+/**
+ * @brief 在其生命周期内，令当前线程的字符串缓存从全局堆分配
+ *
+ * 用于在 StringArenaScope 的作用范围内创建需要长期保存的字符串，如驻留池中的项。可以嵌套，析构时恢复之前的分配来源
+ */
+class HeapStringScope : public Uncopiable
+{
+    StrImpl::StringBufSource *prev_;
+
+public:
+
+    HeapStringScope() noexcept
+        : prev_(StrImpl::CurrentStringBufSource())
+    {
+        StrImpl::CurrentStringBufSource() = nullptr;
+    }
+
+    ~HeapStringScope()
+    {
+        StrImpl::CurrentStringBufSource() = prev_;
+    }
+};
+
+template<typename Alloc>
+template<typename CS>
+String<CS> StringArena<Alloc>::Copy(const StringView<CS> &view)
+{
+    StringArenaScope scope(*this);
+    return String<CS>(view.Data(), view.Length());
+}
+
+} // namespace AGZ
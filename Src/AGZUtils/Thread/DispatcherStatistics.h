@@ -0,0 +1,180 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../Misc/Common.h"
+#include "../String/NumConv.h"
+
+namespace AGZ {
+
+/**
+ * @brief 任务分派器的执行统计数据
+ *
+ * 记录每个任务被哪个工作线程执行、工作线程等待任务锁的时间以及任务的执行时间，
+ * 可据此判断负载是否均衡、是否受限于锁竞争，也可导出为Chrome trace格式（chrome://tracing）以观察调度间隙。
+ *
+ * 所有时间均以纳秒为单位，从本批任务开始分派时起算。
+ */
+class DispatcherStatistics
+{
+public:
+
+    /**
+     * @brief 单个任务的执行记录
+     */
+    struct TaskRecord
+    {
+        uint64_t claimBegin; //!< 工作线程开始领取该任务（尝试获取任务锁）的时间
+        uint64_t execBegin;  //!< 领取完成、开始执行的时间
+        uint64_t execEnd;    //!< 执行结束的时间
+    };
+
+    /**
+     * @brief 单个工作线程的汇总数据
+     */
+    struct WorkerSummary
+    {
+        size_t taskCount       = 0; //!< 执行的任务数量
+        uint64_t busyTime      = 0; //!< 执行任务的总时间
+        uint64_t lockWaitTime  = 0; //!< 等待任务锁并领取任务的总时间
+        uint64_t queueWaitTime = 0; //!< 其执行的任务在队列中等待的总时间
+    };
+
+    /**
+     * @brief 任务执行时间直方图的桶数量，第k个桶统计执行时间位于[2^k, 2^(k+1))纳秒的任务数
+     */
+    static constexpr size_t HISTOGRAM_BUCKET_COUNT = 64;
+
+    DispatcherStatistics() = default;
+
+    /**
+     * @param records 每个工作线程的任务记录
+     */
+    explicit DispatcherStatistics(std::vector<std::vector<TaskRecord>> records)
+        : records_(std::move(records))
+    {
+
+    }
+
+    /**
+     * @brief 工作线程数量
+     */
+    size_t GetWorkerCount() const noexcept
+    {
+        return records_.size();
+    }
+
+    /**
+     * @brief 取得某个工作线程的全部任务记录
+     */
+    const std::vector<TaskRecord> &GetTaskRecords(size_t worker) const
+    {
+        return records_[worker];
+    }
+
+    /**
+     * @brief 取得某个工作线程的汇总数据
+     */
+    WorkerSummary GetWorkerSummary(size_t worker) const
+    {
+        WorkerSummary ret;
+        for(auto &r : records_[worker])
+        {
+            ++ret.taskCount;
+            ret.busyTime      += r.execEnd - r.execBegin;
+            ret.lockWaitTime  += r.execBegin - r.claimBegin;
+            ret.queueWaitTime += r.execBegin;
+        }
+        return ret;
+    }
+
+    /**
+     * @brief 所有工作线程执行的任务总数
+     */
+    size_t GetTaskCount() const noexcept
+    {
+        size_t ret = 0;
+        for(auto &w : records_)
+            ret += w.size();
+        return ret;
+    }
+
+    /**
+     * @brief 任务执行时间直方图，参见 HISTOGRAM_BUCKET_COUNT
+     */
+    std::vector<size_t> GetDurationHistogram() const
+    {
+        std::vector<size_t> ret(HISTOGRAM_BUCKET_COUNT, 0);
+        for(auto &w : records_)
+        {
+            for(auto &r : w)
+            {
+                uint64_t dur = r.execEnd - r.execBegin;
+                size_t bucket = 0;
+                while(dur >>= 1)
+                    ++bucket;
+                ++ret[bucket];
+            }
+        }
+        return ret;
+    }
+
+    /**
+     * @brief 导出为Chrome trace event格式的JSON字符串
+     *
+     * 每个工作线程对应一个tid，任务执行和等待任务锁分别输出为名为“task”和“lock”的complete event
+     */
+    std::string ToChromeTrace() const
+    {
+        std::string ret = "{\"traceEvents\":[";
+        bool first = true;
+
+        // trace中的时间单位为微秒。用整数运算写出三位小数，不受全局locale的小数点影响
+        auto addMicroseconds = [&](uint64_t ns)
+        {
+            char buf[MAX_INT_CHARS + 4];
+            char *end = ToChars(ns / 1000, buf);
+            uint64_t frac = ns % 1000;
+            *end++ = '.';
+            *end++ = static_cast<char>('0' + frac / 100);
+            *end++ = static_cast<char>('0' + frac / 10 % 10);
+            *end++ = static_cast<char>('0' + frac % 10);
+            ret.append(buf, end);
+        };
+
+        auto addEvent = [&](const char *name, size_t tid, uint64_t beg, uint64_t end)
+        {
+            if(!first)
+                ret += ",";
+            first = false;
+            ret += "{\"name\":\"";
+            ret += name;
+            ret += "\",\"ph\":\"X\",\"pid\":0,\"tid\":" + std::to_string(tid) + ",\"ts\":";
+            addMicroseconds(beg);
+            ret += ",\"dur\":";
+            addMicroseconds(end - beg);
+            ret += "}";
+        };
+
+        for(size_t w = 0; w < records_.size(); ++w)
+        {
+            for(auto &r : records_[w])
+            {
+                if(r.execBegin > r.claimBegin)
+                    addEvent("lock", w, r.claimBegin, r.execBegin);
+                addEvent("task", w, r.execBegin, r.execEnd);
+            }
+        }
+
+        ret += "],\"displayTimeUnit\":\"ns\"}";
+        return ret;
+    }
+
+private:
+
+    std::vector<std::vector<TaskRecord>> records_;
+};
+
+} // namespace AGZ
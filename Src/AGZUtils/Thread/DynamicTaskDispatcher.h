@@ -0,0 +1,379 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "../Misc/Common.h"
+#include "../Misc/Exception.h"
+#include "ThreadPool.h"
+
+namespace AGZ {
+
+AGZ_NEW_EXCEPTION(TaskCancelledException, Exception);
+
+/**
+ * @brief 取消标记，由 CancellationSource 创建
+ *
+ * 长时间运行的任务应定期检查 IsCancelled，并在其返回true时尽快结束
+ */
+class CancellationToken
+{
+    friend class CancellationSource;
+
+    std::shared_ptr<const std::atomic<bool>> flag_;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag) noexcept
+        : flag_(std::move(flag))
+    {
+
+    }
+
+public:
+
+    /**
+     * @brief 构造一个永远不会被取消的标记
+     */
+    CancellationToken() = default;
+
+    /**
+     * @brief 是否已被取消
+     */
+    bool IsCancelled() const noexcept
+    {
+        return flag_ && flag_->load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 若已被取消，则抛出 TaskCancelledException
+     */
+    void ThrowIfCancelled() const
+    {
+        if(IsCancelled())
+            throw TaskCancelledException("task cancelled");
+    }
+};
+
+/**
+ * @brief 取消源，可创建任意多个共享同一取消状态的 CancellationToken
+ */
+class CancellationSource
+{
+    std::shared_ptr<std::atomic<bool>> flag_;
+
+public:
+
+    CancellationSource()
+        : flag_(std::make_shared<std::atomic<bool>>(false))
+    {
+
+    }
+
+    /**
+     * @brief 取消所有由本取消源创建的标记
+     */
+    void Cancel() noexcept
+    {
+        flag_->store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const noexcept
+    {
+        return flag_->load(std::memory_order_relaxed);
+    }
+
+    CancellationToken GetToken() const
+    {
+        return CancellationToken(flag_);
+    }
+};
+
+/**
+ * @brief 动态任务分派器
+ *
+ * 与 StaticTaskDispatcher 不同，任意线程都可以在工作线程执行任务的同时通过 Submit 提交新任务，
+ * 并通过返回的std::future取得任务结果。
+ *
+ * 每个任务都绑定一个 CancellationToken：任务开始执行前若标记已被取消，则不会执行该任务，其future会得到 TaskCancelledException；
+ * 任务函数也可以接受一个const CancellationToken&参数，以便在执行期间检查取消状态。
+ */
+class DynamicTaskDispatcher : public Uncopiable
+{
+    static constexpr uint64_t NO_EPOCH = (std::numeric_limits<uint64_t>::max)();
+
+    struct Task
+    {
+        CancellationToken token;
+        uint64_t epoch = NO_EPOCH; // 绑定到分派器自身取消源时，为提交时的轮次
+
+        explicit Task(CancellationToken t) : token(std::move(t)) { }
+
+        virtual ~Task() = default;
+
+        virtual void Run() = 0;
+
+        virtual void Cancel() = 0;
+    };
+
+    template<typename Func, typename R>
+    struct FuncTask : Task
+    {
+        Func func;
+        std::promise<R> promise;
+
+        FuncTask(Func &&f, CancellationToken t)
+            : Task(std::move(t)), func(std::move(f))
+        {
+
+        }
+
+        void Run() override
+        {
+            try
+            {
+                if constexpr(std::is_void_v<R>)
+                {
+                    Invoke();
+                    promise.set_value();
+                }
+                else
+                    promise.set_value(Invoke());
+            }
+            catch(...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        }
+
+        void Cancel() override
+        {
+            promise.set_exception(std::make_exception_ptr(TaskCancelledException("task cancelled")));
+        }
+
+    private:
+
+        R Invoke()
+        {
+            if constexpr(std::is_invocable_v<Func&, const CancellationToken&>)
+                return func(this->token);
+            else
+                return func();
+        }
+    };
+
+    template<typename Func>
+    using ResultOf = std::conditional_t<std::is_invocable_v<Func&, const CancellationToken&>,
+                                        std::invoke_result<Func&, const CancellationToken&>,
+                                        std::invoke_result<Func&>>;
+
+    std::mutex mut_;
+    std::condition_variable taskCV_; // 有新任务或即将析构
+    std::condition_variable idleCV_; // 任务队列为空且没有正在执行的任务，或某一轮次开始的任务已全部结束
+
+    std::deque<std::unique_ptr<Task>> tasks_;
+    size_t runningCount_ = 0;
+    bool exit_ = false;
+
+    // 每次 CancelAll 取消当前轮次的取消源并开启一个新轮次。
+    // 按轮次记录正在执行的、绑定到分派器自身取消源的任务数量，CancelAll 只需等待被它取消的任务
+    uint64_t epoch_ = 0;
+    std::map<uint64_t, size_t> runningPerEpoch_;
+
+    CancellationSource source_;
+
+    ThreadPool pool_;
+
+    void WorkerMain()
+    {
+        for(;;)
+        {
+            std::unique_ptr<Task> task;
+            uint64_t epoch;
+            {
+                std::unique_lock<std::mutex> lk(mut_);
+                taskCV_.wait(lk, [&] { return exit_ || !tasks_.empty(); });
+                if(tasks_.empty())
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+                ++runningCount_;
+                epoch = task->epoch;
+                if(epoch != NO_EPOCH)
+                    ++runningPerEpoch_[epoch];
+            }
+
+            if(task->token.IsCancelled())
+                task->Cancel();
+            else
+                task->Run();
+            task.reset();
+
+            std::lock_guard<std::mutex> lk(mut_);
+            --runningCount_;
+            bool epochDone = false;
+            if(epoch != NO_EPOCH)
+            {
+                auto it = runningPerEpoch_.find(epoch);
+                if((epochDone = !--it->second))
+                    runningPerEpoch_.erase(it);
+            }
+            if(epochDone || (!runningCount_ && tasks_.empty()))
+                idleCV_.notify_all();
+        }
+    }
+
+    template<typename Func>
+    auto SubmitImpl(Func &&func, CancellationToken token, bool useOwnSource)
+    {
+        using F = remove_rcv_t<Func>;
+        using R = typename ResultOf<F>::type;
+
+        auto task = std::make_unique<FuncTask<F, R>>(F(std::forward<Func>(func)), std::move(token));
+        std::future<R> ret = task->promise.get_future();
+        {
+            std::lock_guard<std::mutex> lk(mut_);
+            if(useOwnSource)
+            {
+                task->token = source_.GetToken();
+                task->epoch = epoch_;
+            }
+            tasks_.push_back(std::move(task));
+        }
+        taskCV_.notify_one();
+        return ret;
+    }
+
+public:
+
+    /**
+     * @param workerCount 工作线程数量，为非正数时使用硬件线程数
+     */
+    explicit DynamicTaskDispatcher(int workerCount = 0)
+    {
+        if(workerCount <= 0)
+            workerCount = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = (std::max)(1, workerCount);
+
+        pool_.Dispatch([this](int) { WorkerMain(); }, workerCount);
+    }
+
+    /**
+     * @brief 执行完队列中剩余的任务，然后结束所有工作线程
+     */
+    ~DynamicTaskDispatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mut_);
+            exit_ = true;
+        }
+        taskCV_.notify_all();
+        pool_.Wait();
+    }
+
+    /**
+     * @brief 提交一个绑定到给定取消标记的任务，可在任意线程中调用
+     *
+     * @param func 任务函数，以func(token)或func()的形式调用
+     * @param token 任务的取消标记
+     *
+     * @return 任务结果的future。任务抛出的异常会通过future传递
+     */
+    template<typename Func>
+    auto Submit(Func &&func, CancellationToken token)
+    {
+        return SubmitImpl(std::forward<Func>(func), std::move(token), false);
+    }
+
+    /**
+     * @brief 提交一个绑定到分派器自身取消源的任务，该任务会被 CancelAll 取消
+     */
+    template<typename Func>
+    auto Submit(Func &&func)
+    {
+        return SubmitImpl(std::forward<Func>(func), CancellationToken(), true);
+    }
+
+    /**
+     * @brief 取消所有通过不带取消标记的 Submit 提交的任务，并等待其中正在执行的任务结束
+     *
+     * 队列中已被取消的任务（包括取消标记已被取消的其他任务）会被立即移出队列，其future得到 TaskCancelledException；
+     * 正在执行的任务可通过其取消标记观察到取消。绑定到其他取消标记的任务和之后提交的任务不受影响，也不会被等待。
+     *
+     * 不能在本分派器的任务中调用，否则会等待调用方自身而死锁
+     */
+    void CancelAll()
+    {
+        AGZ_ASSERT(!pool_.IsInWorkerThread());
+
+        std::deque<std::unique_ptr<Task>> cancelled;
+        uint64_t epoch;
+        {
+            std::lock_guard<std::mutex> lk(mut_);
+            source_.Cancel();
+            source_ = CancellationSource();
+            epoch = epoch_++;
+
+            auto kept = tasks_.begin();
+            for(auto &task : tasks_)
+            {
+                if(task->token.IsCancelled())
+                    cancelled.push_back(std::move(task));
+                else
+                    *kept++ = std::move(task);
+            }
+            tasks_.erase(kept, tasks_.end());
+            if(!runningCount_ && tasks_.empty())
+                idleCV_.notify_all();
+        }
+
+        for(auto &task : cancelled)
+            task->Cancel();
+
+        std::unique_lock<std::mutex> lk(mut_);
+        idleCV_.wait(lk, [&]
+        {
+            return runningPerEpoch_.empty() || runningPerEpoch_.begin()->first > epoch;
+        });
+    }
+
+    /**
+     * @brief 等待直到任务队列为空且没有正在执行的任务
+     *
+     * 其他线程持续提交任务时可能一直等待下去。不能在本分派器的任务中调用，否则会等待调用方自身而死锁
+     */
+    void Join()
+    {
+        AGZ_ASSERT(!pool_.IsInWorkerThread());
+
+        std::unique_lock<std::mutex> lk(mut_);
+        idleCV_.wait(lk, [&] { return tasks_.empty() && !runningCount_; });
+    }
+
+    /**
+     * @brief 设置工作线程的放置选项（绑定CPU、线程命名），参见 WorkerThreadOptions
+     *
+     * @return 是否全部设置成功
+     */
+    bool SetWorkerOptions(WorkerThreadOptions options)
+    {
+        return pool_.SetWorkerOptions(std::move(options));
+    }
+
+    /**
+     * @brief 尚未开始执行的任务数量
+     */
+    size_t GetPendingTaskCount()
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        return tasks_.size();
+    }
+};
+
+} // namespace AGZ
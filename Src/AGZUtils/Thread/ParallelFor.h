@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "../Misc/Common.h"
+#include "ThreadPool.h"
+
+namespace AGZ {
+
+/**
+ * @brief ParallelFor等函数在未指定线程池时使用的全局线程池
+ *
+ * 含有硬件线程数-1个工作线程，调用方线程也会参与计算
+ */
+inline ThreadPool &GetDefaultThreadPool()
+{
+    static ThreadPool pool(static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+namespace ThreadImpl
+{
+    /**
+     * @brief 执行chunkCount块工作时，会有多少个线程（包括调用方）参与
+     */
+    inline int ParallelParticipantCount(const ThreadPool &pool, size_t chunkCount)
+    {
+        // 在工作线程或正在参与计算的调用方线程中再次向同一线程池分派工作会死锁，此时退化为串行执行
+        if(chunkCount <= 1 || pool.IsInWorkerThread())
+            return 1;
+        size_t helpers = (std::min)(static_cast<size_t>(pool.GetWorkerCount()), chunkCount - 1);
+        return static_cast<int>(helpers) + 1;
+    }
+
+    /**
+     * @brief 由participantCount个线程通过一个原子计数器领取并执行chunkCount块工作
+     *
+     * 以chunkFunc(chunkIndex, participantIndex)的形式执行每一块工作，其中participantIndex位于[0, participantCount)，
+     * 调用方线程的编号为0。某一块工作抛出异常后，剩下尚未被领取的块不会再被执行，第一个异常会在所有线程结束后被重新抛出。
+     */
+    template<typename ChunkFunc>
+    void RunChunks(ThreadPool &pool, int participantCount, size_t chunkCount, const ChunkFunc &chunkFunc)
+    {
+        if(participantCount <= 1)
+        {
+            for(size_t c = 0; c < chunkCount; ++c)
+                chunkFunc(c, 0);
+            return;
+        }
+
+        std::atomic<size_t> nextChunk = 0;
+        auto body = [&](int participant)
+        {
+            for(;;)
+            {
+                size_t c = nextChunk.fetch_add(1, std::memory_order_relaxed);
+                if(c >= chunkCount)
+                    return;
+
+                try
+                {
+                    chunkFunc(c, participant);
+                }
+                catch(...)
+                {
+                    nextChunk.store(chunkCount, std::memory_order_relaxed);
+                    throw;
+                }
+            }
+        };
+
+        pool.Dispatch([&](int idx) { body(idx + 1); }, participantCount - 1);
+
+        std::exception_ptr err;
+        try
+        {
+            ThreadPool::ParticipantScope participant(pool);
+            body(0);
+        }
+        catch(...)
+        {
+            err = std::current_exception();
+        }
+
+        pool.Wait();
+        if(err)
+            std::rethrow_exception(err);
+    }
+
+    inline size_t AutoGrain(const ThreadPool &pool, size_t count)
+    {
+        size_t threads = static_cast<size_t>(pool.GetWorkerCount()) + 1;
+        return (std::max<size_t>)(1, count / (8 * threads));
+    }
+
+} // namespace ThreadImpl
+
+/**
+ * @brief 在线程池中并行地对[begin, end)中的每个下标i调用func(i)
+ *
+ * 下标区间被划分为长度为grain的块，各线程通过原子计数器领取块，不会为每个下标分配任何内存。
+ * 调用方线程也会参与计算，函数在所有下标都被处理后才返回。
+ *
+ * @param grain 每块包含的下标数量，为0时自动选取
+ *
+ * @exception 若func抛出异常，尚未开始的块会被放弃，第一个异常会被重新抛出
+ */
+template<typename Func>
+void ParallelFor(ThreadPool &pool, size_t begin, size_t end, size_t grain, Func &&func)
+{
+    if(begin >= end)
+        return;
+
+    size_t count = end - begin;
+    if(!grain)
+        grain = ThreadImpl::AutoGrain(pool, count);
+    size_t chunkCount = (count + grain - 1) / grain;
+
+    ThreadImpl::RunChunks(pool, ThreadImpl::ParallelParticipantCount(pool, chunkCount), chunkCount,
+        [&](size_t chunk, int)
+    {
+        size_t chunkBeg = begin + chunk * grain;
+        size_t chunkEnd = (std::min)(chunkBeg + grain, end);
+        for(size_t i = chunkBeg; i < chunkEnd; ++i)
+            func(i);
+    });
+}
+
+/**
+ * @brief 使用 GetDefaultThreadPool 的 ParallelFor
+ */
+template<typename Func>
+void ParallelFor(size_t begin, size_t end, size_t grain, Func &&func)
+{
+    ParallelFor(GetDefaultThreadPool(), begin, end, grain, std::forward<Func>(func));
+}
+
+/**
+ * @brief 在线程池中并行地对[0, width) x [0, height)中的每个点(x, y)调用func(x, y)
+ *
+ * 区域被划分为tileWidth x tileHeight大小的块，各线程通过原子计数器领取块，块内按行优先顺序遍历
+ *
+ * @exception 若func抛出异常，尚未开始的块会被放弃，第一个异常会被重新抛出
+ */
+template<typename Func>
+void ParallelFor2D(ThreadPool &pool, size_t width, size_t height, size_t tileWidth, size_t tileHeight, Func &&func)
+{
+    if(!width || !height)
+        return;
+
+    tileWidth  = (std::max<size_t>)(1, tileWidth);
+    tileHeight = (std::max<size_t>)(1, tileHeight);
+    size_t tileXCount = (width  + tileWidth  - 1) / tileWidth;
+    size_t tileYCount = (height + tileHeight - 1) / tileHeight;
+    size_t chunkCount = tileXCount * tileYCount;
+
+    ThreadImpl::RunChunks(pool, ThreadImpl::ParallelParticipantCount(pool, chunkCount), chunkCount,
+        [&](size_t chunk, int)
+    {
+        size_t xBeg = (chunk % tileXCount) * tileWidth;
+        size_t yBeg = (chunk / tileXCount) * tileHeight;
+        size_t xEnd = (std::min)(xBeg + tileWidth, width);
+        size_t yEnd = (std::min)(yBeg + tileHeight, height);
+        for(size_t y = yBeg; y < yEnd; ++y)
+        {
+            for(size_t x = xBeg; x < xEnd; ++x)
+                func(x, y);
+        }
+    });
+}
+
+/**
+ * @brief 使用 GetDefaultThreadPool 的 ParallelFor2D
+ */
+template<typename Func>
+void ParallelFor2D(size_t width, size_t height, size_t tileWidth, size_t tileHeight, Func &&func)
+{
+    ParallelFor2D(GetDefaultThreadPool(), width, height, tileWidth, tileHeight, std::forward<Func>(func));
+}
+
+} // namespace AGZ
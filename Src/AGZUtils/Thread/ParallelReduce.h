@@ -0,0 +1,83 @@
+#pragma once
+
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ParallelFor.h"
+
+namespace AGZ {
+
+/**
+ * @brief 在线程池中并行地对[begin, end)中的下标求归约值
+ *
+ * 每一块在局部累加器中从identity开始，对块内的每个下标i依次执行acc = combineFn(acc, mapFn(i))，
+ * 结果存入该块的槽位；所有线程结束后再按块的下标顺序依次合并各块的结果。
+ * 因此combineFn只需满足结合律（如字符串拼接），identity须为其单位元。
+ *
+ * @param grain 每块包含的下标数量，为0时自动选取
+ *
+ * @exception 若mapFn或combineFn抛出异常，尚未开始的块会被放弃，第一个异常会被重新抛出
+ */
+template<typename T, typename MapFn, typename CombineFn>
+T ParallelReduce(ThreadPool &pool, size_t begin, size_t end, size_t grain,
+                 const T &identity, MapFn &&mapFn, CombineFn &&combineFn)
+{
+    if(begin >= end)
+        return identity;
+
+    size_t count = end - begin;
+    if(!grain)
+        grain = ThreadImpl::AutoGrain(pool, count);
+    size_t chunkCount = (count + grain - 1) / grain;
+
+    // 块由各线程乱序领取，每块的结果单独保存，以便按块的顺序合并。每块只在结束时写入一次槽位
+    std::vector<T> chunkResults(chunkCount, identity);
+
+    int participantCount = ThreadImpl::ParallelParticipantCount(pool, chunkCount);
+    ThreadImpl::RunChunks(pool, participantCount, chunkCount, [&](size_t chunk, int)
+    {
+        T acc = identity;
+        size_t chunkBeg = begin + chunk * grain;
+        size_t chunkEnd = (std::min)(chunkBeg + grain, end);
+        for(size_t i = chunkBeg; i < chunkEnd; ++i)
+            acc = combineFn(acc, mapFn(i));
+        chunkResults[chunk] = std::move(acc);
+    });
+
+    T ret = identity;
+    for(auto &r : chunkResults)
+        ret = combineFn(ret, r);
+    return ret;
+}
+
+/**
+ * @brief 在线程池中并行地对一个随机访问范围中的元素求归约值
+ *
+ * 对range中的每个元素e计算mapFn(e)，并用combineFn将结果合并。语义同下标版本的 ParallelReduce
+ */
+template<typename Range, typename T, typename MapFn, typename CombineFn>
+T ParallelReduce(ThreadPool &pool, Range &&range, const T &identity, MapFn &&mapFn, CombineFn &&combineFn)
+{
+    auto first = std::begin(range);
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                  typename std::iterator_traits<decltype(first)>::iterator_category>,
+                  "ParallelReduce: random access range is required");
+
+    size_t count = static_cast<size_t>(std::distance(first, std::end(range)));
+    return ParallelReduce(pool, 0, count, 0, identity,
+        [&](size_t i) { return mapFn(first[i]); }, combineFn);
+}
+
+/**
+ * @brief 使用 GetDefaultThreadPool 的 ParallelReduce
+ */
+template<typename Range, typename T, typename MapFn, typename CombineFn>
+T ParallelReduce(Range &&range, const T &identity, MapFn &&mapFn, CombineFn &&combineFn)
+{
+    return ParallelReduce(GetDefaultThreadPool(), std::forward<Range>(range), identity,
+                          std::forward<MapFn>(mapFn), std::forward<CombineFn>(combineFn));
+}
+
+} // namespace AGZ
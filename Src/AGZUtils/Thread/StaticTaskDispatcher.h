@@ -1,11 +1,14 @@
 ﻿#pragma once
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <vector>
 #include <AGZUtils/Misc/Common.h>
+#include <AGZUtils/Thread/DispatcherStatistics.h>
+#include <AGZUtils/Thread/ThreadPool.h>
 
 namespace AGZ {
 
@@ -21,6 +24,11 @@ namespace AGZ {
      *
      * StaticTaskDispatcher大致有两种使用方式。一是调用Run，将一组任务分配到一定数量的工作线程中，调用方将被阻塞，直到所有任务都被完成为止。
      * 二是调用RunAsync以异步地将任务分派出去，之后可以通过Join来等待所有任务完成，或通过IsCompleted来查询是否已经完成所有任务。
+     *
+     * 工作线程由内部的 ThreadPool 持有，在多次Run/RunAsync之间被复用，直到分派器析构时才退出。
+     *
+     * 任务可以以std::queue或std::vector的形式给出。对前者，工作线程每次获取任务锁时会领取（移动）至多 SetClaimBatchSize 个任务；
+     * 对后者，工作线程通过原子计数器领取任务下标，完全不需要加锁，适合大量细粒度任务。
      */
     template<typename TaskType, typename SharedParamType = NoSharedParam_t>
     class StaticTaskDispatcher
@@ -30,43 +38,98 @@ namespace AGZ {
         mutable std::mutex exceptionMut_;
 
         std::queue<TaskType> tasks_;
-        std::vector<std::thread> workers_;
         std::vector<std::exception> exceptions_;
 
+        std::vector<TaskType> taskArray_;
+        std::atomic<size_t> nextTaskIndex_;
+        bool useTaskArray_;
+
+        size_t claimBatchSize_;
+        bool reserveCallingThread_;
+
         size_t initTaskCount_;
         std::atomic<size_t> finishedTaskCount_;
 
+        using TaskRecords = std::vector<std::vector<DispatcherStatistics::TaskRecord>>;
+
+        bool enableStatistics_;
+        TaskRecords taskRecords_;
+
         struct Params
         {
             const SharedParamType &sharedParam;
             std::queue<TaskType> &tasks;
             std::mutex &taskMut;
+            size_t claimBatchSize;
+
+            std::vector<TaskType> *taskArray; // 以std::queue给出任务时为nullptr
+            std::atomic<size_t> &nextTaskIndex;
 
             std::vector<std::exception> &exceptions;
             std::mutex &exceptionMut;
 
             std::atomic<size_t> &finishedTaskCount;
+
+            TaskRecords *taskRecords; // 未开启统计时为nullptr
+            std::chrono::steady_clock::time_point batchStart;
         };
 
         std::unique_ptr<Params> params_;
 
+        // 放在最后，以保证析构时先等待工作线程退出，再销毁它们引用的成员
+        ThreadPool pool_;
+
+        static uint64_t ElapsedNanoseconds(const Params &param)
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - param.batchStart).count());
+        }
+
         template<typename Func>
-        static void Worker(const Func &func, Params param)
+        static void Worker(const Func &func, Params param, int workerIndex)
         {
+            std::vector<TaskType> claimedTasks;
+            size_t nextClaimed = 0;
+
             for(;;)
             {
-                TaskType task;
+                DispatcherStatistics::TaskRecord record = { };
+                if(param.taskRecords)
+                    record.claimBegin = ElapsedNanoseconds(param);
+
+                TaskType *task;
+                if(param.taskArray)
                 {
-                    std::lock_guard<std::mutex> lk(param.taskMut);
-                    if(param.tasks.empty())
+                    size_t idx = param.nextTaskIndex.fetch_add(1, std::memory_order_relaxed);
+                    if(idx >= param.taskArray->size())
                         break;
-                    task = param.tasks.front();
-                    param.tasks.pop();
+                    task = &(*param.taskArray)[idx];
                 }
+                else
+                {
+                    if(nextClaimed == claimedTasks.size())
+                    {
+                        claimedTasks.clear();
+                        nextClaimed = 0;
+
+                        std::lock_guard<std::mutex> lk(param.taskMut);
+                        for(size_t i = 0; i < param.claimBatchSize && !param.tasks.empty(); ++i)
+                        {
+                            claimedTasks.push_back(std::move(param.tasks.front()));
+                            param.tasks.pop();
+                        }
+                    }
+                    if(nextClaimed == claimedTasks.size())
+                        break;
+                    task = &claimedTasks[nextClaimed++];
+                }
+
+                if(param.taskRecords)
+                    record.execBegin = ElapsedNanoseconds(param);
 
                 try
                 {
-                    func(task, param.sharedParam);
+                    func(*task, param.sharedParam);
                 }
                 catch(const std::exception &err)
                 {
@@ -80,10 +143,86 @@ namespace AGZ {
                         std::runtime_error("StaticTaskDispatcher: unknown exception"));
                 }
 
+                if(param.taskRecords)
+                {
+                    record.execEnd = ElapsedNanoseconds(param);
+                    (*param.taskRecords)[workerIndex].push_back(record);
+                }
+
                 ++param.finishedTaskCount;
             }
         }
 
+        void NewParams(const SharedParamType &sharedParam, int participantCount)
+        {
+            taskRecords_.clear();
+            if(enableStatistics_)
+                taskRecords_.resize(participantCount);
+
+            params_ = std::unique_ptr<Params>(new Params{
+                sharedParam, tasks_, taskMut_, claimBatchSize_,
+                useTaskArray_ ? &taskArray_ : nullptr, nextTaskIndex_,
+                exceptions_, exceptionMut_, finishedTaskCount_,
+                enableStatistics_ ? &taskRecords_ : nullptr, std::chrono::steady_clock::now() });
+        }
+
+        void SetTasks(std::queue<TaskType> &&tasks)
+        {
+            tasks_ = std::move(tasks);
+            taskArray_.clear();
+            useTaskArray_ = false;
+            initTaskCount_ = tasks_.size();
+        }
+
+        void SetTasks(std::vector<TaskType> &&tasks)
+        {
+            tasks_ = std::queue<TaskType>();
+            taskArray_ = std::move(tasks);
+            nextTaskIndex_ = 0;
+            useTaskArray_ = true;
+            initTaskCount_ = taskArray_.size();
+        }
+
+        template<typename Func, typename Tasks>
+        bool RunImpl(const Func &func, const SharedParamType &sharedParam, Tasks &&tasks)
+        {
+            pool_.Wait();
+            exceptions_.clear();
+
+            SetTasks(std::move(tasks));
+            finishedTaskCount_ = 0;
+            NewParams(sharedParam, workerCount_ + 1);
+
+            Params *params = params_.get();
+            if(reserveCallingThread_)
+                pool_.Dispatch([&func, params](int idx) { Worker(func, *params, idx); }, workerCount_ + 1);
+            else
+            {
+                if(workerCount_ > 0)
+                    pool_.Dispatch([&func, params](int idx) { Worker(func, *params, idx); }, workerCount_);
+                Worker(func, *params, workerCount_);
+            }
+
+            pool_.Wait();
+            params_ = nullptr;
+
+            return exceptions_.empty();
+        }
+
+        template<typename Func, typename Tasks>
+        void RunAsyncImpl(Func &&func, const SharedParamType &sharedParam, Tasks &&tasks)
+        {
+            pool_.Wait();
+            exceptions_.clear();
+
+            SetTasks(std::move(tasks));
+            finishedTaskCount_ = 0;
+            NewParams(sharedParam, workerCount_ + 1);
+
+            Params *params = params_.get();
+            pool_.Dispatch([func = std::forward<Func>(func), params](int idx) { Worker(func, *params, idx); }, workerCount_ + 1);
+        }
+
     public:
 
         /**
@@ -96,6 +235,62 @@ namespace AGZ {
             workerCount_ = (std::max)(1, workerCount) - 1;
             initTaskCount_ = 0;
             finishedTaskCount_ = 0;
+            nextTaskIndex_ = 0;
+            useTaskArray_ = false;
+            claimBatchSize_ = 1;
+            reserveCallingThread_ = false;
+            enableStatistics_ = false;
+        }
+
+        /**
+         * @brief 设置工作线程的放置选项（绑定CPU、线程命名），参见 WorkerThreadOptions
+         *
+         * Run在未设置 SetReserveCallingThread 时，编号为workerCount - 1的“工作线程”就是调用方线程，此选项不会影响调用方线程
+         *
+         * @return 对已创建的工作线程是否全部设置成功
+         */
+        bool SetWorkerOptions(WorkerThreadOptions options)
+        {
+            return pool_.SetWorkerOptions(std::move(options));
+        }
+
+        /**
+         * @brief 设置Run是否不在调用方线程上执行任务，默认为false
+         *
+         * 为true时，Run的全部任务都由线程池中的工作线程执行，调用方线程只负责等待，
+         * 从而使所有任务都运行在受 SetWorkerOptions 控制的线程上
+         */
+        void SetReserveCallingThread(bool reserve)
+        {
+            reserveCallingThread_ = reserve;
+        }
+
+        /**
+         * @brief 设置以std::queue给出任务时，工作线程每获取一次任务锁至多领取多少个任务，默认为1
+         *
+         * 任务数量很多且单个任务很短时，增大该值可以显著减少锁竞争，代价是任务在线程间的分配粒度变粗
+         */
+        void SetClaimBatchSize(size_t batchSize)
+        {
+            claimBatchSize_ = (std::max)(size_t(1), batchSize);
+        }
+
+        /**
+         * @brief 设置之后的Run/RunAsync是否记录执行统计数据，默认不记录
+         */
+        void EnableStatistics(bool enable)
+        {
+            enableStatistics_ = enable;
+        }
+
+        /**
+         * @brief 取得上一次Run或RunAsync的执行统计数据，须在任务完成（如Join返回）后调用
+         *
+         * 工作线程编号的含义同任务分配时的线程编号，未开启统计时返回的数据为空
+         */
+        DispatcherStatistics GetStatistics() const
+        {
+            return DispatcherStatistics(taskRecords_);
         }
 
         /**
@@ -107,24 +302,16 @@ namespace AGZ {
         template<typename Func>
         bool Run(const Func &func, const SharedParamType &sharedParam, std::queue<TaskType> &tasks)
         {
-            exceptions_.clear();
-
-            AGZ_ASSERT(workers_.empty());
-
-            tasks_ = std::move(tasks);
-            initTaskCount_ = tasks_.size();
-            finishedTaskCount_ = 0;
-            params_ = std::unique_ptr<Params>(new Params{ sharedParam, tasks_, taskMut_, exceptions_, exceptionMut_, finishedTaskCount_ });
-
-            for(int i = 0; i < workerCount_; ++i)
-                workers_.emplace_back(&Worker<Func>, func, *params_);
-            Worker(func, *params_);
-
-            for(auto &worker : workers_)
-                worker.join();
-            workers_.clear();
+            return RunImpl(func, sharedParam, std::move(tasks));
+        }
 
-            return exceptions_.empty();
+        /**
+         * @brief 同上，但工作线程通过原子计数器领取任务，领取过程不需要加锁
+         */
+        template<typename Func>
+        bool Run(const Func &func, const SharedParamType &sharedParam, std::vector<TaskType> &tasks)
+        {
+            return RunImpl(func, sharedParam, std::move(tasks));
         }
 
         /**
@@ -133,17 +320,16 @@ namespace AGZ {
         template<typename Func>
         void RunAsync(Func &&func, const SharedParamType &sharedParam, std::queue<TaskType> tasks)
         {
-            exceptions_.clear();
-
-            AGZ_ASSERT(workers_.empty());
-
-            tasks_ = std::move(tasks);
-            initTaskCount_ = tasks_.size();
-            finishedTaskCount_ = 0;
-            params_ = std::unique_ptr<Params>(new Params{ sharedParam, tasks_, taskMut_, exceptions_, exceptionMut_, finishedTaskCount_ });
+            RunAsyncImpl(std::forward<Func>(func), sharedParam, std::move(tasks));
+        }
 
-            for(int i = 0; i < workerCount_ + 1; ++i)
-                workers_.emplace_back(&Worker<Func>, func, *params_);
+        /**
+         * @brief 同上，但工作线程通过原子计数器领取任务，领取过程不需要加锁
+         */
+        template<typename Func>
+        void RunAsync(Func &&func, const SharedParamType &sharedParam, std::vector<TaskType> tasks)
+        {
+            RunAsyncImpl(std::forward<Func>(func), sharedParam, std::move(tasks));
         }
 
         /**
@@ -153,12 +339,7 @@ namespace AGZ {
          */
         bool Join()
         {
-            for(auto &worker : workers_)
-            {
-                if(worker.joinable())
-                    worker.join();
-            }
-            workers_.clear();
+            pool_.Wait();
             params_ = nullptr;
             return exceptions_.empty();
         }
@@ -170,6 +351,9 @@ namespace AGZ {
 
         /**
          * @brief 直接终止之前分配的任务
+         *
+         * 已被工作线程领取的任务仍会被执行完毕
+         *
          * @return 已执行的任务中是否发生了异常
          */
         bool Stop()
@@ -179,6 +363,7 @@ namespace AGZ {
                 std::queue<TaskType> tTasks;
                 tasks_.swap(tTasks);
             }
+            nextTaskIndex_ = taskArray_.size();
             return Join();
         }
 
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "../Misc/Common.h"
+#include "../Misc/Exception.h"
+#include "WorkStealingScheduler.h"
+
+namespace AGZ {
+
+/**
+ * @brief 带依赖关系的任务图
+ *
+ * 每个节点是一个任务，可以声明若干前驱节点。执行时，一个节点会在其所有前驱都完成后立即被提交到
+ * WorkStealingScheduler 中，因此互不依赖的任务链可以相互重叠，而不必在各阶段之间设置同步点。
+ *
+ * 同一个任务图可以被多次执行，但不能同时被多次执行。
+ */
+class TaskGraph : public Uncopiable
+{
+public:
+
+    using NodeID = size_t;
+
+private:
+
+    struct Node
+    {
+        std::function<void()> func;
+        std::vector<NodeID> successors;
+        size_t predecessorCount = 0;
+
+        std::atomic<size_t> remaining = 0;
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+
+    void Launch(WorkStealingScheduler &scheduler, TaskGroup &group, Node *node)
+    {
+        scheduler.Spawn(group, [this, &scheduler, &group, node]
+        {
+            // 若抛出异常，则后继节点不会被执行
+            node->func();
+
+            for(NodeID succ : node->successors)
+            {
+                Node *s = nodes_[succ].get();
+                if(s->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    Launch(scheduler, group, s);
+            }
+        });
+    }
+
+    bool HasCycle() const
+    {
+        std::vector<size_t> remaining(nodes_.size());
+        std::vector<NodeID> ready;
+        for(NodeID i = 0; i < nodes_.size(); ++i)
+        {
+            remaining[i] = nodes_[i]->predecessorCount;
+            if(!remaining[i])
+                ready.push_back(i);
+        }
+
+        size_t visited = 0;
+        while(!ready.empty())
+        {
+            NodeID id = ready.back();
+            ready.pop_back();
+            ++visited;
+            for(NodeID succ : nodes_[id]->successors)
+            {
+                if(!--remaining[succ])
+                    ready.push_back(succ);
+            }
+        }
+        return visited != nodes_.size();
+    }
+
+public:
+
+    /**
+     * @brief 添加一个节点
+     *
+     * @param func 节点任务，以func()的形式调用
+     * @param predecessors 前驱节点列表，它们须已被添加到本任务图中
+     *
+     * @return 新节点的ID
+     */
+    template<typename Func>
+    NodeID AddNode(Func &&func, std::initializer_list<NodeID> predecessors = {})
+    {
+        NodeID id = nodes_.size();
+        auto node = std::make_unique<Node>();
+        node->func = std::forward<Func>(func);
+        nodes_.push_back(std::move(node));
+
+        for(NodeID pred : predecessors)
+            AddDependency(pred, id);
+        return id;
+    }
+
+    /**
+     * @brief 声明successor须在predecessor完成后才能执行
+     *
+     * @exception ArgumentException 节点ID非法时抛出
+     */
+    void AddDependency(NodeID predecessor, NodeID successor)
+    {
+        if(predecessor >= nodes_.size() || successor >= nodes_.size() || predecessor == successor)
+            throw ArgumentException("TaskGraph: invalid dependency");
+        nodes_[predecessor]->successors.push_back(successor);
+        ++nodes_[successor]->predecessorCount;
+    }
+
+    /**
+     * @brief 节点数量
+     */
+    size_t GetNodeCount() const noexcept
+    {
+        return nodes_.size();
+    }
+
+    /**
+     * @brief 执行所有节点，直到没有可执行的节点为止
+     *
+     * 若某个节点抛出异常，它的所有后继都不会被执行，其余节点照常执行，第一个异常会在结束时被重新抛出
+     *
+     * @exception ArgumentException 依赖关系中存在环时抛出
+     */
+    void Run(WorkStealingScheduler &scheduler)
+    {
+        if(HasCycle())
+            throw ArgumentException("TaskGraph: dependency cycle detected");
+
+        for(auto &node : nodes_)
+            node->remaining.store(node->predecessorCount, std::memory_order_relaxed);
+
+        TaskGroup group;
+        for(auto &node : nodes_)
+        {
+            if(!node->predecessorCount)
+                Launch(scheduler, group, node.get());
+        }
+        scheduler.Wait(group);
+    }
+};
+
+} // namespace AGZ
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Misc/Common.h"
+
+#if defined(AGZ_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace AGZ {
+
+/**
+ * @brief 工作线程的放置选项
+ *
+ * 目前仅在Linux上生效，其他平台上设置非空的选项总是失败
+ */
+struct WorkerThreadOptions
+{
+    //! 非空时，第i个工作线程被绑定到编号为cpus[i % cpus.size()]的CPU上。通过 SetWorkerOptions 设为空时，已创建的工作线程恢复为其创建时（继承自创建它的线程）的CPU集合
+    std::vector<int> cpus;
+
+    //! 非空时，第i个工作线程被命名为namePrefix + std::to_string(i)，以便在profiler中辨认。Linux上超过15个字符的部分会被截去
+    std::string namePrefix;
+};
+
+namespace ThreadImpl
+{
+    /**
+     * @brief 对第index个工作线程应用放置选项
+     *
+     * @return 是否全部成功
+     */
+    inline bool ApplyWorkerThreadOptions(std::thread &thread, int index, const WorkerThreadOptions &options)
+    {
+#if defined(AGZ_OS_LINUX)
+        bool ret = true;
+
+        if(!options.cpus.empty())
+        {
+            int cpu = options.cpus[static_cast<size_t>(index) % options.cpus.size()];
+            if(cpu < 0 || cpu >= CPU_SETSIZE)
+                ret = false;
+            else
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                ret &= !pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+            }
+        }
+
+        if(!options.namePrefix.empty())
+        {
+            std::string name = (options.namePrefix + std::to_string(index)).substr(0, 15);
+            ret &= !pthread_setname_np(thread.native_handle(), name.c_str());
+        }
+
+        return ret;
+#else
+        (void)thread; (void)index;
+        return options.cpus.empty() && options.namePrefix.empty();
+#endif
+    }
+
+#if defined(AGZ_OS_LINUX)
+    using AffinityMask = cpu_set_t;
+#else
+    struct AffinityMask { };
+#endif
+
+    /**
+     * @brief 取得线程当前的CPU集合，以便之后通过 RestoreWorkerThreadAffinity 恢复
+     */
+    inline AffinityMask GetWorkerThreadAffinity(std::thread &thread)
+    {
+        AffinityMask ret;
+#if defined(AGZ_OS_LINUX)
+        CPU_ZERO(&ret);
+        if(pthread_getaffinity_np(thread.native_handle(), sizeof(ret), &ret))
+        {
+            // 取得失败时退化为不限制，内核会将其与实际可用的CPU取交集
+            for(int i = 0; i < CPU_SETSIZE; ++i)
+                CPU_SET(i, &ret);
+        }
+#else
+        (void)thread;
+#endif
+        return ret;
+    }
+
+    /**
+     * @brief 将线程的CPU集合恢复为mask
+     */
+    inline bool RestoreWorkerThreadAffinity(std::thread &thread, const AffinityMask &mask)
+    {
+#if defined(AGZ_OS_LINUX)
+        return !pthread_setaffinity_np(thread.native_handle(), sizeof(mask), &mask);
+#else
+        (void)thread; (void)mask;
+        return true;
+#endif
+    }
+
+} // namespace ThreadImpl
+
+/**
+ * @brief 取得调用方线程可以在其上运行的CPU编号列表，不支持的平台上返回空列表
+ */
+inline std::vector<int> GetCurrentThreadAffinity()
+{
+    std::vector<int> ret;
+#if defined(AGZ_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(!pthread_getaffinity_np(pthread_self(), sizeof(set), &set))
+    {
+        for(int i = 0; i < CPU_SETSIZE; ++i)
+        {
+            if(CPU_ISSET(i, &set))
+                ret.push_back(i);
+        }
+    }
+#endif
+    return ret;
+}
+
+/**
+ * @brief 常驻工作线程池
+ *
+ * 工作线程在第一次被需要时创建，之后在两批工作之间阻塞于条件变量上，直到线程池析构时才退出，
+ * 从而避免每次分派任务都要创建和销毁线程的开销。
+ *
+ * 每次调用 Dispatch 分派一批工作：工作函数会在指定数量的线程上各被调用一次，参数为线程在本批中的编号。
+ * 同一时刻至多只有一批工作在执行，在前一批工作被 Wait 之前，新的 Dispatch 会阻塞。
+ */
+class ThreadPool : public Uncopiable
+{
+    mutable std::mutex mut_;
+    std::condition_variable workerCV_; // 有新的一批工作或线程池即将析构
+    std::condition_variable doneCV_;   // 当前批次的某个线程已完成
+    std::condition_variable idleCV_;   // 当前批次已被Wait
+
+    std::vector<std::thread> threads_;
+    std::vector<ThreadImpl::AffinityMask> initAffinities_; // 各工作线程创建时的CPU集合
+
+    std::function<void(int)> batchFunc_;
+    int batchWorkerCount_ = 0;
+    uint64_t batchID_     = 0;
+    int runningCount_     = 0;
+    bool busy_            = false;
+    bool exit_            = false;
+
+    std::exception_ptr exception_;
+
+    WorkerThreadOptions options_;
+
+    static const ThreadPool *&CurrentPool() noexcept
+    {
+        static thread_local const ThreadPool *pool = nullptr;
+        return pool;
+    }
+
+    void WorkerMain(int index)
+    {
+        CurrentPool() = this;
+
+        uint64_t lastBatchID = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> lk(mut_);
+                workerCV_.wait(lk, [&]
+                {
+                    return exit_ || (batchID_ != lastBatchID && index < batchWorkerCount_);
+                });
+                if(exit_)
+                    return;
+                lastBatchID = batchID_;
+            }
+
+            // 在Wait返回之前，batchFunc_不会被修改，因此可以在锁外调用
+            std::exception_ptr err;
+            try
+            {
+                batchFunc_(index);
+            }
+            catch(...)
+            {
+                err = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lk(mut_);
+            if(err && !exception_)
+                exception_ = err;
+            if(!--runningCount_)
+                doneCV_.notify_all();
+        }
+    }
+
+public:
+
+    /**
+     * @param initWorkerCount 预先创建的线程数量，其余线程会在 Dispatch 需要时再创建
+     */
+    explicit ThreadPool(int initWorkerCount = 0)
+    {
+        if(initWorkerCount > 0)
+            Reserve(initWorkerCount);
+    }
+
+    /**
+     * @brief 等待当前的一批工作完成，然后结束所有工作线程
+     */
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lk(mut_);
+            doneCV_.wait(lk, [&] { return !runningCount_; });
+            exit_ = true;
+        }
+        workerCV_.notify_all();
+        for(auto &t : threads_)
+            t.join();
+    }
+
+    /**
+     * @brief 确保线程池中至少有workerCount个工作线程
+     */
+    void Reserve(int workerCount)
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        while(static_cast<int>(threads_.size()) < workerCount)
+        {
+            int index = static_cast<int>(threads_.size());
+            threads_.emplace_back(&ThreadPool::WorkerMain, this, index);
+            initAffinities_.push_back(ThreadImpl::GetWorkerThreadAffinity(threads_.back()));
+            ThreadImpl::ApplyWorkerThreadOptions(threads_.back(), index, options_);
+        }
+    }
+
+    /**
+     * @brief 设置工作线程的放置选项，对已创建和之后创建的工作线程均有效
+     *
+     * @return 对已创建的工作线程是否全部设置成功
+     */
+    bool SetWorkerOptions(WorkerThreadOptions options)
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        options_ = std::move(options);
+
+        bool ret = true;
+        for(size_t i = 0; i < threads_.size(); ++i)
+        {
+            if(options_.cpus.empty())
+                ret &= ThreadImpl::RestoreWorkerThreadAffinity(threads_[i], initAffinities_[i]);
+            ret &= ThreadImpl::ApplyWorkerThreadOptions(threads_[i], static_cast<int>(i), options_);
+        }
+        return ret;
+    }
+
+    /**
+     * @brief 线程池中已创建的工作线程数量
+     */
+    int GetWorkerCount() const
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        return static_cast<int>(threads_.size());
+    }
+
+    /**
+     * @brief 调用方是否是本线程池中的工作线程，或正处于本线程池的 ParticipantScope 中
+     *
+     * 在这样的线程中再向同一线程池分派工作会导致死锁，可用此函数检测这种情况
+     */
+    bool IsInWorkerThread() const noexcept
+    {
+        return CurrentPool() == this;
+    }
+
+    /**
+     * @brief 在其生命周期内，将调用方线程标记为正在参与线程池当前的一批工作
+     *
+     * 分派工作后自己也参与计算的调用方应在参与期间使用此标记。此时当前批次尚未被 Wait，
+     * 再向同一线程池分派工作会死锁，而 IsInWorkerThread 会对调用方返回true，以便退化为串行执行。可以嵌套
+     */
+    class ParticipantScope : public Uncopiable
+    {
+        const ThreadPool *prev_;
+
+    public:
+
+        explicit ParticipantScope(const ThreadPool &pool) noexcept
+            : prev_(CurrentPool())
+        {
+            CurrentPool() = &pool;
+        }
+
+        ~ParticipantScope()
+        {
+            CurrentPool() = prev_;
+        }
+    };
+
+    /**
+     * @brief 分派一批工作后立即返回
+     *
+     * func会在workerCount个工作线程上各被调用一次，参数为[0, workerCount)中的线程编号。
+     * 若之前分派的工作尚未被 Wait，会先阻塞等待其被 Wait。
+     */
+    void Dispatch(std::function<void(int)> func, int workerCount)
+    {
+        AGZ_ASSERT(!IsInWorkerThread());
+
+        Reserve(workerCount);
+
+        {
+            std::unique_lock<std::mutex> lk(mut_);
+            idleCV_.wait(lk, [&] { return !busy_; });
+
+            busy_             = true;
+            batchFunc_        = std::move(func);
+            batchWorkerCount_ = workerCount;
+            runningCount_     = workerCount;
+            exception_        = nullptr;
+            ++batchID_;
+        }
+        workerCV_.notify_all();
+    }
+
+    /**
+     * @brief 等待之前分派的一批工作完成
+     *
+     * 若某个工作线程中抛出了异常，会将第一个被捕获的异常重新抛出
+     */
+    void Wait()
+    {
+        std::exception_ptr err;
+        {
+            std::unique_lock<std::mutex> lk(mut_);
+            doneCV_.wait(lk, [&] { return !runningCount_; });
+            if(!busy_)
+                return;
+            busy_ = false;
+            batchFunc_ = std::function<void(int)>();
+            err = exception_;
+            exception_ = nullptr;
+        }
+        idleCV_.notify_all();
+
+        if(err)
+            std::rethrow_exception(err);
+    }
+
+    /**
+     * @brief 之前分派的一批工作是否已经全部完成
+     */
+    bool IsCompleted() const
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        return !runningCount_;
+    }
+};
+
+} // namespace AGZ
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../Misc/Common.h"
+
+namespace AGZ {
+
+namespace ThreadImpl
+{
+    /**
+     * @brief Chase-Lev工作窃取双端队列
+     *
+     * 只有持有者线程可以调用Push/Pop，在底端操作；其他任意线程可以调用Steal，从顶端取走元素。
+     * 容量不足时自动扩展为原来的两倍，旧数组在队列析构时才释放，以免窃取者读到已释放的内存。
+     *
+     * 参见 Lê et al. Correct and Efficient Work-Stealing for Weak Memory Models, PPoPP 2013
+     *
+     * @tparam T 元素类型，须为平凡可复制的类型（通常为指针）
+     */
+    template<typename T>
+    class ChaseLevDeque : public Uncopiable
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        struct Array
+        {
+            int64_t mask;
+            std::unique_ptr<std::atomic<T>[]> data;
+
+            explicit Array(int64_t capacity)
+                : mask(capacity - 1), data(new std::atomic<T>[static_cast<size_t>(capacity)])
+            {
+                AGZ_ASSERT(capacity > 0 && !(capacity & mask));
+            }
+
+            int64_t Capacity() const noexcept { return mask + 1; }
+
+            T Get(int64_t i) const noexcept
+            {
+                return data[static_cast<size_t>(i & mask)].load(std::memory_order_relaxed);
+            }
+
+            void Put(int64_t i, T value) noexcept
+            {
+                data[static_cast<size_t>(i & mask)].store(value, std::memory_order_relaxed);
+            }
+        };
+
+        alignas(64) std::atomic<int64_t> top_;
+        alignas(64) std::atomic<int64_t> bottom_;
+        std::atomic<Array*> array_;
+
+        std::vector<std::unique_ptr<Array>> arrays_;
+
+        Array *Grow(Array *old, int64_t bottom, int64_t top)
+        {
+            auto newArr = std::make_unique<Array>(2 * old->Capacity());
+            for(int64_t i = top; i < bottom; ++i)
+                newArr->Put(i, old->Get(i));
+            Array *ret = newArr.get();
+            arrays_.push_back(std::move(newArr));
+            array_.store(ret, std::memory_order_release);
+            return ret;
+        }
+
+    public:
+
+        /**
+         * @param initCapacity 初始容量，须为2的整数次幂
+         */
+        explicit ChaseLevDeque(int64_t initCapacity = 256)
+            : top_(0), bottom_(0)
+        {
+            arrays_.push_back(std::make_unique<Array>(initCapacity));
+            array_.store(arrays_.back().get(), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 在底端压入一个元素，仅可由持有者线程调用
+         */
+        void Push(T value)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            Array *a = array_.load(std::memory_order_relaxed);
+            if(b - t > a->Capacity() - 1)
+                a = Grow(a, b, t);
+            a->Put(b, value);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 从底端弹出一个元素，仅可由持有者线程调用
+         *
+         * @return 队列为空时返回false
+         */
+        bool Pop(T *value)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            Array *a = array_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+
+            if(t > b)
+            {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            *value = a->Get(b);
+            if(t == b)
+            {
+                // 最后一个元素，需要和窃取者竞争
+                bool won = top_.compare_exchange_strong(
+                    t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        /**
+         * @brief 从顶端窃取一个元素，可由任意线程调用
+         *
+         * @return 队列为空或与其他线程竞争失败时返回false
+         */
+        bool Steal(T *value)
+        {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if(t >= b)
+                return false;
+
+            Array *a = array_.load(std::memory_order_acquire);
+            T ret = a->Get(t);
+            if(!top_.compare_exchange_strong(
+                    t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return false;
+            *value = ret;
+            return true;
+        }
+
+        /**
+         * @brief 队列是否为空。并发访问时结果仅供参考
+         */
+        bool Empty() const noexcept
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            return b <= t;
+        }
+    };
+
+} // namespace ThreadImpl
+
+/**
+ * @brief 一组任务的完成计数器，用于等待由 WorkStealingScheduler::Spawn 创建的任务
+ *
+ * 必须在等待其中所有任务完成之后才能被销毁
+ */
+class TaskGroup : public Uncopiable
+{
+    friend class WorkStealingScheduler;
+
+    std::atomic<size_t> pending_ = 0;
+
+    std::mutex exceptionMut_;
+    std::exception_ptr exception_;
+
+    void SetException(std::exception_ptr err)
+    {
+        std::lock_guard<std::mutex> lk(exceptionMut_);
+        if(!exception_)
+            exception_ = err;
+    }
+
+public:
+
+    TaskGroup() = default;
+
+    ~TaskGroup()
+    {
+        AGZ_ASSERT(IsCompleted());
+    }
+
+    /**
+     * @brief 组中的任务是否已经全部完成
+     */
+    bool IsCompleted() const noexcept
+    {
+        return !pending_.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * @brief 工作窃取任务调度器
+ *
+ * 每个工作线程持有一个 ThreadImpl::ChaseLevDeque，新任务压入当前线程自己的队列，
+ * 空闲的工作线程从随机选取的其他线程的队列顶端窃取任务。任务中可以继续 Spawn 子任务并 Wait 它们，
+ * 等待期间当前线程会继续执行其他任务而不是阻塞，因此适合递归分治的工作负载。
+ *
+ * 非工作线程提交的任务会进入一个共享的注入队列。
+ */
+class WorkStealingScheduler : public Uncopiable
+{
+    struct Task
+    {
+        TaskGroup *group = nullptr;
+
+        virtual ~Task() = default;
+
+        virtual void Run() = 0;
+    };
+
+    template<typename Func>
+    struct FuncTask : Task
+    {
+        Func func;
+
+        explicit FuncTask(Func &&f) : func(std::move(f)) { }
+        explicit FuncTask(const Func &f) : func(f) { }
+
+        void Run() override { func(); }
+    };
+
+    struct alignas(64) Worker
+    {
+        ThreadImpl::ChaseLevDeque<Task*> deque;
+        std::thread thread;
+        uint32_t rng = 0;
+
+        // 只由该工作线程自己写入
+        std::atomic<size_t> executedCount = 0;
+        std::atomic<size_t> stealCount    = 0;
+    };
+
+    struct Context
+    {
+        WorkStealingScheduler *scheduler = nullptr;
+        int index = -1;
+    };
+
+    static Context &CurrentContext() noexcept
+    {
+        static thread_local Context context;
+        return context;
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex injectMut_;
+    std::deque<Task*> injectQueue_;
+    std::atomic<size_t> injectCount_ = 0;
+
+    std::mutex sleepMut_;
+    std::condition_variable sleepCV_;
+    std::atomic<int> sleepingCount_ = 0;
+    bool stop_ = false;
+
+    static uint32_t NextRandom(uint32_t &state) noexcept
+    {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    int CurrentWorkerIndex() const noexcept
+    {
+        auto &ctx = CurrentContext();
+        return ctx.scheduler == this ? ctx.index : -1;
+    }
+
+    void Push(Task *task)
+    {
+        int index = CurrentWorkerIndex();
+        if(index >= 0)
+            workers_[index]->deque.Push(task);
+        else
+        {
+            std::lock_guard<std::mutex> lk(injectMut_);
+            injectQueue_.push_back(task);
+            injectCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 与WorkerMain中的sleepingCount_自增及HasVisibleTask构成Dekker式同步，保证唤醒不会丢失
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleepingCount_.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lk(sleepMut_);
+            sleepCV_.notify_one();
+        }
+    }
+
+    bool PopInjected(Task **task)
+    {
+        if(!injectCount_.load(std::memory_order_relaxed))
+            return false;
+        std::lock_guard<std::mutex> lk(injectMut_);
+        if(injectQueue_.empty())
+            return false;
+        *task = injectQueue_.front();
+        injectQueue_.pop_front();
+        injectCount_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool TrySteal(int selfIndex, Task **task)
+    {
+        int workerCount = static_cast<int>(workers_.size());
+
+        uint32_t rng;
+        if(selfIndex >= 0)
+            rng = NextRandom(workers_[selfIndex]->rng);
+        else
+        {
+            static thread_local uint32_t externalRNG = 0x9e3779b9u;
+            rng = NextRandom(externalRNG);
+        }
+
+        int start = static_cast<int>(rng % static_cast<uint32_t>(workerCount));
+        for(int i = 0; i < workerCount; ++i)
+        {
+            int victim = (start + i) % workerCount;
+            if(victim != selfIndex && workers_[victim]->deque.Steal(task))
+                return true;
+        }
+        return false;
+    }
+
+    bool FindTask(int selfIndex, Task **task)
+    {
+        if(selfIndex < 0)
+            return PopInjected(task) || TrySteal(selfIndex, task);
+
+        Worker &self = *workers_[selfIndex];
+        if(self.deque.Pop(task) || PopInjected(task))
+            return true;
+        if(TrySteal(selfIndex, task))
+        {
+            self.stealCount.store(self.stealCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void ExecuteOn(int selfIndex, Task *task)
+    {
+        Execute(task);
+        if(selfIndex >= 0)
+        {
+            auto &cnt = workers_[selfIndex]->executedCount;
+            cnt.store(cnt.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    bool HasVisibleTask() const noexcept
+    {
+        if(injectCount_.load(std::memory_order_relaxed))
+            return true;
+        for(auto &w : workers_)
+        {
+            if(!w->deque.Empty())
+                return true;
+        }
+        return false;
+    }
+
+    static void Execute(Task *task)
+    {
+        TaskGroup *group = task->group;
+        try
+        {
+            task->Run();
+        }
+        catch(...)
+        {
+            group->SetException(std::current_exception());
+        }
+        delete task;
+
+        // 计数归零后group可能立即被销毁，之后不能再访问它
+        group->pending_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void WorkerMain(int index)
+    {
+        CurrentContext() = { this, index };
+
+        constexpr int SPIN_COUNT = 64;
+        int idleRounds = 0;
+
+        for(;;)
+        {
+            Task *task;
+            if(FindTask(index, &task))
+            {
+                ExecuteOn(index, task);
+                idleRounds = 0;
+                continue;
+            }
+
+            if(++idleRounds < SPIN_COUNT)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            idleRounds = 0;
+
+            std::unique_lock<std::mutex> lk(sleepMut_);
+            if(stop_)
+                return;
+            sleepingCount_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(!HasVisibleTask())
+                sleepCV_.wait(lk);
+            sleepingCount_.fetch_sub(1, std::memory_order_relaxed);
+            if(stop_)
+                return;
+        }
+    }
+
+public:
+
+    /**
+     * @brief 单个工作线程的执行统计
+     */
+    struct WorkerStatistics
+    {
+        size_t executedCount; //!< 执行的任务数量
+        size_t stealCount;    //!< 从其他工作线程窃取到的任务数量
+    };
+
+    /**
+     * @param workerCount 工作线程数量，为非正数时使用硬件线程数
+     */
+    explicit WorkStealingScheduler(int workerCount = 0)
+    {
+        if(workerCount <= 0)
+            workerCount = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = (std::max)(1, workerCount);
+
+        for(int i = 0; i < workerCount; ++i)
+        {
+            workers_.push_back(std::make_unique<Worker>());
+            workers_.back()->rng = 0x9e3779b9u * static_cast<uint32_t>(i + 1);
+        }
+        for(int i = 0; i < workerCount; ++i)
+            workers_[i]->thread = std::thread(&WorkStealingScheduler::WorkerMain, this, i);
+    }
+
+    /**
+     * @brief 结束所有工作线程。调用前须等待所有已提交的任务完成
+     */
+    ~WorkStealingScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleepMut_);
+            stop_ = true;
+        }
+        sleepCV_.notify_all();
+        for(auto &w : workers_)
+            w->thread.join();
+
+        Task *task;
+        for(auto &w : workers_)
+        {
+            while(w->deque.Pop(&task))
+                delete task;
+        }
+        for(auto t : injectQueue_)
+            delete t;
+    }
+
+    /**
+     * @brief 工作线程数量
+     */
+    int GetWorkerCount() const noexcept
+    {
+        return static_cast<int>(workers_.size());
+    }
+
+    /**
+     * @brief 取得某个工作线程自调度器创建以来的执行统计。并发访问时结果仅供参考
+     */
+    WorkerStatistics GetWorkerStatistics(int worker) const
+    {
+        auto &w = *workers_[worker];
+        return { w.executedCount.load(std::memory_order_relaxed), w.stealCount.load(std::memory_order_relaxed) };
+    }
+
+    /**
+     * @brief 提交一个任务，它被视为group中的一员
+     *
+     * 可以在任意线程中调用，包括在其他任务中。
+     *
+     * @param group 任务所属的组，须在对它调用 Wait 后才能被销毁
+     * @param func 任务函数，以func()的形式调用
+     */
+    template<typename Func>
+    void Spawn(TaskGroup &group, Func &&func)
+    {
+        Task *task = new FuncTask<remove_rcv_t<Func>>(std::forward<Func>(func));
+        task->group = &group;
+        group.pending_.fetch_add(1, std::memory_order_relaxed);
+        Push(task);
+    }
+
+    /**
+     * @brief 等待group中的任务全部完成
+     *
+     * 等待期间当前线程会帮助执行其他任务。若组中的某个任务抛出了异常，会将第一个被捕获的异常重新抛出
+     */
+    void Wait(TaskGroup &group)
+    {
+        int index = CurrentWorkerIndex();
+        while(!group.IsCompleted())
+        {
+            Task *task;
+            if(FindTask(index, &task))
+                ExecuteOn(index, task);
+            else
+                std::this_thread::yield();
+        }
+
+        std::exception_ptr err;
+        {
+            std::lock_guard<std::mutex> lk(group.exceptionMut_);
+            err = group.exception_;
+            group.exception_ = nullptr;
+        }
+        if(err)
+            std::rethrow_exception(err);
+    }
+
+    /**
+     * @brief 提交一个任务并等待它完成
+     */
+    template<typename Func>
+    void Run(Func &&func)
+    {
+        TaskGroup group;
+        Spawn(group, std::forward<Func>(func));
+        Wait(group);
+    }
+};
+
+} // namespace AGZ
@@ -2,4 +2,6 @@
 
 #include "../Container/AccumulateBuffer.h"
 #include "../Container/AccumulatorAndFetcher.h"
+#include "../Container/MPMCQueue.h"
+#include "../Container/SPSCQueue.h"
 #include "../Container/SharedPtrPool.h"
@@ -2,6 +2,7 @@
 
 #include "../Misc/COWObject.h"
 #include "../Misc/Either.h"
+#include "../Misc/Hash.h"
 #include "../Misc/RefList.h"
 #include "../Misc/ScopeGuard.h"
 #include "../Misc/Singleton.h"
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "../String/NumConv.h"
 #include "../String/Regex/Regex.h"
 #include "../String/StdStr.h"
 #include "../String/String/String.h"
 #include "../String/String/String.inl"
+#include "../String/String/Intern.h"
+#include "../String/String/Rope.h"
+#include "../String/String/StringArena.h"
@@ -1,3 +1,10 @@
 #pragma once
 
+#include "../Thread/DispatcherStatistics.h"
+#include "../Thread/DynamicTaskDispatcher.h"
+#include "../Thread/ParallelFor.h"
+#include "../Thread/ParallelReduce.h"
 #include "../Thread/StaticTaskDispatcher.h"
+#include "../Thread/TaskGraph.h"
+#include "../Thread/ThreadPool.h"
+#include "../Thread/WorkStealingScheduler.h"
@@ -1,6 +1,10 @@
 #include <algorithm>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include <AGZUtils/Utils/Container.h>
 #include <AGZUtils/Utils/Math.h>
 #include <AGZUtils/Utils/Misc.h>
 
@@ -26,4 +30,69 @@ TEST_CASE("Buffer")
 
         REQUIRE(s2->length() == 10);
     }
+
+    SECTION("MPMCQueue")
+    {
+        MPMCQueue<std::string> q(3);
+        REQUIRE(q.GetCapacity() == 4);
+        REQUIRE(q.TryPush("a"));
+        REQUIRE(q.TryPush(std::string("b")));
+        std::string strs[] = { "c", "d", "e" };
+        REQUIRE(q.TryPushN(strs, 3) == 2);
+        REQUIRE(q.Pop() == "a");
+        std::vector<std::string> out;
+        REQUIRE(q.TryPopN(std::back_inserter(out), 10) == 3);
+        REQUIRE(out == std::vector<std::string>{ "b", "c", "d" });
+        REQUIRE(!q.TryPop(strs[0]));
+
+        struct ThrowOnCopy
+        {
+            int v = 0;
+            ThrowOnCopy() = default;
+            explicit ThrowOnCopy(int v) : v(v) { }
+            ThrowOnCopy(const ThrowOnCopy&) { throw std::runtime_error("copy"); }
+            ThrowOnCopy(ThrowOnCopy&&) noexcept = default;
+            ThrowOnCopy &operator=(ThrowOnCopy&&) noexcept = default;
+        };
+        MPMCQueue<ThrowOnCopy> tq(2);
+        ThrowOnCopy t(1);
+        REQUIRE_THROWS(tq.TryPush(t));
+        REQUIRE(tq.TryPush(ThrowOnCopy(2)));
+        REQUIRE(tq.Pop().v == 2);
+        REQUIRE(!tq.TryPop(t));
+
+        MPMCQueue<int> iq(64);
+        constexpr int N = 10000;
+        std::vector<std::thread> threads;
+        std::vector<long long> sums(2, 0);
+        for(int t = 0; t < 2; ++t)
+            threads.emplace_back([&, t] { for(int i = 0; i < N; ++i) iq.Push(i); });
+        for(int t = 0; t < 2; ++t)
+            threads.emplace_back([&, t] { for(int i = 0; i < N; ++i) sums[t] += iq.Pop(); });
+        for(auto &th : threads)
+            th.join();
+        REQUIRE(sums[0] + sums[1] == 2LL * N * (N - 1) / 2);
+    }
+
+    SECTION("SPSCQueue")
+    {
+        SPSCQueue<std::string> q(4);
+        std::string strs[] = { "a", "b", "c", "d", "e" };
+        REQUIRE(q.TryPushN(strs, 5) == 4);
+        REQUIRE(!q.TryPush("f"));
+        std::string s;
+        REQUIRE((q.TryPop(s) && s == "a"));
+        std::vector<std::string> out;
+        REQUIRE(q.TryPopN(std::back_inserter(out), 2) == 2);
+        REQUIRE(q.ApproxSize() == 1);
+
+        SPSCQueue<int> iq(16);
+        constexpr int N = 100000;
+        std::thread producer([&] { for(int i = 0; i < N; ++i) iq.Push(i); });
+        bool ordered = true;
+        for(int i = 0; i < N; ++i)
+            ordered &= iq.Pop() == i;
+        producer.join();
+        REQUIRE(ordered);
+    }
 }
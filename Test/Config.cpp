@@ -64,6 +64,10 @@ TEST_CASE("Config")
             REQUIRE(root["Window.Visible"].AsValue() == "False");
             REQUIRE(root["Angle"].AsArray().GetTag() == "Deg");
             REQUIRE(root["Angle"].AsArray().At(0)->AsValue() == "70.0");
+
+            auto window = root.FindChild(InternedStr8(Str8("Window")));
+            REQUIRE((window && window->AsGroup().FindChild(InternedStr8(Str8("Title")))->AsValue() == "AGZ Application"));
+            REQUIRE(!root.FindChild(InternedStr8(Str8("Window.Title"))));
         }
     }
 }
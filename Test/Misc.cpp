@@ -1,4 +1,5 @@
 #include <type_traits>
+#include <string>
 #include <AGZUtils/Utils/Misc.h>
 
 #include "Catch.hpp"
@@ -51,4 +52,21 @@ TEST_CASE("Misc")
         L2.Get<int>() = 10;
         REQUIRE(a == 10);
     }
+
+    SECTION("Hash")
+    {
+        // 覆盖各个长度分支：0、1~3、4~16、17~48以及超过48字节
+        std::string str(200, 'a');
+        for(size_t len : { 0, 1, 3, 4, 16, 17, 48, 49, 200 })
+        {
+            REQUIRE(HashBytes(str.data(), len) == HashBytes(std::string(str, 0, len).data(), len));
+            REQUIRE(HashBytes(str.data(), len, 1) != HashBytes(str.data(), len, 2));
+        }
+        for(size_t len = 1; len <= 64; ++len)
+            REQUIRE(HashBytes(str.data(), len) != HashBytes(str.data(), len - 1));
+
+        std::string s1 = str, s2 = str;
+        s2[100] = 'b';
+        REQUIRE(HashBytes(s1.data(), s1.size()) != HashBytes(s2.data(), s2.size()));
+    }
 }
@@ -1,4 +1,8 @@
-﻿#include <AGZUtils/Utils/String.h>
+﻿#include <atomic>
+#include <random>
+#include <thread>
+
+#include <AGZUtils/Utils/String.h>
 
 #include "Catch.hpp"
 
@@ -166,6 +170,252 @@ TEST_CASE("VMEngEx")
 
         REQUIRE(Regex8(u8"mine").Search(u8"abcminecraft"));
         REQUIRE(Regex32(u8"^mine").Search(u8"abcminecraft") == false);
+
+        REQUIRE(Regex8("b+").Search("abbcbbb").GetMatchedInterval() == std::make_pair<size_t, size_t>(1, 3));
+        REQUIRE(Regex8("a*").Search("xaa").GetMatchedInterval() == std::make_pair<size_t, size_t>(0, 0));
+        REQUIRE(Regex8("c$").Search("abcc").GetMatchedInterval() == std::make_pair<size_t, size_t>(3, 4));
+        REQUIRE(Regex8(u8"天气").Search(u8"今天天气").GetMatchedInterval() == std::make_pair<size_t, size_t>(6, 12));
+        REQUIRE(Regex8("a*").Match(""));
+    }
+
+    SECTION("LazyDFA")
+    {
+        REQUIRE(DFARegex8(u8"今天.*啊").Match(u8"今天天气不错啊"));
+        REQUIRE(!DFARegex8("mine|craft").Match("minecraft"));
+        REQUIRE(DFARegex8("@{[a-p]&[h-t]&!k|[+*?]}+").Match("hi?jl+mn*op"));
+        REQUIRE(!DFARegex8("@{[a-p]&[h-t]&!k}+").Match("hijklmnop"));
+        REQUIRE(WDFARegex(L"今天{ 3 , 5 }气不错啊").Match(u8"今天天天气不错啊"));
+        REQUIRE(DFARegex16(u8"今天(天气)+不错啊?\\?").Match(u8"今天天气天气天气天气不错?"));
+        REQUIRE_THROWS(DFARegex8(u8"今天{2, 1}天气不错啊"));
+
+        {
+            auto m = DFARegex8("&abc&([def]|\\d)+&abc").Match("abcddee0099ff44abc");
+            REQUIRE((m && m(0, 1) == "abc" && m(1, 2) == "ddee0099ff44"));
+        }
+
+        {
+            auto m = DFARegex16(u8"&abcde&$").Search(u8"minecraftabcde");
+            REQUIRE((m && m(0, 1) == u8"abcde"));
+        }
+
+        {
+            DFARegex8 regex(R"__(&(\w|-)+&)__");
+            Str8 s0 = "-_abcdefg  xsz0-";
+            REQUIRE(!regex.Match(s0));
+            REQUIRE(regex.SearchPrefix(s0)(0, 1) == "-_abcdefg");
+            REQUIRE(regex.SearchSuffix(s0)(0, 1) == "xsz0-");
+            REQUIRE(regex.Search(s0).GetMatchedInterval() == std::make_pair<size_t, size_t>(0, 9));
+        }
+
+        // Results should be the same as those of PikeVM
+        const char *regexes[] = {
+            "a|ab", "(a|ab)(c|bcd)", "^ab|b$", "b+", "a*", "$", "x?&(ab)+&c*", "[a-c]{2,3}b",
+            "@{!a}+", "(^a|b)c", "a.c|.b", "(a|b)*c(a|b)?", "^$", "(a?)*b", "(b*)+a",
+        };
+        const char *texts[] = {
+            "", "a", "ab", "abc", "abcd", "xabcd", "bbab", "cabcab", "aabbcc", "xyz", "abab", "ccbcba",
+        };
+        for(auto r : regexes)
+        {
+            Regex8 pike(r);
+            DFARegex8 dfa(r);
+            for(Str8 t : texts)
+            {
+                auto p = pike.Search(t), d = dfa.Search(t);
+                REQUIRE(bool(p) == bool(d));
+                if(p)
+                {
+                    REQUIRE(p.GetMatchedInterval() == d.GetMatchedInterval());
+                    for(size_t i = 0; i < p.SavePointCount(); ++i)
+                        REQUIRE(p[i] == d[i]);
+                }
+                REQUIRE(bool(pike.Match(t)) == bool(dfa.Match(t)));
+                REQUIRE(bool(pike.SearchPrefix(t)) == bool(dfa.SearchPrefix(t)));
+                if(auto s = pike.SearchSuffix(t))
+                    REQUIRE(s.GetMatchedInterval() == dfa.SearchSuffix(t).GetMatchedInterval());
+            }
+        }
+
+        {
+            // Large input, and more states than the cache can hold
+            Str8 text = Str8("ab") * 100000 + "c";
+            REQUIRE(DFARegex8("c").Search(text).GetMatchedStart() == 200000);
+            REQUIRE(DFARegex8("(a|b)*a(a|b){11}c").Search(text).GetMatchedInterval()
+                 == std::make_pair<size_t, size_t>(0, 200001));
+
+            std::string rnd;
+            for(uint32_t i = 0, x = 1; i < 50000; ++i, x = x * 1103515245 + 12345)
+                rnd += (x >> 16) & 1 ? 'a' : 'b';
+            text = Str8(rnd) + Str8("a") * 16 + "c";
+            REQUIRE(DFARegex8("a(a|b){15}c").Search(text).GetMatchedInterval()
+                 == Regex8("a(a|b){15}c").Search(text).GetMatchedInterval());
+        }
+    }
+
+    SECTION("Prefilter")
+    {
+        // Required literals: prefix "ab", suffix "d", inner "xyz"
+        Regex8 regex("ab(c|xyz)*xyz+d");
+        REQUIRE(regex.Search("abab abcxyzxyzzd").GetMatchedInterval() == std::make_pair<size_t, size_t>(5, 16));
+        REQUIRE(!regex.Search("abcxyzxyz"));
+        REQUIRE(!regex.Search("abcxyd"));
+        REQUIRE(!regex.Match("abxyzd_"));
+        REQUIRE(regex.SearchSuffix(Str8("xxabxyzd")).GetMatchedStart() == 2);
+
+        REQUIRE(Regex8("(ab){3}c").Search("abababababc").GetMatchedStart() == 4);
+        REQUIRE(Regex8("abc|abd").Search("abcabd").GetMatchedInterval() == std::make_pair<size_t, size_t>(0, 3));
+        REQUIRE(Regex8("a^b|ab").Search("xab").GetMatchedStart() == 1);
+        REQUIRE(Regex8("^ab").Search("abab").GetMatchedStart() == 0);
+        REQUIRE(!Regex8("^ab").Search("xabab"));
+        REQUIRE(Regex16(u8"天气(不错)?").Search(u8"今天天气不错").GetMatchedInterval()
+             == std::make_pair<size_t, size_t>(2, 6));
+
+        // Many candidates of the prefix before the match
+        Str8 text = Str8("error ") * 10000 + "error: 42";
+        REQUIRE(Regex8(R"__(error: &\d+&)__").Search(text)(0, 1) == "42");
+        REQUIRE(DFARegex8(R"__(error: &\d+&)__").Search(text)(0, 1) == "42");
+        REQUIRE(DFARegex8("r: 4").Search(text).GetMatchedStart() == 60004);
+
+        // Prefix longer than the SIMD searcher handles, searched through copies
+        Str8 longLit = Str8("0123456789") * 5;
+        Regex8 longRegex(longLit + "x+");
+        Regex8 longCopy = longRegex;
+        longRegex = Regex8("unrelated");
+        Str8 longText = Str8("0123456789") * 20 + "x";
+        REQUIRE(longCopy.Search(longText).GetMatchedInterval() == std::make_pair<size_t, size_t>(150, 201));
+        REQUIRE(!longCopy.Search(Str8("0123456789") * 20));
+    }
+
+    SECTION("SearchAll")
+    {
+        Str8 text = "k1=v1, key2=value2,k3=";
+        std::vector<std::pair<Str8, Str8>> kvs;
+        for(auto &m : Regex8("&\\w+&=&\\w*&").SearchAll(text))
+            kvs.emplace_back(m(0, 1), m(2, 3));
+        REQUIRE(kvs == std::vector<std::pair<Str8, Str8>>{ { "k1", "v1" }, { "key2", "value2" }, { "k3", "" } });
+
+        auto intervals = [](const auto &regex, const Str8 &str)
+        {
+            std::vector<std::pair<size_t, size_t>> ret;
+            for(auto &m : regex.SearchAll(str))
+                ret.push_back(m.GetMatchedInterval());
+            return ret;
+        };
+        using IV = std::vector<std::pair<size_t, size_t>>;
+
+        // Empty matches right after the previous one are skipped
+        REQUIRE(intervals(Regex8("a*"), "baaab") == IV{ { 0, 0 }, { 1, 4 }, { 5, 5 } });
+        REQUIRE(intervals(DFARegex8("a*"), "baaab") == IV{ { 0, 0 }, { 1, 4 }, { 5, 5 } });
+        REQUIRE(intervals(Regex8("z?"), u8"a今") == IV{ { 0, 0 }, { 1, 1 }, { 4, 4 } });
+        REQUIRE(intervals(Regex8("^a"), "aaa") == IV{ { 0, 1 } });
+        REQUIRE(intervals(DFARegex8("a|ab"), "ababab") == IV{ { 0, 1 }, { 2, 3 }, { 4, 5 } });
+        REQUIRE(intervals(DFARegex8("b$|a"), "abab") == IV{ { 0, 1 }, { 2, 3 }, { 3, 4 } });
+        REQUIRE(intervals(Regex8("x"), "abc").empty());
+
+        REQUIRE(Regex8("\\d+").ReplaceAll("a1b22c333", "#") == "a#b#c#");
+        REQUIRE(Regex8("z?").ReplaceAll("abc", "-") == "-a-b-c-");
+        REQUIRE(DFARegex8("o+").ReplaceAll("foo boo", "0") == "f0 b0");
+        REQUIRE(Regex16(u8"天(.)").ReplaceAll(u8"今天天气不错", u8"日") == u8"今日气不错");
+
+        Str8 csv = "a=1;bb=22;c=3";
+        auto swapped = Regex8("&\\w+&=&\\d+&").ReplaceAll(csv.AsView(), [](const MatchView<UTF8<>> &m)
+        {
+            return m(2, 3).AsString() + ":" + m(0, 1).AsString();
+        });
+        REQUIRE(swapped == "1:a;22:bb;3:c");
+    }
+
+    SECTION("RegexSet")
+    {
+        using IDX = std::vector<size_t>;
+
+        RegexSet8 set({ "error", "^warn", "\\d+ms$", "(a|b)*abb", "x?" });
+        REQUIRE(set.Size() == 5);
+        REQUIRE(set.Search("warn: error after 12ms") == IDX{ 0, 1, 2, 4 });
+        REQUIRE(set.Search("no warn in 12ms.") == IDX{ 4 });
+        REQUIRE(set.Search("babababb") == IDX{ 3, 4 });
+        REQUIRE(set.Search("") == IDX{ 4 });
+        REQUIRE(set.Match("babababb") == IDX{ 3 });
+        REQUIRE(set.Match("x") == IDX{ 4 });
+        REQUIRE(set.Match("error ").empty());
+
+        REQUIRE(RegexSet16({ u8"天.", u8"^今天$", u8"[a-c]+" }).Search(u8"今天天气") == IDX{ 0 });
+        REQUIRE(RegexSet32({ u8"天.", u8"^今天$", u8"[a-c]+" }).Match(u8"今天") == IDX{ 1 });
+        REQUIRE_THROWS_AS(RegexSet8({ "a", "(b" }), ArgumentException);
+        REQUIRE_THROWS_AS(RegexSet8(std::vector<Str8>()), ArgumentException);
+
+        // Same results as matching the patterns one by one
+        std::vector<Str8> patterns = { "a+b", "^ab", "b$", "(ab|ba)+", "a{2,3}", "[^ab]", "a.*b.*a" };
+        std::vector<Regex8> regexes(patterns.begin(), patterns.end());
+        RegexSet8 all(patterns);
+        std::mt19937 rng(42);
+        for(int i = 0; i < 500; ++i)
+        {
+            std::string cppStr;
+            for(int j = rng() % 8; j > 0; --j)
+                cppStr += "abc"[rng() % 3];
+            Str8 str(cppStr);
+            IDX searched, matched;
+            for(size_t k = 0; k < regexes.size(); ++k)
+            {
+                if(regexes[k].Search(str))
+                    searched.push_back(k);
+                if(regexes[k].Match(str))
+                    matched.push_back(k);
+            }
+            REQUIRE(all.Search(str) == searched);
+            REQUIRE(all.Match(str) == matched);
+        }
+
+        // Too many states to be cached
+        std::string cppText;
+        for(int i = 0; i < 100000; ++i)
+            cppText += "ab"[rng() % 2];
+        Str8 text(cppText);
+        RegexSet8 blowup({ "(a|b)*a(a|b){15}c", "b{30}", "a$" });
+        IDX expected;
+        if(Regex8("b{30}").Search(text))
+            expected.push_back(1);
+        if(text.EndsWith("a"))
+            expected.push_back(2);
+        REQUIRE(blowup.Search(text) == expected);
+        REQUIRE(blowup.Search(text + "a" + Str8("b") * 15 + "c").front() == 0);
+    }
+
+    SECTION("Concurrency")
+    {
+        // Loops with nullable bodies
+        REQUIRE(Regex8("(a?)*b").Match(Str8("a") * 1000 + "b"));
+        REQUIRE(Regex8("(a*)*b").Search(Str8("a") * 1000 + "c") == false);
+        REQUIRE(Regex8("&(x*)+&y").Search("axxxy")(0, 1) == "xxx");
+
+        Regex8 pike(R"__(&\d+&-&[a-z]+&)__");
+        DFARegex8 dfa(R"__(&\d+&-&[a-z]+&)__");
+
+        // Both engines are shared by all threads without being copied
+        std::vector<std::thread> threads;
+        std::atomic<int> failures = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&, i]
+            {
+                // Strings are not shared, since their reference counts are not atomic
+                Str8 text = Str8("xx-") * 1000 + "1234-abc";
+                auto check = [&](const Regex8::Result &m)
+                {
+                    if(!m || m(0, 1) != "1234" || m(2, 3) != "abc")
+                        ++failures;
+                };
+                for(int j = 0; j < 20; ++j)
+                {
+                    check(i % 2 ? pike.Search(text) : dfa.Search(text));
+                    check(i % 2 ? pike.Match(text.Slice(3000)) : dfa.Match(text.Slice(3000)));
+                }
+            });
+        }
+        for(auto &t : threads)
+            t.join();
+        REQUIRE(failures == 0);
     }
 
     SECTION("README")
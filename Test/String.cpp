@@ -1,8 +1,12 @@
-﻿#include <AGZUtils/Utils/Math.h>
+﻿#include <AGZUtils/Utils/Container.h>
+#include <AGZUtils/Utils/Math.h>
 #include <AGZUtils/Utils/Range.h>
 #include <AGZUtils/Utils/String.h>
 
+#include <chrono>
 #include <cstring>
+#include <random>
+#include <tuple>
 
 #include "Catch.hpp"
 
@@ -57,6 +61,9 @@ TEST_CASE("String")
         REQUIRE(Str16::From(0xFF35B, 16)                                  == u8"FF35B");
         REQUIRE(Str32::From(01234567u, 8)                                 == u8"1234567");
         REQUIRE(AStr::From(12 * 35 * 35 * 35 + 4 * 35 * 35 + 34 * 35, 35) == u8"C4Y0");
+        REQUIRE(Str8::From((std::numeric_limits<int>::min)())              == u8"-2147483648");
+        REQUIRE(Str16::From(0.1)                                          == u8"0.1");
+        REQUIRE(Str32::From(-2.5e-8f)                                     == u8"-2.5e-8");
     }
 
     SECTION("Parse")
@@ -67,7 +74,13 @@ TEST_CASE("String")
         REQUIRE(Str16("-123456").Parse<int>()  == -123456);
         REQUIRE(Str16("-0").Parse<int>()       == 0);
 
+        REQUIRE(Str8("-128").Parse<int8_t>()   == -128);
+        REQUIRE_THROWS_AS(Str8("128").Parse<int8_t>(), ArgumentException);
+
         REQUIRE(Math::ApproxEq(Str16("3.286").Parse<float>(), 3.286f, 1e-5));
+        REQUIRE(Str32("-1.25e2").Parse<double>() == -125.0);
+        REQUIRE_THROWS_AS(Str8("1.5.2").Parse<double>(), ArgumentException);
+        REQUIRE_THROWS_AS(Str8("1e999").Parse<double>(), ArgumentException);
     }
 
     SECTION("Misc")
@@ -127,6 +140,10 @@ TEST_CASE("String")
                 | Map([](const Str8::View &v) { return v.AsString(); })
                 | Collect<vector<Str8>>())
              == vector<Str8>{ "a", "b", "c", "d" });
+        REQUIRE((Str8("a--b-+c+-d").Split(vector<const char*>{ "-+", "--", "+-" })
+                | Map([](const Str8::View &v) { return v.AsString(); })
+                | Collect<vector<Str8>>())
+             == vector<Str8>{ "a", "b", "c", "d" });
 
         {
             Str8 s = "ABC@DEF";
@@ -135,6 +152,21 @@ TEST_CASE("String")
             auto st = t.Split("/") | Collect<vector<StrView8>>();
             REQUIRE(st.at(0) == "DEF");
         }
+
+        {
+            Str8 s = u8" Mine  cr\taft ", t = "--a-b----c--";
+            REQUIRE((s.LazySplit() | Collect<vector<StrView8>>()) == s.Split());
+            REQUIRE((t.LazySplit("--") | Collect<vector<StrView8>>()) == t.Split("--"));
+            REQUIRE((t.Slice(3).LazySplit(Str8("-")) | Collect<vector<StrView8>>()) == t.Slice(3).Split("-"));
+            REQUIRE((Str8().LazySplit() | Collect<vector<StrView8>>()).empty());
+
+            Str8 nums = "1 22 333 4444 55555";
+            auto tokens = nums.LazySplit();
+            REQUIRE((tokens | Filter([](const StrView8 &v) { return v.Length() % 2; })
+                            | Map([](const StrView8 &v) { return v.Parse<int>(); })
+                            | Take(2)
+                            | Collect<vector<int>>()) == vector<int>{ 1, 333 });
+        }
     }
 
     SECTION("Join")
@@ -151,10 +183,256 @@ TEST_CASE("String")
         REQUIRE(Str8(u8"Minecraft").Find(u8"eecraft")   == Str8::NPOS);
         REQUIRE(Str8(u8"Minecraft").Find(u8"er")        == Str8::NPOS);
 
+        {
+            // 覆盖向量化筛选（短模式串）和Boyer-Moore-Horspool（长模式串）两条路径
+            Str8 hay = Str8("abcdefgh") * 20 + u8"今天天气不错" + Str8("abcdefgh") * 20;
+            Str8 shortP = u8"h今天", longP = Str8("abcdefgh") * 4 + u8"今";
+            StrAlgo::Searcher<char> shortS(shortP.begin(), shortP.end()), longS(longP.begin(), longP.end());
+            REQUIRE(hay.Find(shortS) == 159);
+            REQUIRE(hay.Find(longS) == 128);
+            REQUIRE(hay.Find(shortS, 160) == Str8::NPOS);
+            REQUIRE(hay.Find(longS, 129) == Str8::NPOS);
+            REQUIRE(hay.Find(Str8("gha")) == 6);
+            REQUIRE(hay.Find(Str8("gha"), 177) == 184);
+            REQUIRE(hay.Find(Str8("h")) == 7);
+
+            Str16 hay16(hay), longP16(longP);
+            REQUIRE(hay16.Find(Str16(shortP)) == 159);
+            REQUIRE(hay16.Find(longP16) == 128);
+            REQUIRE(Str32(hay).Find(Str32(u8"气不")) == 163);
+        }
+
         REQUIRE(Str8(u8"minecraft今天").FindCPIf([](auto c) { return c == 't'; }) == 8);
         REQUIRE(Str8(u8"minecraft今天").FindCPIf([](auto c) { return c == *Str8(u8"今").CodePoints().begin(); }) == 9);
     }
 
+    SECTION("AhoCorasick")
+    {
+        auto toTuples = [](auto &&range)
+        {
+            vector<tuple<size_t, size_t, size_t>> ret;
+            for(auto &m : range)
+                ret.emplace_back(m.patternID, m.position, m.length);
+            return ret;
+        };
+
+        StrAlgo::AhoCorasick<char> ac(vector<Str8>{ "he", "she", "his", "hers" });
+        REQUIRE(ac.GetPatternCount() == 4);
+        REQUIRE(ac.GetStateCount() == 10);
+        REQUIRE(ac.GetMemoryUsage() > 0);
+
+        Str8 text = "ushers";
+        REQUIRE(toTuples(ac.Matches(text.begin(), text.end()))
+             == vector<tuple<size_t, size_t, size_t>>{ { 1, 1, 3 }, { 0, 2, 2 }, { 3, 2, 4 } });
+        REQUIRE(ac.MatchAny(text.begin(), text.end()));
+
+        Str8 none = "abcdefg";
+        REQUIRE(ac.Matches(none.begin(), none.end()).begin() == ac.Matches(none.begin(), none.end()).end());
+        REQUIRE(!ac.MatchAny(none.begin(), none.end()));
+
+        StrAlgo::AhoCorasick<char32_t> ac32(vector<Str32>{ Str32(u8"天气"), Str32(u8"\U0001F600"), Str32(u8"气") });
+        Str32 text32(u8"今天天气\U0001F600不错");
+        REQUIRE(toTuples(ac32.Matches(text32.begin(), text32.end()))
+             == vector<tuple<size_t, size_t, size_t>>{ { 0, 2, 2 }, { 2, 3, 1 }, { 1, 4, 1 } });
+        REQUIRE(ac32.GetMemoryUsage() < 4096);
+
+        REQUIRE_THROWS_AS(StrAlgo::AhoCorasick<char>(vector<Str8>{ "a", "" }), ArgumentException);
+    }
+
+    SECTION("Hash")
+    {
+        Str8 a = Str8("minecraft") * 10, b = a;
+        Str8 c = Str8("minecraft") * 9 + "minecrafT";
+        std::hash<Str8> h;
+        std::hash<StrView8> hv;
+
+        REQUIRE(h(a) == h(b));
+        REQUIRE(h(a) == h(a));
+        REQUIRE(h(a) != h(c));
+        REQUIRE(hv(a.AsView()) == h(a));
+        REQUIRE(hv(a.Slice(9)) == h(Str8("minecraft") * 9));
+        REQUIRE(h(a.Slice(9).AsString()) == hv(c.Slice(0, 81)));
+        REQUIRE(h(Str8("abc")) == hv(Str8("xabcx").Slice(1, 4)));
+        REQUIRE(h(Str8()) == hv(Str8("abc").Slice(1, 1)));
+    }
+
+    SECTION("Builder")
+    {
+        Str8Builder builder;
+        REQUIRE(builder.Get().Empty());
+
+        builder.Reserve(100);
+        REQUIRE(builder.Capacity() >= 100);
+        builder << "minecraft" << Str8("!") << TS();
+        builder.Append(Str8("ab"), 30);
+        REQUIRE(builder.Length() == 76);
+
+        Str8 ab = Str8("ab") * 30;
+        Str8 a = builder.Get(), b = builder.Get();
+        REQUIRE(a == "minecraft!HaHaHa" + ab);
+        REQUIRE(a.Data() == b.Data());
+
+        builder << "cd";
+        Str8 c = builder.Get();
+        REQUIRE(a == "minecraft!HaHaHa" + ab);
+        REQUIRE(c == "minecraft!HaHaHa" + ab + "cd");
+        REQUIRE(std::hash<Str8>()(c) == std::hash<Str8>()("minecraft!HaHaHa" + ab + "cd"));
+
+        Str8Builder copy = builder;
+        copy << "ef";
+        REQUIRE(copy.Get() == "minecraft!HaHaHa" + ab + "cdef");
+        REQUIRE(builder.Get() == c);
+
+        builder.Clear();
+        REQUIRE(builder.Empty());
+        for(int i = 0; i < 1000; ++i)
+            builder << "0123456789";
+        REQUIRE(builder.Get() == Str8("0123456789") * 1000);
+        REQUIRE(c == "minecraft!HaHaHa" + ab + "cd");
+
+        Str8Builder small;
+        small.Reserve(64);
+        small << "xy";
+        Str8 xy = small.Get();
+#if defined(AGZ_ENABLE_STRING_SSO)
+        REQUIRE(small.Capacity() >= 64);
+#endif
+        small << "z";
+        REQUIRE(xy == "xy");
+        REQUIRE(small.Get() == "xyz");
+    }
+
+    SECTION("Intern")
+    {
+        Str8 s = Str8("minecraft") * 4;
+        InternedStr8 a(s), b(s.Slice(0, 18)), c(Str8("minecraft") * 2), d(s.Slice(1, 19));
+
+        REQUIRE(a.Get() == s);
+        REQUIRE(b == c);
+        REQUIRE(b != d);
+        REQUIRE(b.Data() == c.Data());
+        REQUIRE(b.GetHash() == std::hash<StrView8>()(s.Slice(9, 27)));
+        REQUIRE(InternedStr8() == InternedStr8(Str8()));
+        REQUIRE(InternedStr8().GetHash() == std::hash<Str8>()(Str8()));
+        REQUIRE(InternPool<UTF8<>>::Global().TryFind(s.Slice(9, 27)) == b);
+        REQUIRE(!InternPool<UTF8<>>::Global().TryFind(Str8("mine craft")));
+
+        InternPool<UTF8<>> pool;
+        REQUIRE(pool.Intern(s) != a);
+        REQUIRE(pool.Intern(s.AsView()) == pool.Intern(Str8(s.Data(), s.Length())));
+        REQUIRE(pool.GetCount() == 1);
+
+        struct Name { InternedStr8 name; };
+        struct NameOf { InternedStr8 operator()(const Name &n) const { return n.name; } };
+        SharedPtrPool<InternedStr8, Name, NameOf, true> hashedPool;
+        SharedPtrPool<InternedStr8, Name, NameOf, false> orderedPool;
+        auto v0 = hashedPool.GetOrNew(b, Name{ b });
+        auto v1 = orderedPool.GetOrNew(b, Name{ b });
+        REQUIRE(hashedPool.Find(c) == v0);
+        REQUIRE(orderedPool.Find(c) == v1);
+        REQUIRE(!hashedPool.Find(d));
+        REQUIRE(!orderedPool.Find(d));
+    }
+
+    SECTION("Rope")
+    {
+        Str8 big = Str8("0123456789") * 100;
+        Rope8 r(big);
+        REQUIRE(r.Length() == 1000);
+        REQUIRE(r.ToString().Data() == big.Data());
+
+        r.Insert(500, Str8("abc")).Erase(0, 10).Append(Str8(u8"今天"));
+        std::string ref = big.ToStdString();
+        ref.insert(500, "abc");
+        ref.erase(0, 10);
+        ref += u8"今天";
+        REQUIRE(r.ToString() == ref);
+        REQUIRE(r[490] == 'a');
+        REQUIRE(r.Slice(488, 495).ToString() == "89abc01");
+        REQUIRE(r.Slice(r.Length() - 6) == Rope8(Str8(u8"今天")));
+
+        std::vector<char32_t> cps;
+        for(auto cp : r.Slice(r.Length() - 8).CodePoints())
+            cps.push_back(cp);
+        REQUIRE(cps == std::vector<char32_t>{ U'8', U'9', U'今', U'天' });
+
+        std::mt19937 rng(17);
+        Rope8 edited;
+        ref.clear();
+        for(int i = 0; i < 2000; ++i)
+        {
+            size_t n = ref.size();
+            if(rng() % 3 || !n)
+            {
+                size_t pos = rng() % (n + 1);
+                Str8 s = Str8(char32_t('a' + rng() % 26), rng() % 700 + 1);
+                ref.insert(pos, s.ToStdString());
+                edited.Insert(pos, s);
+            }
+            else
+            {
+                size_t beg = rng() % n, end = beg + rng() % (n - beg + 1);
+                ref.erase(beg, end - beg);
+                edited.Erase(beg, end);
+            }
+            REQUIRE(edited.Length() == ref.size());
+        }
+        REQUIRE(edited.ToString() == ref);
+        REQUIRE(edited.GetHeight() <= 2 * 12);
+    }
+
+    SECTION("Arena")
+    {
+        Str8 kept;
+        {
+            StringArena<> arena(4096);
+            {
+                StringArenaScope scope(arena);
+
+                Str8 a = Str8("minecraft") * 10;
+                REQUIRE(arena.GetUsedBytes() > 0);
+
+                Str8Builder builder;
+                for(int i = 0; i < 1000; ++i)
+                    builder << "0123456789";
+                Str8 b = builder.Get();
+                REQUIRE(b.Length() == 10000);
+                REQUIRE(b.Slice(9990) == "0123456789");
+                REQUIRE(a + b.Slice(0, 3) == Str8("minecraft") * 10 + "012");
+
+                size_t used = arena.GetUsedBytes();
+                {
+                    StringArenaScope inner(arena);
+                    Str8 c(a.Data(), a.Length());
+                    REQUIRE(arena.GetUsedBytes() > used);
+                }
+            }
+
+            size_t used = arena.GetUsedBytes();
+            Str8 c = arena.Copy((Str8("abc") * 20).AsView());
+            REQUIRE(c == Str8("abc") * 20);
+            REQUIRE(arena.GetUsedBytes() > used);
+
+            used = arena.GetUsedBytes();
+            kept = Str8("minecraft") * 10;
+            REQUIRE(arena.GetUsedBytes() == used);
+
+            StringArenaScope scope(arena);
+            Str8 keyStr = Str8("arena-interned-key") * 4;
+            used = arena.GetUsedBytes();
+            InternedStr8 key(keyStr);
+            REQUIRE(arena.GetUsedBytes() == used);
+            {
+                HeapStringScope heapScope;
+                Str8 onHeap = Str8("abc") * 20;
+                REQUIRE(arena.GetUsedBytes() == used);
+            }
+        }
+        REQUIRE(kept == Str8("minecraft") * 10);
+        auto internedKey = InternPool<UTF8<>>::Global().TryFind(Str8("arena-interned-key") * 4);
+        REQUIRE((internedKey && internedKey->Get() == Str8("arena-interned-key") * 4));
+    }
+
     SECTION("Chars")
     {
         REQUIRE((Str8(u8"abc").Chars() | Collect<vector<Str8>>())
@@ -166,11 +444,65 @@ TEST_CASE("String")
     SECTION("ToString")
     {
         REQUIRE(ToStr8(5) == "5");
-        REQUIRE(ToStr32(3.158) == std::to_string(3.158));
+        REQUIRE(ToStr32(3.158) == "3.158");
 
         struct A { Str8 ToString() const { return "Minecraft"; } };
         REQUIRE(ToStr8(A{}) == "Minecraft");
 
         REQUIRE(ToStr8(TS{}) == "HaHaHa");
     }
+
+    SECTION("Convert")
+    {
+        // 长度足以覆盖向量化的块处理以及块之间、末尾的标量处理
+        Str8 mixed = Str8(u8"The quick brown fox jumps over the lazy dog. ") * 3
+                   + u8"今天天气不错😀" + Str8("0123456789abcdef") * 2 + u8"é";
+        Str16 m16 = CSConv::Convert<UTF16<>>(mixed);
+        Str32 m32 = CSConv::Convert<UTF32<>>(mixed);
+        REQUIRE(m16.Length() == 45 * 3 + 6 + 2 + 32 + 1);
+        REQUIRE(m32.Length() == 45 * 3 + 6 + 1 + 32 + 1);
+        REQUIRE(CSConv::Convert<UTF8<>>(m16) == mixed);
+        REQUIRE(CSConv::Convert<UTF8<>>(m32) == mixed);
+        REQUIRE(CSConv::Convert<UTF32<>>(m16) == m32);
+        REQUIRE(CSConv::Convert<UTF16<>>(m32) == m16);
+
+        Str8 ascii = Str8("minecraft") * 100;
+        REQUIRE(CSConv::Convert<UTF8<>>(CSConv::Convert<UTF32<>>(ascii)) == ascii);
+        REQUIRE(CSConv::Convert<ASCII<>>(mixed).Length() == m32.Length());
+
+        REQUIRE(UTF8<>::Check(mixed.Data(), mixed.Length()));
+        REQUIRE(UTF16<>::Check(m16.Data(), m16.Length()));
+        REQUIRE(!UTF8<>::Check(mixed.Data(), mixed.Length() - 1));
+        REQUIRE(!UTF16<>::Check(m16.Data(), 45 * 3 + 7));
+
+        std::string bad = ascii.ToStdString() + "\xe4\xbb" + ascii.ToStdString();
+        REQUIRE(!UTF8<>::Check(bad.data(), bad.size()));
+        REQUIRE_THROWS_AS(CSConv::Convert<UTF16<>>(Str8(bad.data(), bad.size())), CharsetException);
+        REQUIRE_THROWS_AS(CSConv::Convert<UTF32<>>(Str8(bad.data(), ascii.Length() + 2)), CharsetException);
+    }
+}
+
+TEST_CASE("CharsetConvertor throughput", "[.][benchmark]")
+{
+    Str8 text = (Str8("2018-10-16 12:00:00 [info] request handled in 35ms; ") * 16
+               + Str8(u8"今天天气不错，适合出门。")) * 4096;
+
+    auto measure = [&](const char *name, auto &&func)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        size_t units = 0;
+        for(int i = 0; i < 16; ++i)
+            units += func();
+        double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        WARN(name << ": " << 16 * text.Length() / sec / 1e9 << " GB/s (UTF-8 side)");
+        return units;
+    };
+
+    Str16 t16 = CSConv::Convert<UTF16<>>(text);
+    Str32 t32 = CSConv::Convert<UTF32<>>(text);
+    REQUIRE(measure("UTF-8 -> UTF-16", [&] { return CSConv::Convert<UTF16<>>(text).Length(); }) == 16 * t16.Length());
+    REQUIRE(measure("UTF-8 -> UTF-32", [&] { return CSConv::Convert<UTF32<>>(text).Length(); }) == 16 * t32.Length());
+    REQUIRE(measure("UTF-16 -> UTF-8", [&] { return CSConv::Convert<UTF8<>>(t16).Length(); })  == 16 * text.Length());
+    REQUIRE(measure("UTF-32 -> UTF-8", [&] { return CSConv::Convert<UTF8<>>(t32).Length(); })  == 16 * text.Length());
+    REQUIRE(measure("UTF-8 validation", [&] { return size_t(UTF8<>::Check(text.Data(), text.Length())); }) == 16);
 }
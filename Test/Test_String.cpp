@@ -1,4 +1,8 @@
-﻿#include <AGZUtils/String/StdStr.h>
+﻿#include <cstring>
+#include <random>
+
+#include <AGZUtils/String/StdStr.h>
+#include <AGZUtils/Utils/Range.h>
 
 #include "Catch.hpp"
 
@@ -45,6 +49,8 @@ TEST_CASE("StdStr")
     {
         REQUIRE(Replace("Minecraft", "e", "haha") == "Minhahacraft");
         REQUIRE(Replace("aaa", "a", "a") == "aaa");
+        REQUIRE(Replace("aaaa", "aa", "b") == "bb");
+        REQUIRE(Replace(std::string(100, 'x') + "yx", "xy", "-") == std::string(99, 'x') + "-x");
     }
 
     SECTION("Join")
@@ -76,6 +82,21 @@ TEST_CASE("StdStr")
             REQUIRE(size == 4);
             REQUIRE(strs == std::vector<std::string_view>{ "ab", "cd", "ef", "gh" });
         }
+
+        {
+            using SV = std::vector<std::string_view>;
+            std::string src = ",a,,b,c,";
+            REQUIRE((LazySplit(src, ",") | Collect<SV>()) == SV{ "a", "b", "c" });
+            REQUIRE((LazySplit(src, ",", false) | Collect<SV>()) == SV{ "", "a", "", "b", "c" });
+            REQUIRE((LazySplit("mine craft is  a good game", false) | Collect<SV>())
+                 == SV{ "mine", "craft", "is", "", "a", "good", "game" });
+            REQUIRE((LazySplit("ab4cd5ef6gh", [](char c) { return IsDemDigit(c); })
+                        | Filter([](std::string_view s) { return s != "cd"; })
+                        | Take(2)
+                        | Collect<SV>()) == SV{ "ab", "ef" });
+            auto empty = LazySplit(std::string_view(), ",");
+            REQUIRE(empty.begin() == empty.end());
+        }
     }
 
     SECTION("From & To")
@@ -84,6 +105,100 @@ TEST_CASE("StdStr")
         REQUIRE(From<double>(To<char>(36.2)) == 36.2);
         REQUIRE(To<char>(-1) == "-1");
         REQUIRE(To<char>("minecraft") == "minecraft");
+
+        REQUIRE(To<char>(0.1) == "0.1");
+        REQUIRE(To<char>(1e21) == "1e+21");
+        REQUIRE(From<float>("+2.5e-3") == 2.5e-3f);
+        REQUIRE(From<int32_t>("-2147483648") == (std::numeric_limits<int32_t>::min)());
+        REQUIRE_THROWS_AS(From<int8_t>("128"), FromException);
+        REQUIRE_THROWS_AS(From<double>("1.5x"), FromException);
+        REQUIRE_THROWS_AS(From<double>("1e400"), FromException);
+    }
+
+    SECTION("NumConv")
+    {
+        auto fmt = [](auto v)
+        {
+            char buf[MAX_FLOAT_CHARS];
+            return std::string(buf, ToChars(v, buf));
+        };
+
+        REQUIRE(fmt(0.0) == "0");
+        REQUIRE(fmt(-0.0) == "-0");
+        REQUIRE(fmt(100.0) == "100");
+        REQUIRE(fmt(1.0 / 3) == "0.3333333333333333");
+        REQUIRE(fmt(1.5e-7) == "1.5e-7");
+        REQUIRE(fmt(0.000001) == "0.000001");
+        REQUIRE(fmt(5e-324) == "5e-324");
+        REQUIRE(fmt(1.7976931348623157e308) == "1.7976931348623157e+308");
+        REQUIRE(fmt(0.1f) == "0.1");
+        REQUIRE(fmt(-std::numeric_limits<double>::infinity()) == "-inf");
+        REQUIRE(fmt(std::numeric_limits<float>::quiet_NaN()) == "nan");
+
+        std::mt19937_64 rng(42);
+        for(int i = 0; i < 20000; ++i)
+        {
+            uint64_t bits = rng();
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            if(std::isfinite(d))
+            {
+                std::string s = fmt(d);
+                double r;
+                REQUIRE(FromCharsExact(s.data(), s.data() + s.size(), r) == NumConvError::OK);
+                REQUIRE(std::memcmp(&r, &d, sizeof(d)) == 0);
+            }
+
+            auto fbits = static_cast<uint32_t>(bits);
+            float f;
+            std::memcpy(&f, &fbits, sizeof(f));
+            if(std::isfinite(f))
+            {
+                std::string s = fmt(f);
+                float r;
+                REQUIRE(FromCharsExact(s.data(), s.data() + s.size(), r) == NumConvError::OK);
+                REQUIRE(std::memcmp(&r, &f, sizeof(f)) == 0);
+            }
+        }
+
+        auto parse = [](const char *s, double &v)
+        {
+            return FromChars(s, s + std::strlen(s), v);
+        };
+
+        double v = 0;
+        REQUIRE((parse("1e", v).error == NumConvError::OK && v == 1));
+        REQUIRE(parse(".5", v).ptr - ".5" == 2);
+        REQUIRE(v == 0.5);
+        REQUIRE(parse("Infinity", v).error == NumConvError::OK);
+        REQUIRE(v == std::numeric_limits<double>::infinity());
+        REQUIRE(parse("00012.5000e-1", v).error == NumConvError::OK);
+        REQUIRE(v == 1.25);
+        REQUIRE(parse("123456789012345678901234567890", v).error == NumConvError::OK);
+        REQUIRE(v == 123456789012345678901234567890.0);
+        REQUIRE(parse("9007199254740993", v).error == NumConvError::OK);
+        REQUIRE(v == 9007199254740992.0);
+        REQUIRE(parse(".", v).error == NumConvError::Invalid);
+        REQUIRE(parse(" 1", v).error == NumConvError::Invalid);
+        REQUIRE(parse("1e-400", v).error == NumConvError::OutOfRange);
+
+        int8_t i8 = 0;
+        const char *s = "-128,";
+        REQUIRE(FromChars(s, s + 5, i8).ptr == s + 4);
+        REQUIRE(i8 == -128);
+        s = "-129";
+        REQUIRE(FromChars(s, s + 4, i8).error == NumConvError::OutOfRange);
+        s = "-1";
+        uint32_t u32;
+        REQUIRE(FromChars(s, s + 2, u32).error == NumConvError::Invalid);
+        s = "ff";
+        REQUIRE(FromChars(s, s + 2, u32, 16).error == NumConvError::OK);
+        REQUIRE(u32 == 255);
+
+        char buf[MAX_INT_CHARS];
+        REQUIRE(std::string(buf, ToChars((std::numeric_limits<int64_t>::min)(), buf)) == "-9223372036854775808");
+        REQUIRE(std::string(buf, ToChars(-255, buf, 16)) == "-ff");
+        REQUIRE(std::string(buf, ToChars(0u, buf)) == "0");
     }
 
     SECTION("UTF")
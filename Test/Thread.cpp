@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <AGZUtils/Utils/Thread.h>
+
+#include "Catch.hpp"
+
+using namespace AGZ;
+
+TEST_CASE("Thread")
+{
+    SECTION("ThreadPool")
+    {
+        ThreadPool pool;
+
+        std::atomic<int> sum = 0;
+        for(int i = 0; i < 10; ++i)
+        {
+            pool.Dispatch([&](int idx) { sum += idx + 1; }, 4);
+            pool.Wait();
+        }
+        REQUIRE(sum == 100);
+        REQUIRE(pool.GetWorkerCount() == 4);
+
+        pool.Dispatch([](int idx) { if(idx == 1) throw std::runtime_error("err"); }, 2);
+        REQUIRE_THROWS(pool.Wait());
+    }
+
+    SECTION("StaticTaskDispatcher")
+    {
+        StaticTaskDispatcher<int> dispatcher(4);
+        std::atomic<int> sum = 0;
+
+        for(int round = 0; round < 5; ++round)
+        {
+            std::queue<int> tasks;
+            for(int i = 1; i <= 100; ++i)
+                tasks.push(i);
+            REQUIRE(dispatcher.Run([&](int i, NoSharedParam_t) { sum += i; }, NO_SHARED_PARAM, tasks));
+        }
+        REQUIRE(sum == 5 * 5050);
+
+        std::queue<int> tasks;
+        for(int i = 0; i < 10; ++i)
+            tasks.push(i);
+        dispatcher.RunAsync([](int i, NoSharedParam_t)
+        {
+            if(i % 3 == 0)
+                throw std::runtime_error("err");
+        }, NO_SHARED_PARAM, tasks);
+        REQUIRE(!dispatcher.Join());
+        REQUIRE(dispatcher.GetExceptions().size() == 4);
+        REQUIRE(dispatcher.IsCompleted());
+
+        dispatcher.EnableStatistics(true);
+        tasks = std::queue<int>();
+        for(int i = 0; i < 20; ++i)
+            tasks.push(i);
+        REQUIRE(dispatcher.Run([](int, NoSharedParam_t) { }, NO_SHARED_PARAM, tasks));
+        auto stats = dispatcher.GetStatistics();
+        REQUIRE(stats.GetWorkerCount() == 4);
+        REQUIRE(stats.GetTaskCount() == 20);
+        size_t histTotal = 0;
+        for(size_t c : stats.GetDurationHistogram())
+            histTotal += c;
+        REQUIRE(histTotal == 20);
+        REQUIRE(stats.ToChromeTrace().find("\"name\":\"task\"") != std::string::npos);
+        REQUIRE(DispatcherStatistics({ { { 1000, 1500, 2001500 } } }).ToChromeTrace().find(
+                    "\"ts\":1.500,\"dur\":2000.000") != std::string::npos);
+        dispatcher.EnableStatistics(false);
+
+        sum = 0;
+        dispatcher.SetClaimBatchSize(16);
+        for(int i = 1; i <= 100; ++i)
+            tasks.push(i);
+        REQUIRE(dispatcher.Run([&](int i, NoSharedParam_t) { sum += i; }, NO_SHARED_PARAM, tasks));
+        REQUIRE(sum == 5050);
+
+        sum = 0;
+        std::vector<int> taskArray;
+        for(int i = 1; i <= 100; ++i)
+            taskArray.push_back(i);
+        REQUIRE(dispatcher.Run([&](int i, NoSharedParam_t) { sum += i; }, NO_SHARED_PARAM, taskArray));
+        REQUIRE(sum == 5050);
+        REQUIRE(dispatcher.IsCompleted());
+    }
+
+    SECTION("WorkStealingScheduler")
+    {
+        ThreadImpl::ChaseLevDeque<int> deque(2);
+        for(int i = 0; i < 10; ++i)
+            deque.Push(i);
+        int v = -1;
+        REQUIRE((deque.Steal(&v) && v == 0));
+        REQUIRE((deque.Pop(&v) && v == 9));
+
+        WorkStealingScheduler scheduler(4);
+
+        std::vector<int> data(10000);
+        for(size_t i = 0; i < data.size(); ++i)
+            data[i] = static_cast<int>(i);
+
+        std::function<long long(size_t, size_t)> sum = [&](size_t beg, size_t end)
+        {
+            if(end - beg <= 64)
+            {
+                long long ret = 0;
+                for(size_t i = beg; i < end; ++i)
+                    ret += data[i];
+                return ret;
+            }
+            size_t mid = (beg + end) / 2;
+            long long left = 0;
+            TaskGroup group;
+            scheduler.Spawn(group, [&] { left = sum(beg, mid); });
+            long long right = sum(mid, end);
+            scheduler.Wait(group);
+            return left + right;
+        };
+
+        long long total = 0;
+        scheduler.Run([&] { total = sum(0, data.size()); });
+        REQUIRE(total == 9999LL * 10000 / 2);
+
+        for(int i = 0; i < scheduler.GetWorkerCount(); ++i)
+        {
+            auto stats = scheduler.GetWorkerStatistics(i);
+            REQUIRE(stats.stealCount <= stats.executedCount);
+        }
+
+        REQUIRE_THROWS(scheduler.Run([] { throw std::runtime_error("err"); }));
+    }
+
+    SECTION("ParallelFor")
+    {
+        ThreadPool pool(3);
+
+        std::vector<int> data(1000, 0);
+        ParallelFor(pool, 0, data.size(), 7, [&](size_t i) { data[i] += static_cast<int>(i); });
+        for(size_t i = 0; i < data.size(); ++i)
+            REQUIRE(data[i] == static_cast<int>(i));
+
+        std::vector<int> img(37 * 23, 0);
+        ParallelFor2D(pool, 37, 23, 8, 8, [&](size_t x, size_t y) { ++img[y * 37 + x]; });
+        REQUIRE(std::all_of(img.begin(), img.end(), [](int v) { return v == 1; }));
+
+        std::atomic<int> count = 0;
+        ParallelFor(10, 20, 0, [&](size_t) { ++count; });
+        REQUIRE(count == 10);
+
+        REQUIRE_THROWS(ParallelFor(pool, 0, 100, 1, [](size_t i)
+        {
+            if(i == 50)
+                throw std::runtime_error("err");
+        }));
+
+        // 嵌套在同一线程池上的调用（包括在调用方线程上执行的块）退化为串行执行
+        std::atomic<int> nestedCount = 0;
+        ParallelFor(pool, 0, 16, 1, [&](size_t)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ParallelFor(pool, 0, 10, 1, [&](size_t) { ++nestedCount; });
+            nestedCount += static_cast<int>(ParallelReduce(pool, 0, 10, 1, 0,
+                [](size_t) { return 1; }, [](int a, int b) { return a + b; }));
+        });
+        REQUIRE(nestedCount == 16 * 20);
+    }
+
+    SECTION("ParallelReduce")
+    {
+        ThreadPool pool(3);
+
+        std::vector<int> data(10000);
+        for(size_t i = 0; i < data.size(); ++i)
+            data[i] = static_cast<int>(i);
+
+        long long sum = ParallelReduce(pool, data, 0LL,
+            [](int v) { return static_cast<long long>(v); },
+            [](long long a, long long b) { return a + b; });
+        REQUIRE(sum == 9999LL * 10000 / 2);
+
+        int maxV = ParallelReduce(pool, 0, 1000, 16, -1,
+            [](size_t i) { return static_cast<int>((i * 37) % 1000); },
+            [](int a, int b) { return (std::max)(a, b); });
+        REQUIRE(maxV == 999);
+
+        std::string expectedStr;
+        for(size_t i = 0; i < 500; ++i)
+            expectedStr += static_cast<char>('a' + i % 26);
+        std::string str = ParallelReduce(pool, 0, 500, 3, std::string(),
+            [](size_t i) { return std::string(1, static_cast<char>('a' + i % 26)); },
+            [](const std::string &a, const std::string &b) { return a + b; });
+        REQUIRE(str == expectedStr);
+
+        REQUIRE(ParallelReduce(std::vector<int>(), 5, [](int v) { return v; }, [](int a, int b) { return a + b; }) == 5);
+    }
+
+    SECTION("TaskGraph")
+    {
+        WorkStealingScheduler scheduler(4);
+
+        std::atomic<int> a = 0, b = 0, c = 0, d = 0;
+        TaskGraph graph;
+        auto na = graph.AddNode([&] { a = 1; });
+        auto nb = graph.AddNode([&] { b = a + 1; }, { na });
+        auto nc = graph.AddNode([&] { c = a + 2; }, { na });
+        graph.AddNode([&] { d = b + c; }, { nb, nc });
+
+        for(int i = 0; i < 3; ++i)
+        {
+            d = 0;
+            graph.Run(scheduler);
+            REQUIRE(d == 5);
+        }
+
+        std::atomic<bool> skipped = true, independent = false;
+        TaskGraph failing;
+        auto nf = failing.AddNode([] { throw std::runtime_error("err"); });
+        failing.AddNode([&] { skipped = false; }, { nf });
+        failing.AddNode([&] { independent = true; });
+        REQUIRE_THROWS(failing.Run(scheduler));
+        REQUIRE(skipped);
+        REQUIRE(independent);
+
+        TaskGraph cyclic;
+        auto n0 = cyclic.AddNode([] { });
+        auto n1 = cyclic.AddNode([] { }, { n0 });
+        cyclic.AddDependency(n1, n0);
+        REQUIRE_THROWS_AS(cyclic.Run(scheduler), ArgumentException);
+    }
+
+    SECTION("DynamicTaskDispatcher")
+    {
+        DynamicTaskDispatcher dispatcher(3);
+
+        std::vector<std::future<int>> results(100);
+        std::thread producer([&]
+        {
+            for(int i = 50; i < 100; ++i)
+                results[i] = dispatcher.Submit([i] { return i; });
+        });
+        for(int i = 0; i < 50; ++i)
+            results[i] = dispatcher.Submit([i] { return i; });
+        producer.join();
+        for(int i = 0; i < 100; ++i)
+            REQUIRE(results[i].get() == i);
+
+        auto err = dispatcher.Submit([] { throw std::runtime_error("err"); });
+        REQUIRE_THROWS_AS(err.get(), std::runtime_error);
+
+        CancellationSource source;
+        source.Cancel();
+        auto cancelled = dispatcher.Submit([] { return 1; }, source.GetToken());
+        REQUIRE_THROWS_AS(cancelled.get(), TaskCancelledException);
+
+        std::atomic<bool> started = false;
+        auto longTask = dispatcher.Submit([&](const CancellationToken &token)
+        {
+            started = true;
+            while(!token.IsCancelled())
+                std::this_thread::yield();
+            return 2;
+        });
+        while(!started)
+            std::this_thread::yield();
+        dispatcher.CancelAll();
+        REQUIRE(longTask.get() == 2);
+        REQUIRE(dispatcher.Submit([] { return 3; }).get() == 3);
+
+        // CancelAll does not wait for tasks bound to other tokens
+        std::atomic<bool> release = false;
+        std::atomic<int> blockedCount = 0;
+        std::vector<std::future<void>> blocked;
+        for(int i = 0; i < 3; ++i)
+        {
+            blocked.push_back(dispatcher.Submit([&]
+            {
+                ++blockedCount;
+                while(!release)
+                    std::this_thread::yield();
+            }, CancellationToken()));
+        }
+        while(blockedCount != 3)
+            std::this_thread::yield();
+        auto queued = dispatcher.Submit([] { return 4; });
+        dispatcher.CancelAll();
+        REQUIRE_THROWS_AS(queued.get(), TaskCancelledException);
+        release = true;
+        for(auto &f : blocked)
+            f.get();
+    }
+
+#if defined(AGZ_OS_LINUX)
+    SECTION("WorkerThreadOptions")
+    {
+        // 工作线程创建时继承调用方线程的CPU集合，清空选项后应恢复为该集合
+        auto initAffinity = GetCurrentThreadAffinity();
+        REQUIRE(!initAffinity.empty());
+        int cpu = initAffinity.front();
+
+        StaticTaskDispatcher<int> dispatcher(3);
+        dispatcher.SetReserveCallingThread(true);
+        REQUIRE(dispatcher.SetWorkerOptions({ { cpu }, "agz-worker" }));
+
+        std::mutex mut;
+        std::vector<std::vector<int>> affinities;
+        std::vector<std::string> names;
+
+        std::vector<int> tasks(30);
+        REQUIRE(dispatcher.Run([&](int, NoSharedParam_t)
+        {
+            char name[16] = { };
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            std::lock_guard<std::mutex> lk(mut);
+            affinities.push_back(GetCurrentThreadAffinity());
+            names.push_back(name);
+        }, NO_SHARED_PARAM, tasks));
+
+        REQUIRE(affinities.size() == 30);
+        for(auto &a : affinities)
+            REQUIRE(a == std::vector<int>{ cpu });
+        for(auto &n : names)
+            REQUIRE(n.substr(0, 10) == "agz-worker");
+
+        REQUIRE(dispatcher.SetWorkerOptions({ }));
+        affinities.clear();
+        REQUIRE(dispatcher.Run([&](int, NoSharedParam_t)
+        {
+            std::lock_guard<std::mutex> lk(mut);
+            affinities.push_back(GetCurrentThreadAffinity());
+        }, NO_SHARED_PARAM, tasks));
+        for(auto &a : affinities)
+            REQUIRE(a == initAffinity);
+    }
+#endif
+}